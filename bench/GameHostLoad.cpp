@@ -0,0 +1,171 @@
+// Load test for the game host. Keeps a number of tables open with bots in
+// every seat. A bot plays its move a think time after the host pushes a
+// table state showing its turn, drawn uniformly from half to one and a half
+// times the given mean so the tables do not move in lockstep. Reports move throughput and the latency
+// from submitting a move to receiving the resulting state.
+//
+// Usage: GameHostLoad [tables] [seconds] [think ms] [shards] [tick ms]
+
+#include "../src/GameHost.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <queue>
+#include <poll.h>
+#include <thread>
+#include <vector>
+
+#define BOT_PLAYERS 4
+
+static const char* botNames[BOT_PLAYERS] = {"p0", "p1", "p2", "p3"};
+static const char* botSecrets[BOT_PLAYERS] = {"k0", "k1", "k2", "k3"};
+static const Endpoint trackerLink = {0, 0}; // No table is numbered 0, so no seat shares it
+
+static Endpoint seatEndpoint(uint32_t table, int seat) {
+    Endpoint endpoint = {table, static_cast<uint16_t>(seat)};
+    return endpoint;
+}
+
+static void openTable(GameHost& host, uint32_t table, uint64_t nowUs) {
+    host.submit(CMD_TABLE_OPEN, std::to_string(table) + " six 9 p0 k0 p1 k1 p2 k2 p3 k3", trackerLink, nowUs);
+    for (int seat = 0; seat < BOT_PLAYERS; ++seat) {
+        host.submit(CMD_TABLE_JOIN, std::to_string(table) + " " + botNames[seat] + " " + botSecrets[seat],
+                    seatEndpoint(table, seat), nowUs);
+    }
+}
+
+// Turns over the first face-down card, or now and then swaps in the drawn
+// card instead, so holes last several rounds
+static std::string chooseMove(uint32_t table, int seat, const std::string& hand, uint32_t& rng) {
+    rng = rng * 1103515245u + 12345u;
+    size_t slot = 0;
+    int index = 0;
+    int faceDown = -1;
+    for (size_t pos = 0; pos < hand.size(); pos = slot + 1, ++index) {
+        slot = hand.find(' ', pos);
+        if (slot == std::string::npos) {
+            slot = hand.size();
+        }
+        if (hand.compare(pos, slot - pos, "***") == 0) {
+            faceDown = index;
+            break;
+        }
+    }
+    std::string prefix = std::to_string(table) + " " + botSecrets[seat];
+    if (faceDown < 0 || (rng >> 16) % 3 == 0) {
+        return prefix + " deck replace " + std::to_string((rng >> 8) % 6);
+    }
+    return prefix + " deck flip " + std::to_string(faceDown);
+}
+
+int main(int argc, char* argv[]) {
+    int tables = argc > 1 ? atoi(argv[1]) : 10000;
+    double seconds = argc > 2 ? atof(argv[2]) : 5.0;
+    int thinkMs = argc > 3 ? atoi(argv[3]) : 500;
+    int shards = argc > 4 ? atoi(argv[4]) : std::max(1u, std::thread::hardware_concurrency());
+    int tickMs = argc > 5 ? atoi(argv[5]) : GAMEHOST_TICK_MS;
+    if (tables <= 0 || seconds <= 0 || thinkMs < 0 || shards <= 0 || tickMs <= 0) {
+        fprintf(stderr, "Usage: %s [tables] [seconds] [think ms] [shards] [tick ms]\n", argv[0]);
+        return 1;
+    }
+
+    GameHost host(shards, tickMs, trackerLink);
+    std::vector<uint64_t> submittedUs(tables, 0);
+    std::vector<uint32_t> tableIds(tables);
+    uint32_t nextTable = 1;
+    uint32_t rng = 1;
+    uint64_t start = hostClockUs();
+    for (int i = 0; i < tables; ++i) {
+        tableIds[i] = nextTable++;
+        openTable(host, tableIds[i], start);
+    }
+
+    // Moves waiting out their think time, soonest first
+    struct PendingMove {
+        uint64_t dueUs;
+        int slot;
+        Endpoint from;
+        std::string move;
+        bool operator>(const PendingMove& other) const { return dueUs > other.dueUs; }
+    };
+    std::priority_queue<PendingMove, std::vector<PendingMove>, std::greater<PendingMove>> thinking;
+
+    std::vector<HostOutput> outputs;
+    std::vector<HostBroadcast> broadcasts; // No spectators here; always empty
+    std::vector<double> latencies;
+    uint64_t moves = 0, games = 0, failures = 0;
+    uint64_t measureFrom = start + 1000000;
+    uint64_t end = measureFrom + static_cast<uint64_t>(seconds * 1e6);
+
+    while (hostClockUs() < end) {
+        struct pollfd pfd = {host.wakeFd(), POLLIN, 0};
+        poll(&pfd, 1, 1);
+        outputs.clear();
+        host.drain(outputs, broadcasts);
+        uint64_t now = hostClockUs();
+
+        while (!thinking.empty() && thinking.top().dueUs <= now) {
+            const PendingMove& pending = thinking.top();
+            host.submit(CMD_TABLE_MOVE, pending.move, pending.from, now);
+            submittedUs[pending.slot] = now;
+            thinking.pop();
+        }
+
+        for (const HostOutput& output : outputs) {
+            uint32_t table = output.to.addr;
+            int slot = static_cast<int>(table - 1) % tables;
+            int seat = output.to.port;
+            const std::string& text = output.text;
+            if (text.compare(0, 7, "FAILURE") == 0) {
+                if (failures++ == 0) {
+                    fprintf(stderr, "first failure: %s\n", text.c_str());
+                }
+                continue;
+            }
+            if (text.compare(0, 6, "RESULT") == 0) {
+                // Keep the table count up: replace the finished table
+                if (seat == 0) {
+                    games++;
+                    tableIds[slot] = nextTable;
+                    nextTable += tables;
+                    openTable(host, tableIds[slot], now);
+                }
+                continue;
+            }
+            if (text.compare(0, 5, "TABLE") != 0) {
+                continue;
+            }
+
+            // "TABLE <id> <hole> <turn> <discard> | p0 ... | p1 ..."
+            char turn[8] = {0};
+            if (sscanf(text.c_str(), "TABLE %*u %*d %7s", turn) != 1 || strcmp(turn, botNames[seat]) != 0) {
+                continue;
+            }
+            if (submittedUs[slot] != 0) {
+                if (submittedUs[slot] >= measureFrom) {
+                    latencies.push_back((now - submittedUs[slot]) / 1000.0);
+                    moves++;
+                }
+            }
+            size_t mine = text.find(std::string("| ") + botNames[seat] + " ");
+            size_t handEnd = text.find(" |", mine + 2);
+            std::string hand = text.substr(mine + 5, handEnd == std::string::npos ? std::string::npos : handEnd - mine - 5);
+            rng = rng * 1103515245u + 12345u;
+            uint64_t thinkUs = thinkMs * 500ull + (rng >> 8) % (thinkMs * 1000ull + 1);
+            thinking.push({now + thinkUs, slot, output.to, chooseMove(table, seat, hand, rng)});
+            submittedUs[slot] = 0;
+        }
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    printf("tables %d  think %d ms  shards %d  tick %d ms  open %zu\n", tables, thinkMs, shards, tickMs, host.tables());
+    printf("moves/s %.0f  games/s %.0f  failures %llu\n", moves / seconds, games / seconds,
+           static_cast<unsigned long long>(failures));
+    if (!latencies.empty()) {
+        printf("move latency ms  p50 %.2f  p99 %.2f  max %.2f\n", latencies[latencies.size() / 2],
+               latencies[latencies.size() * 99 / 100], latencies.back());
+    }
+    return 0;
+}
\ No newline at end of file
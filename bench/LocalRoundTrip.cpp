@@ -0,0 +1,121 @@
+// Round-trip latency of one request at a time, over the shared-memory local
+// channel and over UDP loopback through the sockets transport, against the
+// same in-process tracker.
+//
+// Usage: LocalRoundTrip [round trips per transport]
+
+#include "../src/LocalChannelServer.h"
+#include "../src/Transport.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+#define BENCH_PORT 17100
+
+static void printLatencies(const char* name, std::vector<double>& us) {
+    std::sort(us.begin(), us.end());
+    printf("%-8s %10.2f %10.2f %10.2f\n", name, us[us.size() / 2], us[us.size() * 99 / 100],
+           us[us.size() * 999 / 1000]);
+}
+
+static Message queryGames() {
+    Message msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.cmd = CMD_QUERY_GAMES;
+    return msg;
+}
+
+static void benchLocal(TrackerServer& server, int rounds) {
+    LocalChannelServer local(server, BENCH_PORT);
+    std::string error;
+    LocalChannelClient client;
+    if (!local.start(error) || !client.attach(BENCH_PORT, error)) {
+        fprintf(stderr, "local channel: %s\n", error.c_str());
+        return;
+    }
+
+    Message msg = queryGames();
+    char reply[ECHOMAX];
+    std::vector<double> us;
+    for (int i = 0; i < rounds; ++i) {
+        Clock::time_point start = Clock::now();
+        client.send(msg);
+        while (client.receive(reply, sizeof(reply), 1000) == 0) {
+        }
+        us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    printLatencies("local", us);
+}
+
+static void benchUdp(TrackerServer& server, int rounds) {
+    int sock = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(BENCH_PORT);
+    if (bind(sock, (struct sockaddr*) &addr, sizeof(addr)) < 0)
+        DieWithError("bench: bind() failed");
+
+    std::atomic<bool> stop(false);
+    std::thread loop([&]() {
+        Transport* transport = createTransport("sockets", sock);
+        std::vector<InboundDatagram> batch(TRANSPORT_MAX_BATCH);
+        while (!stop) {
+            struct pollfd pfd = {transport->fd(), transport->pollEvents(), 0};
+            poll(&pfd, 1, 10);
+            transport->ready(pfd.revents);
+            int depth = (pfd.revents & POLLIN) ? transport->receive(batch.data(), TRANSPORT_MAX_BATCH) : 0;
+            for (int i = 0; i < depth; ++i) {
+                Endpoint from = {batch[i].addr.sin_addr.s_addr, batch[i].addr.sin_port};
+                std::string response = server.handleCommand(*batch[i].msg, from);
+                transport->send(response.c_str(), response.length(), batch[i].addr);
+            }
+            transport->flush();
+        }
+        delete transport;
+    });
+
+    int client = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    connect(client, (struct sockaddr*) &addr, sizeof(addr));
+    Message msg = queryGames();
+    char reply[ECHOMAX];
+    std::vector<double> us;
+    for (int i = 0; i < rounds; ++i) {
+        Clock::time_point start = Clock::now();
+        send(client, &msg, sizeof(msg), 0);
+        recv(client, reply, sizeof(reply), 0);
+        us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    printLatencies("udp", us);
+
+    stop = true;
+    loop.join();
+    close(client);
+    close(sock);
+}
+
+int main(int argc, char* argv[]) {
+    int rounds = argc > 1 ? atoi(argv[1]) : 100000;
+    if (rounds <= 0) {
+        fprintf(stderr, "Usage: %s [round trips per transport]\n", argv[0]);
+        return 1;
+    }
+
+    TrackerServer server;
+    printf("%-8s %10s %10s %10s\n", "channel", "p50 us", "p99 us", "p99.9 us");
+    benchLocal(server, rounds);
+    benchUdp(server, rounds);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,379 @@
+// Microbenchmarks for the game and tracker primitives. Each case is timed
+// in batches long enough to read the clock reliably: a few warmup samples
+// are thrown away, then the median and the median absolute deviation (MAD)
+// of the per-operation time over the repetitions are reported. Results can
+// be written as JSON and compared with an earlier run, so a change can be
+// shown to make things faster, or caught making them slower.
+//
+// Usage: Microbench [--filter <text>] [--reps <n>] [--warmup <n>] [--min-ms <ms>]
+//                   [--json <file>] [--baseline <file>] [--threshold <percent>]
+
+#include "../src/TrackerServer.h"
+#include "../src/GameLogic.h"
+#include "../src/Utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define MAX_BATCH (1 << 24)
+
+typedef std::chrono::steady_clock Clock;
+
+// Results the compiler cannot prove unused
+static volatile uint64_t sink;
+
+static double elapsedNs(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+// A case runs its operation batch times and returns the nanoseconds that
+// count, so per-sample setup can stay outside the timed region. maxBatch
+// bounds cases whose state changes with every operation.
+struct Case {
+    std::string name;
+    std::function<double(int)> run;
+    int maxBatch;
+};
+
+struct Result {
+    std::string name;
+    int batch;
+    int samples;
+    double median;
+    double mad;
+    double min;
+};
+
+static double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+static Result measure(const Case& c, int warmup, int reps, double minNs) {
+    // Double the batch until one sample takes long enough
+    int batch = 1;
+    double ns = c.run(batch);
+    while (ns < minNs && batch < std::min(c.maxBatch, MAX_BATCH)) {
+        batch = std::min(std::min(c.maxBatch, MAX_BATCH), batch * 2);
+        ns = c.run(batch);
+    }
+    for (int i = 0; i < warmup; ++i) {
+        c.run(batch);
+    }
+    std::vector<double> perOp;
+    for (int i = 0; i < reps; ++i) {
+        perOp.push_back(c.run(batch) / batch);
+    }
+    Result r;
+    r.name = c.name;
+    r.batch = batch;
+    r.samples = reps;
+    r.median = median(perOp);
+    std::vector<double> deviations;
+    for (double v : perOp) {
+        deviations.push_back(std::fabs(v - r.median));
+    }
+    r.mad = median(deviations);
+    r.min = *std::min_element(perOp.begin(), perOp.end());
+    return r;
+}
+
+static Message makeMessage(CommandType cmd, const std::string& data) {
+    Message msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.cmd = cmd;
+    snprintf(msg.data, sizeof(msg.data), "%s", data.c_str());
+    return msg;
+}
+
+static void fillTracker(Tracker& tracker, int players) {
+    for (int i = 0; i < players; ++i) {
+        tracker.registerPlayer("p" + std::to_string(i), "10.0." + std::to_string(i / 250 % 250) + "." +
+                               std::to_string(i % 250 + 1), 5000, 6000);
+    }
+}
+
+static void playHole(SixGolfGameLogic& game) {
+    while (!game.isGameFinished()) {
+        playGreedyTurn(game);
+    }
+}
+
+static std::vector<Case> cases() {
+    std::vector<Case> all;
+
+    all.push_back({"deck/shuffle", [](int batch) {
+        Deck deck;
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < batch; ++i) {
+            deck.shuffle();
+        }
+        return elapsedNs(start);
+    }, MAX_BATCH});
+
+    all.push_back({"deck/drawCard", [](int batch) {
+        std::vector<Deck> decks((batch + 51) / 52);
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < batch; ++i) {
+            sink += decks[i / 52].drawCard().rank;
+        }
+        return elapsedNs(start);
+    }, 1 << 20});
+
+    all.push_back({"displayHand/6", [](int batch) {
+        std::vector<Card> hand = {Card(14, 'S'), Card(10, 'H'), Card(2, 'C'), Card(12, 'D'), Card(7, 'S'), Card(13, 'H')};
+        hand[0].faceUp = hand[3].faceUp = true;
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < batch; ++i) {
+            sink += displayHand(hand).size();
+        }
+        return elapsedNs(start);
+    }, MAX_BATCH});
+
+    all.push_back({"golf/calculateScore", [](int batch) {
+        SixGolfGameLogic game(4, 1, 42);
+        for (int p = 0; p < 4; ++p) {
+            game.flipCard(p, 1);
+            game.flipCard(p, 4);
+        }
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < batch; ++i) {
+            sink += game.calculateScore(i & 3);
+        }
+        return elapsedNs(start);
+    }, MAX_BATCH});
+
+    all.push_back({"golf/playHole/4", [](int batch) {
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < batch; ++i) {
+            SixGolfGameLogic game(4, 1, static_cast<uint32_t>(i));
+            playHole(game);
+            sink += game.getWinner();
+        }
+        return elapsedNs(start);
+    }, MAX_BATCH});
+
+    const int sizes[] = {100, 1000, 10000};
+    for (int size : sizes) {
+        std::string suffix = "/" + std::to_string(size);
+
+        all.push_back({"tracker/registerPlayer" + suffix, [size](int batch) {
+            Tracker tracker;
+            fillTracker(tracker, size);
+            std::vector<std::string> names;
+            for (int i = 0; i < batch; ++i) {
+                names.push_back("new" + std::to_string(i));
+            }
+            Clock::time_point start = Clock::now();
+            for (int i = 0; i < batch; ++i) {
+                sink += tracker.registerPlayer(names[i], "10.1.0.1", 5000, 6000).size();
+            }
+            return elapsedNs(start);
+        }, 1024});
+
+        // Dealers come from the back of the registry, seats from the front;
+        // each game takes four free players
+        all.push_back({"tracker/startGame" + suffix, [size](int batch) {
+            Tracker tracker;
+            fillTracker(tracker, size);
+            std::vector<std::string> dealers;
+            for (int i = 0; i < batch; ++i) {
+                dealers.push_back("p" + std::to_string(size - 1 - i));
+            }
+            Clock::time_point start = Clock::now();
+            for (int i = 0; i < batch; ++i) {
+                sink += tracker.startGame(dealers[i], 3, 9).size();
+            }
+            return elapsedNs(start);
+        }, size / 8});
+
+        all.push_back({"tracker/queryPlayers" + suffix, [size](int batch) {
+            Tracker tracker;
+            fillTracker(tracker, size);
+            Clock::time_point start = Clock::now();
+            for (int i = 0; i < batch; ++i) {
+                sink += tracker.queryPlayers().size();
+            }
+            return elapsedNs(start);
+        }, MAX_BATCH});
+    }
+
+    // Requests that are parsed and refused without changing state, so the
+    // time is in decoding, dispatch and formatting the reply
+    struct Request {
+        const char* name;
+        CommandType cmd;
+        const char* data;
+    };
+    const Request requests[] = {
+        {"handleCommand/register", CMD_REGISTER, "p1 10.0.0.2 5000 6000"},
+        {"handleCommand/endGame", CMD_END_GAME, "99999 p1 12 30 7 18"},
+        {"handleCommand/leaderboard", CMD_QUERY_LEADERBOARD, "RANK p7"},
+        {"handleCommand/multi", CMD_MULTI,
+         "QUERY_LEADERBOARD RANK p1\nQUERY_LEADERBOARD RANK p2\nQUERY_LEADERBOARD RANK p3\nQUERY_LEADERBOARD RANK p4\n"
+         "END_GAME 99999 p1\nEND_GAME 99998 p2\nREGISTER p3 10.0.0.4 5000 6000\nSTART_GAME nobody 3 9\n"},
+    };
+    for (const Request& request : requests) {
+        Message msg = makeMessage(request.cmd, request.data);
+        all.push_back({request.name, [msg](int batch) {
+            TrackerServer server;
+            Endpoint from = {0x0A000001u, 4000};
+            for (int i = 0; i < 100; ++i) {
+                server.handleCommand(makeMessage(CMD_REGISTER, "p" + std::to_string(i) + " 10.0.0.1 5000 6000"), from);
+            }
+            Clock::time_point start = Clock::now();
+            for (int i = 0; i < batch; ++i) {
+                sink += server.handleCommand(msg, from).size();
+            }
+            return elapsedNs(start);
+        }, MAX_BATCH});
+    }
+    return all;
+}
+
+static void writeJson(const std::string& path, const std::vector<Result>& results, bool optimized) {
+    std::ofstream out(path.c_str());
+    out << "{\n  \"optimized\": " << (optimized ? "true" : "false") << ",\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        char line[512];
+        snprintf(line, sizeof(line),
+                 "    {\"name\": \"%s\", \"batch\": %d, \"samples\": %d, \"median_ns\": %.3f, \"mad_ns\": %.3f, "
+                 "\"min_ns\": %.3f}%s\n",
+                 r.name.c_str(), r.batch, r.samples, r.median, r.mad, r.min, i + 1 < results.size() ? "," : "");
+        out << line;
+    }
+    out << "  ]\n}\n";
+}
+
+// Reads back what writeJson wrote: one benchmark object per line
+static bool readJson(const std::string& path, std::map<std::string, Result>& results, bool& optimized) {
+    std::ifstream in(path.c_str());
+    if (!in) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.find("\"optimized\": ") != std::string::npos) {
+            optimized = line.find("true") != std::string::npos;
+        }
+        size_t name = line.find("\"name\": \"");
+        if (name == std::string::npos) {
+            continue;
+        }
+        Result r;
+        name += 9;
+        r.name = line.substr(name, line.find('"', name) - name);
+        const char* fields[] = {"\"median_ns\": ", "\"mad_ns\": "};
+        double* values[] = {&r.median, &r.mad};
+        for (int f = 0; f < 2; ++f) {
+            size_t at = line.find(fields[f]);
+            *values[f] = at == std::string::npos ? 0 : atof(line.c_str() + at + strlen(fields[f]));
+        }
+        results[r.name] = r;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::string filter, jsonPath, baselinePath;
+    int reps = 15, warmup = 3;
+    double minMs = 5, threshold = 5;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--filter" && hasValue) {
+            filter = argv[++i];
+        } else if (arg == "--reps" && hasValue) {
+            reps = atoi(argv[++i]);
+        } else if (arg == "--warmup" && hasValue) {
+            warmup = atoi(argv[++i]);
+        } else if (arg == "--min-ms" && hasValue) {
+            minMs = atof(argv[++i]);
+        } else if (arg == "--json" && hasValue) {
+            jsonPath = argv[++i];
+        } else if (arg == "--baseline" && hasValue) {
+            baselinePath = argv[++i];
+        } else if (arg == "--threshold" && hasValue) {
+            threshold = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--filter <text>] [--reps <n>] [--warmup <n>] [--min-ms <ms>] [--json <file>] "
+                            "[--baseline <file>] [--threshold <percent>]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (reps < 1 || warmup < 0) {
+        fprintf(stderr, "--reps must be at least 1\n");
+        return 1;
+    }
+
+    std::map<std::string, Result> baseline;
+    bool baselineOptimized = false;
+    if (!baselinePath.empty() && !readJson(baselinePath, baseline, baselineOptimized)) {
+        fprintf(stderr, "cannot read baseline %s\n", baselinePath.c_str());
+        return 1;
+    }
+#ifdef __OPTIMIZE__
+    bool optimized = true;
+#else
+    bool optimized = false;
+#endif
+    if (!baseline.empty() && baselineOptimized != optimized) {
+        printf("note: the baseline was built %s optimization, this run %s\n", baselineOptimized ? "with" : "without",
+               optimized ? "with" : "without");
+    }
+
+    if (!optimized) {
+        printf("note: built without optimization\n");
+    }
+    printf("%-30s %9s %12s %10s %6s %12s", "benchmark", "batch", "median ns", "MAD ns", "MAD%", "min ns");
+    if (!baseline.empty()) {
+        printf(" %12s %8s", "baseline ns", "change");
+    }
+    printf("\n");
+
+    // A change counts when it exceeds the threshold and the noise of both runs
+    std::vector<Result> results;
+    int regressions = 0;
+    for (const Case& c : cases()) {
+        if (!filter.empty() && c.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        Result r = measure(c, warmup, reps, minMs * 1e6);
+        results.push_back(r);
+        printf("%-30s %9d %12.1f %10.1f %5.1f%% %12.1f", r.name.c_str(), r.batch, r.median, r.mad,
+               r.median > 0 ? 100 * r.mad / r.median : 0, r.min);
+        auto base = baseline.find(r.name);
+        if (base != baseline.end() && base->second.median > 0) {
+            double change = 100 * (r.median - base->second.median) / base->second.median;
+            bool significant = std::fabs(change) > threshold &&
+                               std::fabs(r.median - base->second.median) > 2 * (r.mad + base->second.mad);
+            const char* verdict = !significant ? "" : change > 0 ? "  SLOWER" : "  faster";
+            regressions += significant && change > 0;
+            printf(" %12.1f %+7.1f%%%s", base->second.median, change, verdict);
+        } else if (!baseline.empty()) {
+            printf(" %12s %8s", "-", "new");
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+
+    if (!jsonPath.empty()) {
+        writeJson(jsonPath, results, optimized);
+        printf("wrote %s\n", jsonPath.c_str());
+    }
+    if (!baseline.empty()) {
+        printf("%d regression%s beyond %.0f%%\n", regressions, regressions == 1 ? "" : "s", threshold);
+    }
+    return regressions > 0 ? 2 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,122 @@
+// Contention benchmark for the tracker's query path. Reader threads issue
+// QUERY_PLAYERS while writer threads register and de-register players, once
+// with queries served under trackerMutex and once from the published view.
+//
+// Usage: QueryContention [seconds per run] [preloaded players]
+
+#include "../src/TrackerServer.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+struct RunResult {
+    double readsPerSec;
+    double writesPerSec;
+    double readP99Us;
+};
+
+static Message makeMessage(CommandType cmd, const std::string& data) {
+    Message msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.cmd = cmd;
+    snprintf(msg.data, sizeof(msg.data), "%s", data.c_str());
+    return msg;
+}
+
+static RunResult run(bool snapshotReads, int readers, int writers, double seconds, int preload) {
+    TrackerServer server;
+    server.setSnapshotReads(snapshotReads);
+    for (int i = 0; i < preload; ++i) {
+        Endpoint from = {static_cast<uint32_t>(i), 1};
+        server.handleCommand(makeMessage(CMD_REGISTER, "base" + std::to_string(i) + " 127.0.0.1 5000 6000"), from);
+    }
+
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> reads(0), writes(0);
+    std::vector<std::vector<double>> latencies(readers);
+    std::vector<std::thread> threads;
+
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r]() {
+            Message query = makeMessage(CMD_QUERY_PLAYERS, "");
+            Endpoint from = {0x7F000001u, static_cast<uint16_t>(r)};
+            uint64_t count = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                Clock::time_point start = Clock::now();
+                std::string response = server.handleCommand(query, from);
+                if ((count++ & 15) == 0) {
+                    latencies[r].push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+                }
+            }
+            reads += count;
+        });
+    }
+    for (int w = 0; w < writers; ++w) {
+        threads.emplace_back([&, w]() {
+            std::string name = "writer" + std::to_string(w);
+            Message reg = makeMessage(CMD_REGISTER, name + " 127.0.0.1 5000 6000");
+            Message dereg = makeMessage(CMD_DEREGISTER, name);
+            Endpoint from = {0x0A000000u + w, 2};
+            uint64_t count = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                server.handleCommand((count & 1) ? dereg : reg, from);
+                count++;
+            }
+            writes += count;
+        });
+    }
+    // Stands in for the server loop, which republishes the view between batches
+    threads.emplace_back([&]() {
+        while (!stop.load(std::memory_order_relaxed)) {
+            server.publishQueries();
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    });
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::vector<double> all;
+    for (const auto& samples : latencies) {
+        all.insert(all.end(), samples.begin(), samples.end());
+    }
+    double p99 = 0;
+    if (!all.empty()) {
+        size_t index = all.size() * 99 / 100;
+        std::nth_element(all.begin(), all.begin() + index, all.end());
+        p99 = all[index];
+    }
+    return RunResult{reads / seconds, writes / seconds, p99};
+}
+
+int main(int argc, char* argv[]) {
+    double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+    int preload = argc > 2 ? atoi(argv[2]) : 200;
+    const int readerCounts[] = {1, 2, 4, 8};
+    const int writerCounts[] = {0, 1, 2, 4};
+
+    printf("%d preloaded players, %.2f s per run, %u hardware threads\n", preload, seconds,
+           std::thread::hardware_concurrency());
+    printf("%7s %7s | %12s %12s %10s | %12s %12s %10s\n", "readers", "writers",
+           "locked rd/s", "wr/s", "rd p99 us", "epoch rd/s", "wr/s", "rd p99 us");
+    for (int readers : readerCounts) {
+        for (int writers : writerCounts) {
+            RunResult locked = run(false, readers, writers, seconds, preload);
+            RunResult epoch = run(true, readers, writers, seconds, preload);
+            printf("%7d %7d | %12.0f %12.0f %10.1f | %12.0f %12.0f %10.1f\n", readers, writers,
+                   locked.readsPerSec, locked.writesPerSec, locked.readP99Us,
+                   epoch.readsPerSec, epoch.writesPerSec, epoch.readP99Us);
+        }
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,235 @@
+// Loss benchmark for the reliable peer channel. Two ReliableChannels talk
+// over UDP loopback through a proxy in the same process that drops each
+// datagram with a given probability and holds the rest for a base delay
+// plus random jitter, so datagrams also arrive out of order. One side
+// offers small messages at a fixed rate; the other checks they arrive in
+// order, once each, and records how long each took from send() to delivery.
+//
+// Usage: ReliablePeerLoss [messages per run] [messages per second] [delay us] [jitter us]
+
+#include "../src/ReliableChannel.h"
+#include "../src/Utils.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <queue>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#define MESSAGE_BYTES 64
+#define RUN_LIMIT_US 60000000ull
+
+typedef std::chrono::steady_clock Clock;
+
+static uint64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static int bindLoopback(sockaddr_in& addr) {
+    int sock = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    int buf = 4 << 20;
+    if (sock < 0 || bind(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+        getsockname(sock, (struct sockaddr *) &addr, &len) < 0) {
+        DieWithError("bench: socket setup failed");
+    }
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf));
+    setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &buf, sizeof(buf));
+    return sock;
+}
+
+// Drops, delays and reorders datagrams between two endpoints. Each side
+// sends to its own proxy socket, which forwards from the other one.
+struct LossyProxy {
+    struct Held {
+        uint64_t releaseUs;
+        int via;
+        sockaddr_in to;
+        std::string data;
+        bool operator<(const Held& other) const { return releaseUs > other.releaseUs; }
+    };
+
+    int facing[2];        // facing[i] is where side i sends
+    sockaddr_in addrs[2];
+    sockaddr_in sides[2];
+    double loss;
+    uint32_t delayUs, jitterUs;
+    uint64_t state;
+    std::priority_queue<Held> held;
+    uint64_t forwarded, dropped;
+
+    double uniform() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return (state >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // Reads what side i sent and schedules it for the other side
+    void pump(int i, uint64_t now) {
+        char buffer[RELIABLE_MTU];
+        ssize_t len;
+        while ((len = recv(facing[i], buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+            if (uniform() < loss) {
+                dropped++;
+                continue;
+            }
+            uint64_t release = now + delayUs + static_cast<uint64_t>(uniform() * jitterUs);
+            held.push(Held{release, facing[1 - i], sides[1 - i], std::string(buffer, len)});
+        }
+    }
+
+    void release(uint64_t now) {
+        while (!held.empty() && held.top().releaseUs <= now) {
+            const Held& h = held.top();
+            sendto(h.via, h.data.data(), h.data.size(), MSG_DONTWAIT, (const struct sockaddr *) &h.to, sizeof(h.to));
+            forwarded++;
+            held.pop();
+        }
+    }
+};
+
+struct RunResult {
+    int delivered;
+    bool inOrder;
+    double seconds;
+    double p50Ms, p99Ms, maxMs;
+    ReliableStats sender;
+    uint64_t proxyDropped;
+};
+
+static RunResult run(double loss, int messages, int rate, uint32_t delayUs, uint32_t jitterUs) {
+    sockaddr_in addrA, addrB;
+    int sockA = bindLoopback(addrA);
+    int sockB = bindLoopback(addrB);
+    LossyProxy proxy;
+    proxy.facing[0] = bindLoopback(proxy.addrs[0]);
+    proxy.facing[1] = bindLoopback(proxy.addrs[1]);
+    proxy.sides[0] = addrA;
+    proxy.sides[1] = addrB;
+    proxy.loss = loss;
+    proxy.delayUs = delayUs;
+    proxy.jitterUs = jitterUs;
+    proxy.state = 0x9E3779B97F4A7C15ull;
+    proxy.forwarded = proxy.dropped = 0;
+
+    ReliableChannel a(sockA, proxy.addrs[0], 1);
+    ReliableChannel b(sockB, proxy.addrs[1], 1);
+
+    std::vector<double> latencies;
+    std::vector<std::string> delivered;
+    int offered = 0, received = 0;
+    bool inOrder = true;
+    uint64_t start = nowUs();
+    uint64_t intervalUs = 1000000ull / rate;
+    char buffer[RELIABLE_MTU];
+
+    while (received < messages && nowUs() - start < RUN_LIMIT_US) {
+        uint64_t now = nowUs();
+
+        // Each message carries its number and when it was offered
+        while (offered < messages && start + offered * intervalUs <= now) {
+            char message[MESSAGE_BYTES];
+            memset(message, 'm', sizeof(message));
+            uint64_t stamp = now;
+            memcpy(message, &offered, sizeof(offered));
+            memcpy(message + 8, &stamp, sizeof(stamp));
+            if (!a.send(std::string(message, sizeof(message)))) {
+                break;
+            }
+            offered++;
+        }
+
+        proxy.pump(0, now);
+        proxy.pump(1, now);
+        proxy.release(now);
+
+        ssize_t len;
+        while ((len = recv(sockA, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+            a.onDatagram(buffer, len, now, delivered);
+        }
+        delivered.clear();
+        while ((len = recv(sockB, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+            b.onDatagram(buffer, len, now, delivered);
+        }
+        for (const std::string& message : delivered) {
+            int seq;
+            uint64_t stamp;
+            memcpy(&seq, message.data(), sizeof(seq));
+            memcpy(&stamp, message.data() + 8, sizeof(stamp));
+            inOrder = inOrder && seq == received;
+            received++;
+            latencies.push_back((now - stamp) / 1000.0);
+        }
+        delivered.clear();
+        a.poll(now);
+        b.poll(now);
+
+        // Sleep until the next offer, proxy release or retransmission
+        uint64_t wake = std::min(a.nextTimerUs(), b.nextTimerUs());
+        if (offered < messages) {
+            wake = std::min<uint64_t>(wake, start + offered * intervalUs);
+        }
+        if (!proxy.held.empty()) {
+            wake = std::min(wake, proxy.held.top().releaseUs);
+        }
+        now = nowUs();
+        struct pollfd fds[4] = {{sockA, POLLIN, 0}, {sockB, POLLIN, 0}, {proxy.facing[0], POLLIN, 0},
+                                {proxy.facing[1], POLLIN, 0}};
+        int timeoutMs = wake <= now ? 0 : static_cast<int>(std::min<uint64_t>((wake - now + 999) / 1000, 100));
+        poll(fds, 4, timeoutMs);
+    }
+
+    RunResult result;
+    result.delivered = received;
+    result.inOrder = inOrder;
+    result.seconds = (nowUs() - start) / 1e6;
+    std::sort(latencies.begin(), latencies.end());
+    result.p50Ms = latencies.empty() ? 0 : latencies[latencies.size() / 2];
+    result.p99Ms = latencies.empty() ? 0 : latencies[latencies.size() * 99 / 100];
+    result.maxMs = latencies.empty() ? 0 : latencies.back();
+    result.sender = a.stats();
+    result.proxyDropped = proxy.dropped;
+
+    close(sockA);
+    close(sockB);
+    close(proxy.facing[0]);
+    close(proxy.facing[1]);
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    int messages = argc > 1 ? atoi(argv[1]) : 20000;
+    int rate = argc > 2 ? atoi(argv[2]) : 5000;
+    uint32_t delayUs = argc > 3 ? atoi(argv[3]) : 1000;
+    uint32_t jitterUs = argc > 4 ? atoi(argv[4]) : 2000;
+    if (messages < 1 || rate < 1) {
+        fprintf(stderr, "Usage: %s [messages per run] [messages per second] [delay us] [jitter us]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%d messages of %d bytes at %d/s, %u us delay + up to %u us jitter each way\n", messages, MESSAGE_BYTES,
+           rate, delayUs, jitterUs);
+    printf("%5s %9s %9s %8s %8s %8s %9s %8s %8s %8s %6s\n", "loss", "delivered", "goodput", "p50 ms", "p99 ms",
+           "max ms", "msgs/dgm", "resent", "fast", "timeouts", "order");
+    const double losses[] = {0, 0.01, 0.05, 0.10, 0.20};
+    for (double loss : losses) {
+        RunResult r = run(loss, messages, rate, delayUs, jitterUs);
+        double goodputKBs = r.delivered * MESSAGE_BYTES / 1024.0 / r.seconds;
+        printf("%4.0f%% %9d %6.0f KB/s %8.2f %8.2f %8.2f %9.2f %8llu %8llu %8llu %6s\n", loss * 100, r.delivered,
+               goodputKBs, r.p50Ms, r.p99Ms, r.maxMs,
+               double(r.sender.transmissions) / std::max<uint64_t>(r.sender.datagrams, 1),
+               (unsigned long long) r.sender.retransmits, (unsigned long long) r.sender.fastRetransmits,
+               (unsigned long long) r.sender.timeouts, r.inOrder ? "ok" : "BROKEN");
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,115 @@
+// Fan-out benchmark for spectator updates. Sends each update of a run to
+// every spectator of one table over UDP loopback, once with a copy of the
+// update and a sendto() per spectator, and once through FanOut, which
+// shares one buffer across sendmmsg() batches. Spectators are spread over a
+// few bound sockets that never read; what they drop does not slow the sender.
+//
+// Usage: SpectatorFanOut [updates per run] [max spectators]
+
+#include "../src/FanOut.h"
+#include "../src/Utils.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#define RECEIVERS 64
+
+typedef std::chrono::steady_clock Clock;
+
+struct RunResult {
+    double usPerUpdate;
+    double nsPerSpectator;
+    double callsPerUpdate;
+    uint64_t dropped;
+};
+
+static RunResult perSpectator(int sock, const std::string& update, const std::vector<Endpoint>& audience, int updates) {
+    uint64_t calls = 0, dropped = 0;
+    Clock::time_point start = Clock::now();
+    for (int u = 0; u < updates; ++u) {
+        for (const Endpoint& e : audience) {
+            std::string copy = update; // One encoded message per subscriber
+            struct sockaddr_in to;
+            memset(&to, 0, sizeof(to));
+            to.sin_family = AF_INET;
+            to.sin_addr.s_addr = e.addr;
+            to.sin_port = e.port;
+            calls++;
+            if (sendto(sock, copy.data(), copy.size(), MSG_DONTWAIT, (struct sockaddr *) &to, sizeof(to)) < 0) {
+                dropped++;
+            }
+        }
+    }
+    double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    return RunResult{us / updates, us * 1000 / updates / audience.size(), double(calls) / updates, dropped};
+}
+
+static RunResult shared(int sock, const std::string& update, const std::vector<Endpoint>& audience, int updates) {
+    FanOut fan(sock);
+    Clock::time_point start = Clock::now();
+    for (int u = 0; u < updates; ++u) {
+        fan.send(update.data(), update.size(), audience.data(), audience.size());
+    }
+    double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    return RunResult{us / updates, us * 1000 / updates / audience.size(), double(fan.calls()) / updates, fan.dropped()};
+}
+
+int main(int argc, char* argv[]) {
+    int updates = argc > 1 ? atoi(argv[1]) : 50;
+    int maxSpectators = argc > 2 ? atoi(argv[2]) : 10000;
+
+    int sock = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    int sndbuf = 8 << 20;
+    setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    std::vector<int> receivers;
+    std::vector<uint16_t> ports;
+    for (int i = 0; i < RECEIVERS; ++i) {
+        int r = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (r < 0 || bind(r, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+            getsockname(r, (struct sockaddr *) &addr, &len) < 0) {
+            DieWithError("bench: receiver setup failed");
+        }
+        receivers.push_back(r);
+        ports.push_back(addr.sin_port);
+    }
+
+    const std::string delta = "DELTA 4711 17 3 carol 7H 2.4=QS";
+    const std::string key = "KEY 4711 32 3 carol 7H | alice 6D *** 4C *** *** JC | bob 9D *** 6H *** *** *** "
+                            "| carol QS *** *** 2H *** *** | dave *** 8S *** *** KD ***";
+
+    printf("%d updates per run, %d receiving sockets\n", updates, RECEIVERS);
+    printf("%10s %6s | %12s %12s %10s | %12s %12s %10s %8s\n", "spectators", "update", "sendto us/up", "ns/spect",
+           "calls/up", "fanout us/up", "ns/spect", "calls/up", "dropped");
+    for (int spectators = 10; spectators <= maxSpectators; spectators *= 10) {
+        std::vector<Endpoint> audience;
+        for (int i = 0; i < spectators; ++i) {
+            audience.push_back({htonl(INADDR_LOOPBACK), ports[i % RECEIVERS]});
+        }
+        const std::string* kinds[] = {&delta, &key};
+        for (const std::string* update : kinds) {
+            RunResult a = perSpectator(sock, *update, audience, updates);
+            RunResult b = shared(sock, *update, audience, updates);
+            printf("%10d %6zu | %12.1f %12.0f %10.1f | %12.1f %12.0f %10.1f %8llu\n", spectators, update->size(),
+                   a.usPerUpdate, a.nsPerSpectator, a.callsPerUpdate, b.usPerUpdate, b.nsPerSpectator, b.callsPerUpdate,
+                   (unsigned long long) (a.dropped + b.dropped));
+        }
+    }
+
+    for (int r : receivers) {
+        close(r);
+    }
+    close(sock);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,165 @@
+// Throughput benchmark for the tracker's transports. A client thread keeps a
+// window of QUERY_GAMES requests in flight against a tracker loop running
+// over each transport in turn, and the transport's counters give the server
+// side syscalls per request.
+//
+// Usage: TransportLoad [seconds per run] [requests in flight]
+
+#include "../src/TrackerServer.h"
+#include "../src/Transport.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+struct RunResult {
+    const char* name;
+    double requestsPerSec;
+    double syscallsPerRequest;
+};
+
+static int bindLoopback(unsigned short port) {
+    int sock = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (sock < 0 || bind(sock, (struct sockaddr*) &addr, sizeof(addr)) < 0)
+        DieWithError("bench: bind() failed");
+    return sock;
+}
+
+// Sends a window of requests, then answers each batch of replies with as
+// many new requests until told to stop
+static void client(unsigned short port, int window, std::atomic<bool>& stop) {
+    int sock = bindLoopback(0);
+    struct timeval timeout = {0, 100000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    struct sockaddr_in server;
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    server.sin_port = htons(port);
+
+    Message request;
+    memset(&request, 0, sizeof(request));
+    request.cmd = CMD_QUERY_GAMES;
+
+    std::vector<char> replies(window * 256);
+    std::vector<struct iovec> sendIov(window), recvIov(window);
+    std::vector<struct mmsghdr> out(window), in(window);
+    for (int i = 0; i < window; ++i) {
+        sendIov[i].iov_base = &request;
+        sendIov[i].iov_len = sizeof(request);
+        memset(&out[i], 0, sizeof(out[i]));
+        out[i].msg_hdr.msg_name = &server;
+        out[i].msg_hdr.msg_namelen = sizeof(server);
+        out[i].msg_hdr.msg_iov = &sendIov[i];
+        out[i].msg_hdr.msg_iovlen = 1;
+        recvIov[i].iov_base = &replies[i * 256];
+        recvIov[i].iov_len = 256;
+        memset(&in[i], 0, sizeof(in[i]));
+        in[i].msg_hdr.msg_iov = &recvIov[i];
+        in[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int inFlight = sendmmsg(sock, out.data(), window, 0);
+    while (!stop.load(std::memory_order_relaxed)) {
+        int got = recvmmsg(sock, in.data(), window, MSG_WAITFORONE, nullptr);
+        if (got <= 0) {
+            // Top the window back up if a request or reply was lost
+            inFlight = 0;
+            got = window;
+        } else {
+            inFlight -= got;
+        }
+        int sent = sendmmsg(sock, out.data(), got, 0);
+        if (sent > 0)
+            inFlight += sent;
+    }
+    (void) inFlight;
+    close(sock);
+}
+
+// The request loop of TrackerMain.cpp without admission control or logging
+static RunResult run(const std::string& kind, double seconds, int window, unsigned short port) {
+    TrackerServer server;
+    int sock = bindLoopback(port);
+    Transport* transport = createTransport(kind, sock);
+    std::vector<InboundDatagram> batch(TRANSPORT_MAX_BATCH);
+
+    std::atomic<bool> stop(false);
+    std::thread load(client, port, window, std::ref(stop));
+
+    Clock::time_point start = Clock::now();
+    TransportStats before = TransportStats();
+    bool measuring = false;
+    Clock::time_point measureStart = start;
+    for (;;) {
+        Clock::time_point now = Clock::now();
+        double elapsed = std::chrono::duration<double>(now - start).count();
+        // Skip the first tenth of the run while the window fills
+        if (!measuring && elapsed >= seconds * 0.1) {
+            measuring = true;
+            measureStart = now;
+            before = transport->stats();
+        }
+        if (elapsed >= seconds * 1.1)
+            break;
+
+        struct pollfd pfd = {transport->fd(), transport->pollEvents(), 0};
+        poll(&pfd, 1, 10);
+        transport->stats().syscalls++;
+        transport->ready(pfd.revents);
+
+        int depth = (pfd.revents & POLLIN) ? transport->receive(batch.data(), TRANSPORT_MAX_BATCH) : 0;
+        for (int i = 0; i < depth; ++i) {
+            Endpoint from = {batch[i].addr.sin_addr.s_addr, batch[i].addr.sin_port};
+            std::string response = server.handleCommand(*batch[i].msg, from);
+            transport->send(response.c_str(), response.length(), batch[i].addr);
+        }
+        transport->flush();
+    }
+
+    TransportStats after = transport->stats();
+    double measured = std::chrono::duration<double>(Clock::now() - measureStart).count();
+    stop = true;
+    load.join();
+
+    RunResult result;
+    result.name = transport->name();
+    uint64_t requests = after.received - before.received;
+    result.requestsPerSec = requests / measured;
+    result.syscallsPerRequest = requests ? static_cast<double>(after.syscalls - before.syscalls) / requests : 0;
+    delete transport;
+    close(sock);
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    double seconds = argc > 1 ? atof(argv[1]) : 2.0;
+    int window = argc > 2 ? atoi(argv[2]) : 32;
+    if (seconds <= 0 || window <= 0 || window > TRANSPORT_MAX_BATCH) {
+        fprintf(stderr, "Usage: %s [seconds per run] [requests in flight, 1-%d]\n", argv[0], TRANSPORT_MAX_BATCH);
+        return 1;
+    }
+
+    printf("%-10s %14s %18s\n", "transport", "requests/s", "syscalls/request");
+    const char* kinds[] = {"sockets", "io_uring"};
+    for (int k = 0; k < 2; ++k) {
+        RunResult r = run(kinds[k], seconds, window, static_cast<unsigned short>(17000 + k));
+        printf("%-10s %14.0f %18.3f\n", r.name, r.requestsPerSec, r.syscallsPerRequest);
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include "Admission.h"
+#include <cstdio>
+
+AdmissionControl::AdmissionControl() : admitted(0), retried(0), dropped(0), shed(0), lastReportMs(0) {
+    for (auto& bucket : table) {
+        bucket.used = false;
+    }
+}
+
+// Commands that serialise the registry or fan out to other nodes cost more
+double admissionCost(CommandType cmd) {
+    switch (cmd) {
+    case CMD_QUERY_PLAYERS:
+    case CMD_QUERY_GAMES:
+        return 10;
+    case CMD_MULTI:
+        return 16;
+    case CMD_START_GAME:
+    case CMD_QUERY_LEADERBOARD:
+        return 4;
+    case CMD_REGISTER:
+    case CMD_QUERY_PLAYERS_SINCE:
+    case CMD_QUERY_GAMES_SINCE:
+    case CMD_REPORT_RTT:
+        return 2;
+    default:
+        return 1;
+    }
+}
+
+// Finds or claims the bucket for a source address. When the probe window
+// is full, the stalest bucket in it is recycled, and the new source starts
+// with a full burst.
+AdmissionControl::Bucket& AdmissionControl::bucketFor(uint32_t addr, uint64_t nowMs) {
+    size_t start = static_cast<size_t>((addr * 0x9E3779B97F4A7C15ull) >> 32) & (ADMISSION_TABLE_SIZE - 1);
+    Bucket* victim = nullptr;
+    for (size_t i = 0; i < ADMISSION_PROBE; ++i) {
+        Bucket& bucket = table[(start + i) & (ADMISSION_TABLE_SIZE - 1)];
+        if (bucket.used && bucket.addr == addr) {
+            return bucket;
+        }
+        if (!bucket.used) {
+            if (victim == nullptr || victim->used) {
+                victim = &bucket;
+            }
+        } else if (victim == nullptr || (victim->used && bucket.lastMs < victim->lastMs)) {
+            victim = &bucket;
+        }
+    }
+    victim->addr = addr;
+    victim->used = true;
+    victim->tokens = ADMISSION_BURST;
+    victim->lastMs = nowMs;
+    return *victim;
+}
+
+AdmissionControl::Verdict AdmissionControl::admit(uint32_t addr, CommandType cmd, uint64_t nowMs, bool overloaded) {
+    Bucket& bucket = bucketFor(addr, nowMs);
+    bucket.tokens += (nowMs - bucket.lastMs) * (ADMISSION_RATE / 1000.0);
+    if (bucket.tokens > ADMISSION_BURST) {
+        bucket.tokens = ADMISSION_BURST;
+    }
+    bucket.lastMs = nowMs;
+
+    double cost = admissionCost(cmd);
+    double reserve = overloaded ? ADMISSION_BURST / 2 : 0;
+    if (bucket.tokens >= cost + reserve) {
+        bucket.tokens -= cost;
+        admitted++;
+        return ADMIT;
+    }
+    if (overloaded && bucket.tokens >= cost) {
+        shed++;
+        return DROP;
+    }
+
+    // The retry reply is charged too, so a source that keeps sending runs
+    // into silent drops
+    if (bucket.tokens > -ADMISSION_BURST) {
+        bucket.tokens -= 1;
+        retried++;
+        return RETRY_LATER;
+    }
+    dropped++;
+    return DROP;
+}
+
+// Prints once per second while anything is being refused
+void AdmissionControl::report(uint64_t nowMs) {
+    if (nowMs - lastReportMs < 1000) {
+        return;
+    }
+    if (retried + dropped + shed > 0) {
+        printf("admission: %llu admitted, %llu told to retry, %llu dropped, %llu shed under load\n",
+               (unsigned long long) admitted, (unsigned long long) retried, (unsigned long long) dropped,
+               (unsigned long long) shed);
+    }
+    admitted = retried = dropped = shed = 0;
+    lastReportMs = nowMs;
+}
\ No newline at end of file
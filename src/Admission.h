@@ -0,0 +1,51 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include "Utils.h"
+#include <cstddef>
+#include <cstdint>
+
+#define ADMISSION_TABLE_SIZE 4096   // Tracked source addresses, a power of two
+#define ADMISSION_PROBE 8           // Buckets searched before evicting the stalest
+#define ADMISSION_RATE 100.0        // Tokens refilled per second
+#define ADMISSION_BURST 200.0       // Bucket capacity
+#define ADMISSION_SHED_DEPTH 64     // Queued datagrams above which the server is overloaded
+
+// Per-source-address token buckets in a fixed-size table. Every command is
+// charged by how much work it causes, so registry dumps cost more than
+// registrations. A source that runs dry gets a cheap "retry later" reply
+// until it has also spent its burst on those replies, after which its
+// packets are dropped unanswered. While the server is overloaded, only
+// sources holding at least half a burst are admitted, which sheds the
+// flooders first and keeps well-behaved clients at full service.
+class AdmissionControl {
+public:
+    enum Verdict {
+        ADMIT,
+        RETRY_LATER,
+        DROP
+    };
+
+    AdmissionControl();
+
+    Verdict admit(uint32_t addr, CommandType cmd, uint64_t nowMs, bool overloaded);
+    void report(uint64_t nowMs);
+
+private:
+    struct Bucket {
+        uint32_t addr;
+        bool used;
+        double tokens;
+        uint64_t lastMs;
+    };
+
+    Bucket table[ADMISSION_TABLE_SIZE];
+    uint64_t admitted, retried, dropped, shed;
+    uint64_t lastReportMs;
+
+    Bucket& bucketFor(uint32_t addr, uint64_t nowMs);
+};
+
+double admissionCost(CommandType cmd);
+
+#endif // ADMISSION_H
\ No newline at end of file
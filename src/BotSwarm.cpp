@@ -0,0 +1,477 @@
+// Runs thousands of bot players against a tracker from one process, each as
+// a client session on the client runtime. Every table-size-th bot deals:
+// it starts games, plays every turn itself and ends each game with its
+// scores. The other bots stay registered and free so that dealers can seat
+// them, and acknowledge the START invitations the tracker pushes when they
+// are seated. Once the last dealer is done, every bot deregisters.
+//
+// Usage: BotSwarm <tracker ip> <tracker port> [bots] [loops] [games per dealer]
+//                 [table size] [holes] [think ms] [first source ip] [strategy directory]
+//
+// With a first source ip, bot i sends from that address plus i, so a
+// swarm on loopback is not rate-limited as a single address; 0 leaves it
+// out. With a strategy directory, dealers play the odd seats of each
+// variant from its <variant>.strategy table there, and greedily otherwise.
+
+#include "ClientRuntime.h"
+#include "GameLogic.h"
+#include "Strategy.h"
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#define SWARM_REGISTER_RATE 500  // Registrations per second the swarm spreads its start over
+#define SWARM_BACKOFF_MS 200     // Mean wait after a start finds too few free players
+
+// A game played out by its dealer one turn at a time, behind a virtual
+// interface so one bot class deals every variant
+class BotTable {
+public:
+    virtual ~BotTable() {}
+    virtual bool playTurn() = 0; // False once the game is over
+    virtual void scores(std::vector<int>& out) const = 0;
+};
+
+template <class Engine>
+class EngineTable : public BotTable {
+public:
+    EngineTable(int players, int holes, uint32_t seed, const StrategyTable* strategy)
+        : game(players, holes, seed), strategy(strategy) {}
+
+    // Plays the turn of whoever is to move. As in the simulator, odd seats
+    // play the strategy table when there is one; the table counts on
+    // another player ending the hole, so the greedy seats still do.
+    bool playTurn() {
+        if (game.isGameFinished()) {
+            return false;
+        }
+        if (strategy != nullptr && game.getCurrentPlayerTurn() % 2 == 1) {
+            const StrategyTable* table = strategy;
+            playGolfTurn(game,
+                [table](const typename Engine::Hand& hand, const Card& card) { return table->take<Engine>(hand, card); },
+                [table](const typename Engine::Hand& hand, const Card& card) { return table->keep<Engine>(hand, card); });
+        } else {
+            playGreedyTurn(game);
+        }
+        return !game.isGameFinished();
+    }
+
+    void scores(std::vector<int>& out) const {
+        typename Engine::Scores totals = game.getFinalScores();
+        out.assign(totals.begin(), totals.begin() + game.getNumPlayers());
+    }
+
+private:
+    Engine game;
+    const StrategyTable* strategy;
+};
+
+struct TableFactory {
+    int players;
+    int holes;
+    uint32_t seed;
+    const StrategyTable* strategy;
+    BotTable* table;
+
+    template <class Engine>
+    void run() {
+        table = new EngineTable<Engine>(players, holes, seed, strategy);
+    }
+};
+
+// Maps one variant's strategy file, keeping it only if it was generated
+// for that variant's grid
+struct StrategyLoader {
+    std::string path;
+    std::unique_ptr<StrategyTable> table;
+
+    template <class Engine>
+    void run() {
+        std::unique_ptr<StrategyTable> loaded(new StrategyTable);
+        std::string error;
+        if (loaded->load(path, error) && loaded->fits<Engine>()) {
+            table = std::move(loaded);
+        }
+    }
+};
+
+struct SwarmConfig {
+    int bots;
+    int games;
+    int tableSize;
+    int holes;
+    uint32_t thinkMs;
+};
+
+static std::atomic<int> dealersLeft(0);
+static std::atomic<uint64_t> gamesPlayed(0);
+static std::atomic<uint64_t> turnsPlayed(0);
+static std::atomic<uint64_t> startRetries(0);
+static std::atomic<uint64_t> failures(0);
+static std::atomic<uint64_t> invitations(0);
+static std::atomic<uint64_t> duplicateInvitations(0);
+static ClientRuntime* swarm = nullptr;
+static std::vector<std::unique_ptr<StrategyTable>> strategies; // By variant; null plays greedily
+
+class Bot : public ClientSession {
+public:
+    Bot(const std::string& name, const std::string& ip, bool dealer, const SwarmConfig& config)
+        : name(name), ip(ip), dealer(dealer), config(config), step(REGISTERING), gamesLeft(config.games), gameId(0),
+          table(nullptr), stopping(false), lastInvitation(0) {}
+
+    ~Bot() { delete table; }
+
+    void resume(SessionEvent event, const char* text) {
+        // A game in progress is finished and ended first, so no player
+        // is left in play
+        if (event == SESSION_STOP) {
+            stopping = true;
+            if (step == PLAYING) {
+                play();
+            } else if (step == ENDING) {
+                endGame(gameId, finalScores);
+            } else {
+                leave();
+            }
+            return;
+        }
+        if (event == SESSION_TIMEOUT) {
+            failures++;
+        }
+        if (event == SESSION_PUSH) {
+            accept(text);
+            if (step == IDLE) {
+                waitForPush();
+                return;
+            }
+            event = SESSION_WAKE; // The push cut a sleep short
+        }
+
+        switch (step) {
+        case REGISTERING:
+            if (event == SESSION_START) {
+                sleep(random(rampMs()));
+                return;
+            }
+            if (event == SESSION_WAKE) {
+                registerPlayer(name, ip, ntohs(localAddress().sin_port), ntohs(localAddress().sin_port));
+                return;
+            }
+            if (event != SESSION_REPLY || strncmp(text, "SUCCESS", 7) != 0) {
+                failures++;
+                if (dealer && --dealersLeft == 0) {
+                    runtime().stop();
+                }
+                finish();
+                return;
+            }
+            if (!dealer) {
+                step = IDLE;
+                waitForPush();
+                return;
+            }
+            // Start once the others have had time to register
+            step = STARTING;
+            sleep(rampMs());
+            return;
+
+        case IDLE:
+            waitForPush();
+            return;
+
+        case STARTING:
+            if (event == SESSION_WAKE) {
+                startGame(config.tableSize - 1, config.holes);
+                return;
+            }
+            if (event == SESSION_REPLY && strncmp(text, "SUCCESS START_GAME", 18) == 0) {
+                // "SUCCESS START_GAME <game_id> <holes> <count> ... <variant>"
+                int holes = 0, count = 0;
+                sscanf(text + 18, "%u %d %d", &gameId, &holes, &count);
+                std::istringstream reply(text);
+                std::string token, variantName;
+                while (reply >> token) {
+                    variantName = token;
+                }
+                int variant = std::max(findGolfVariant(variantName), 0);
+                const StrategyTable* strategy = strategies.empty() ? nullptr : strategies[variant].get();
+                TableFactory factory = {count, holes, random(UINT32_MAX), strategy, nullptr};
+                visitGolfVariant(variant, factory);
+                table = factory.table;
+                step = PLAYING;
+                play();
+                return;
+            }
+            // Too few free players right now, or no reply: try again shortly
+            startRetries++;
+            sleep(SWARM_BACKOFF_MS / 2 + random(SWARM_BACKOFF_MS));
+            return;
+
+        case PLAYING:
+            play();
+            return;
+
+        case ENDING:
+            if (event == SESSION_TIMEOUT) {
+                endGame(gameId, finalScores);
+                return;
+            }
+            if (strncmp(text, "SUCCESS", 7) != 0) {
+                failures++;
+            }
+            gamesPlayed++;
+            if (--gamesLeft > 0 && !stopping) {
+                step = STARTING;
+                sleep(random(config.thinkMs + 1));
+                return;
+            }
+            if (stopping) {
+                leave();
+                return;
+            }
+            // Other dealers may still seat us, so leave only with everyone else
+            if (--dealersLeft == 0) {
+                runtime().stop();
+            }
+            step = IDLE;
+            waitForPush();
+            return;
+
+        case LEAVING:
+            if (event == SESSION_WAKE) {
+                deregisterPlayer();
+                return;
+            }
+            finish();
+            return;
+        }
+    }
+
+private:
+    enum Step { REGISTERING, IDLE, STARTING, PLAYING, ENDING, LEAVING };
+
+    std::string name;
+    std::string ip; // Advertised to the tracker
+    bool dealer;
+    const SwarmConfig& config;
+    Step step;
+    int gamesLeft;
+    uint32_t gameId;
+    BotTable* table; // Only while dealing
+    bool stopping;
+    uint32_t lastInvitation;
+    std::vector<int> finalScores;
+
+    uint32_t rampMs() const { return std::max(config.bots * 1000 / SWARM_REGISTER_RATE, 1); }
+
+    // One turn per think time, or the whole game at once without one
+    void play() {
+        bool more;
+        do {
+            more = table->playTurn();
+            turnsPlayed++;
+        } while (more && (config.thinkMs == 0 || stopping));
+        if (more) {
+            sleep(config.thinkMs);
+            return;
+        }
+        table->scores(finalScores);
+        delete table;
+        table = nullptr;
+        step = ENDING;
+        endGame(gameId, finalScores);
+    }
+
+    // "START <game_id> ...": another dealer seated us. Every copy is
+    // acknowledged, since the tracker resends until one acknowledgement
+    // gets through.
+    void accept(const char* text) {
+        uint32_t invitedTo = 0;
+        if (sscanf(text, "START %u", &invitedTo) != 1) {
+            return;
+        }
+        post(CMD_START_ACK, std::to_string(invitedTo) + " " + self());
+        if (invitedTo != lastInvitation) {
+            lastInvitation = invitedTo;
+            invitations++;
+        } else {
+            duplicateInvitations++;
+        }
+    }
+
+    // Spread like registration, since every bot leaves at once. Also
+    // restarts a deregistration that a stop cut short.
+    void leave() {
+        if (sessionToken() == 0) {
+            finish();
+            return;
+        }
+        step = LEAVING;
+        sleep(random(rampMs()));
+    }
+};
+
+static void stopSwarm(int) {
+    if (swarm != nullptr) {
+        swarm->stop();
+    }
+}
+
+static long residentKb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0) {
+            return atol(line.c_str() + 6);
+        }
+    }
+    return 0;
+}
+
+// The address this host sends to the tracker from, which bots advertise
+// when they are not given source addresses of their own
+static std::string outboundIP(const char* trackerIP, int port) {
+    int sock = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr(trackerIP);
+    addr.sin_port = htons(port);
+    socklen_t len = sizeof(addr);
+    std::string ip = trackerIP;
+    if (sock >= 0 && connect(sock, (struct sockaddr *) &addr, sizeof(addr)) == 0 &&
+        getsockname(sock, (struct sockaddr *) &addr, &len) == 0) {
+        ip = inet_ntoa(addr.sin_addr);
+    }
+    if (sock >= 0) {
+        close(sock);
+    }
+    return ip;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <tracker ip> <tracker port> [bots] [loops] [games per dealer] [table size 2-%d]\n"
+                        "       [holes 1-%d] [think ms] [first source ip|0] [strategy directory]\n", argv[0], MAX_PLAYERS, GOLF_MAX_HOLES);
+        return 1;
+    }
+    int port = atoi(argv[2]);
+    int loops = argc > 4 ? atoi(argv[4]) : 2;
+    SwarmConfig config;
+    config.bots = argc > 3 ? atoi(argv[3]) : 1000;
+    config.games = argc > 5 ? atoi(argv[5]) : 3;
+    config.tableSize = argc > 6 ? atoi(argv[6]) : MAX_PLAYERS;
+    config.holes = argc > 7 ? atoi(argv[7]) : GOLF_MAX_HOLES;
+    config.thinkMs = argc > 8 ? static_cast<uint32_t>(atoi(argv[8])) : 0;
+    uint32_t firstSource = argc > 9 ? ntohl(inet_addr(argv[9])) : 0;
+    if (config.bots < 1 || loops < 1 || config.games < 1 || config.tableSize < 2 || config.tableSize > MAX_PLAYERS ||
+        config.holes < 1 || config.holes > GOLF_MAX_HOLES) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+    if (argc > 10) {
+        int found = 0;
+        for (int v = 0; v < golfVariantCount(); ++v) {
+            StrategyLoader loader;
+            loader.path = std::string(argv[10]) + "/" + golfVariant(v).name + ".strategy";
+            visitGolfVariant(v, loader);
+            found += loader.table ? 1 : 0;
+            strategies.push_back(std::move(loader.table));
+        }
+        if (found == 0) {
+            fprintf(stderr, "No strategy table for any variant in %s\n", argv[10]);
+            return 1;
+        }
+        printf("Dealers play from %d strategy tables in %s\n", found, argv[10]);
+    }
+    std::string ip = outboundIP(argv[1], port);
+
+    // A socket per bot
+    struct rlimit files;
+    getrlimit(RLIMIT_NOFILE, &files);
+    files.rlim_cur = files.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &files);
+    if (files.rlim_cur < static_cast<rlim_t>(config.bots) + 64) {
+        fprintf(stderr, "Open file limit %llu is too low for %d config.bots\n", (unsigned long long) files.rlim_cur, config.bots);
+        return 1;
+    }
+
+    long baseKb = residentKb();
+    ClientRuntime runtime(argv[1], port, loops);
+    std::vector<Bot*> all;
+    std::string prefix = "b" + std::to_string(getpid() % 100000) + "_";
+    for (int i = 0; i < config.bots; ++i) {
+        bool dealer = i % config.tableSize == 0;
+        struct in_addr source;
+        source.s_addr = firstSource != 0 ? htonl(firstSource + i) : 0;
+        Bot* bot = new Bot(prefix + std::to_string(i), source.s_addr != 0 ? inet_ntoa(source) : ip, dealer, config);
+        std::string error;
+        if (!runtime.add(bot, source.s_addr, error)) {
+            fprintf(stderr, "Bot %d: %s\n", i, error.c_str());
+            return 1;
+        }
+        all.push_back(bot);
+        dealersLeft += dealer ? 1 : 0;
+    }
+
+    swarm = &runtime;
+    signal(SIGINT, stopSwarm);
+    signal(SIGTERM, stopSwarm);
+    printf("%d config.bots on %d loop threads, %d dealers playing %d games each\n", config.bots, loops, dealersLeft.load(), config.games);
+
+    // Progress once per second while the loops run
+    std::atomic<bool> finished(false);
+    long peakKb = residentKb();
+    std::thread reporter([&]() {
+        RuntimeStats last = RuntimeStats();
+        uint64_t lastGames = 0;
+        while (!finished) {
+            for (int i = 0; i < 10 && !finished; ++i) {
+                usleep(100000);
+            }
+            RuntimeStats now;
+            runtime.stats(now);
+            peakKb = std::max(peakKb, residentKb());
+            printf("%zu live, %llu requests/s, %llu games/s, p50 %.2f ms, p99 %.2f ms, %llu resends, %llu rate-limited, "
+                   "%llu timeouts\n", runtime.live(), (unsigned long long) (now.requests - last.requests),
+                   (unsigned long long) (gamesPlayed - lastGames), ClientRuntime::percentileUs(now, 0.5) / 1000.0,
+                   ClientRuntime::percentileUs(now, 0.99) / 1000.0, (unsigned long long) now.resends,
+                   (unsigned long long) now.retryLaters, (unsigned long long) now.timeouts);
+            last = now;
+            lastGames = gamesPlayed;
+        }
+    });
+
+    uint64_t startUs = runtimeClockUs();
+    runtime.run();
+    double seconds = (runtimeClockUs() - startUs) / 1e6;
+    finished = true;
+    reporter.join();
+
+    RuntimeStats total;
+    runtime.stats(total);
+    printf("%.1f s: %llu games, %llu turns, %llu requests (%.0f/s), %llu start retries, %llu failures\n", seconds,
+           (unsigned long long) gamesPlayed.load(), (unsigned long long) turnsPlayed.load(),
+           (unsigned long long) total.requests, total.requests / seconds, (unsigned long long) startRetries.load(),
+           (unsigned long long) failures.load());
+    printf("%llu invitations to %llu seats, %llu repeated\n", (unsigned long long) invitations.load(),
+           (unsigned long long) gamesPlayed.load() * (config.tableSize - 1), (unsigned long long) duplicateInvitations.load());
+    printf("request p50 %.2f ms, p99 %.2f ms; %d threads; peak resident %ld KB, %.2f KB per bot above the base\n",
+           ClientRuntime::percentileUs(total, 0.5) / 1000.0, ClientRuntime::percentileUs(total, 0.99) / 1000.0, loops + 2,
+           peakKb, static_cast<double>(peakKb - baseKb) / config.bots);
+    for (Bot* bot : all) {
+        delete bot;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,559 @@
+#include "ClientRuntime.h"
+#include "LocalChannel.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define RUNTIME_EPOLL_BATCH 256
+
+// A loop's sessions and timers. Timers are not removed when a wait ends
+// early; their generation no longer matches the session's and they are
+// skipped when they come due. Other threads hand the loop work through
+// the inbox and then write wakeFd.
+struct RuntimeLoop {
+    struct Timer {
+        uint64_t atUs;
+        ClientSession* session;
+        uint32_t generation;
+        bool operator>(const Timer& other) const { return atUs > other.atUs; }
+    };
+
+    // A notify() when datagram is false, else text read from a local channel
+    struct Inbound {
+        ClientSession* session;
+        bool datagram;
+        std::string text;
+    };
+
+    int epollFd;
+    int wakeFd; // Written by stop() and with each inbox entry
+    std::thread thread;
+    std::vector<std::thread> readers; // One per session on a local channel
+    std::mutex inboxMutex;
+    std::vector<Inbound> inbox;
+    std::vector<ClientSession*> sessions;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    size_t live;
+    std::mt19937 rng;
+    ClientRuntime* runtime;
+};
+
+uint64_t runtimeClockUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ClientSession::ClientSession()
+    : loop(nullptr), sock(-1), channel(nullptr), pendingCmd(CMD_REGISTER), firstSentUs(0), generation(0), token(0),
+      sends(0), retryLaters(0), redirects(0), waitingReply(false), pendingToTracker(true), viaLocal(false),
+      sleeping(false), suspended(false), stopped(false), done(false) {
+    memset(&tracker, 0, sizeof(tracker));
+    memset(&local, 0, sizeof(local));
+    memset(&pendingTo, 0, sizeof(pendingTo));
+}
+
+ClientSession::~ClientSession() {
+    if (sock >= 0) {
+        close(sock);
+    }
+    delete channel;
+}
+
+void ClientSession::request(CommandType cmd, const std::string& data) {
+    pendingToTracker = true;
+    startRequest(cmd, data);
+}
+
+void ClientSession::request(const sockaddr_in& to, CommandType cmd, const std::string& data) {
+    pendingTo = to;
+    pendingToTracker = false;
+    startRequest(cmd, data);
+}
+
+void ClientSession::startRequest(CommandType cmd, const std::string& data) {
+    pendingCmd = cmd;
+    pendingData = data;
+    sends = 0;
+    retryLaters = 0;
+    redirects = 0;
+    waitingReply = true;
+    suspended = true;
+    firstSentUs = runtimeClockUs();
+    loop->runtime->requests++;
+    loop->runtime->transmit(*this);
+    loop->runtime->arm(*loop, *this, firstSentUs + RUNTIME_REQUEST_TIMEOUT_MS * 1000);
+}
+
+void ClientSession::sleep(uint32_t ms) {
+    sleeping = true;
+    suspended = true;
+    loop->runtime->arm(*loop, *this, runtimeClockUs() + static_cast<uint64_t>(ms) * 1000);
+}
+
+void ClientSession::waitForPush() {
+    suspended = true;
+}
+
+void ClientSession::finish() {
+    done = true;
+    suspended = true;
+}
+
+void ClientSession::post(CommandType cmd, const std::string& data) {
+    loop->runtime->transmit(*this, cmd, data, nullptr);
+}
+
+void ClientSession::post(const sockaddr_in& to, CommandType cmd, const std::string& data) {
+    loop->runtime->transmit(*this, cmd, data, &to);
+}
+
+void ClientSession::registerPlayer(const std::string& name, const std::string& ip, int tPort, int pPort) {
+    request(CMD_REGISTER, name + " " + ip + " " + std::to_string(tPort) + " " + std::to_string(pPort));
+}
+
+void ClientSession::startGame(int n, int holes, const std::string& variant) {
+    std::string data = self() + " " + std::to_string(n) + " " + std::to_string(holes);
+    if (!variant.empty()) {
+        data += " " + variant;
+    }
+    request(CMD_START_GAME, data);
+}
+
+void ClientSession::endGame(uint32_t gameId, const std::vector<int>& scores) {
+    std::string data = std::to_string(gameId) + " " + self();
+    for (int score : scores) {
+        data += " " + std::to_string(score);
+    }
+    request(CMD_END_GAME, data);
+}
+
+void ClientSession::deregisterPlayer() {
+    request(CMD_DEREGISTER, self());
+}
+
+uint32_t ClientSession::random(uint32_t bound) {
+    return bound == 0 ? 0 : std::uniform_int_distribution<uint32_t>(0, bound - 1)(loop->rng);
+}
+
+ClientRuntime& ClientSession::runtime() {
+    return *loop->runtime;
+}
+
+ClientRuntime::ClientRuntime(const char* trackerIP, unsigned short trackerPort, int loopCount)
+    : total(0), active(0), stopping(false), loopsDone(false), requests(0), replies(0), resends(0), retryLaters(0), timeouts(0), pushes(0) {
+    memset(&trackerAddr, 0, sizeof(trackerAddr));
+    trackerAddr.sin_family = AF_INET;
+    trackerAddr.sin_addr.s_addr = inet_addr(trackerIP);
+    trackerAddr.sin_port = htons(trackerPort);
+    for (int i = 0; i < RUNTIME_LATENCY_BUCKETS; ++i) {
+        latency[i] = 0;
+    }
+
+    for (int i = 0; i < std::max(loopCount, 1); ++i) {
+        RuntimeLoop* loop = new RuntimeLoop();
+        loop->epollFd = epoll_create1(0);
+        loop->wakeFd = eventfd(0, EFD_NONBLOCK);
+        if (loop->epollFd < 0 || loop->wakeFd < 0) DieWithError("epoll_create1() or eventfd() failed");
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;
+        epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, loop->wakeFd, &ev);
+        loop->live = 0;
+        loop->rng.seed(std::random_device()());
+        loop->runtime = this;
+        loops.push_back(loop);
+    }
+}
+
+ClientRuntime::~ClientRuntime() {
+    for (RuntimeLoop* loop : loops) {
+        close(loop->epollFd);
+        close(loop->wakeFd);
+        delete loop;
+    }
+}
+
+bool ClientRuntime::add(ClientSession* session, uint32_t sourceAddr, std::string& error) {
+    int sock = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        error = std::string("socket() failed: ") + strerror(errno);
+        return false;
+    }
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = sourceAddr;
+    socklen_t addrLen = sizeof(addr);
+    if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0 || getsockname(sock, (struct sockaddr *) &addr, &addrLen) < 0) {
+        error = std::string("bind() failed: ") + strerror(errno);
+        close(sock);
+        return false;
+    }
+
+    RuntimeLoop* loop = loops[total % loops.size()];
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = session;
+    if (epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, sock, &ev) < 0) {
+        error = std::string("epoll_ctl() failed: ") + strerror(errno);
+        close(sock);
+        return false;
+    }
+    session->sock = sock;
+    session->tracker = trackerAddr;
+    session->local = addr;
+    session->loop = loop;
+    loop->sessions.push_back(session);
+    loop->live++;
+    total++;
+    active++;
+    return true;
+}
+
+bool ClientRuntime::attachLocal(ClientSession* session, unsigned short trackerPort, std::string& error) {
+    LocalChannelClient* channel = new LocalChannelClient();
+    if (!channel->attach(trackerPort, error)) {
+        delete channel;
+        return false;
+    }
+    session->channel = channel;
+    session->viaLocal = true;
+    return true;
+}
+
+void ClientRuntime::run() {
+    for (RuntimeLoop* loop : loops) {
+        for (ClientSession* session : loop->sessions) {
+            if (session->channel != nullptr) {
+                loop->readers.push_back(std::thread(&ClientRuntime::readLocal, this, std::ref(*loop), std::ref(*session)));
+            }
+        }
+        loop->thread = std::thread(&ClientRuntime::runLoop, this, std::ref(*loop));
+    }
+    for (RuntimeLoop* loop : loops) {
+        loop->thread.join();
+    }
+    loopsDone = true;
+    for (RuntimeLoop* loop : loops) {
+        for (std::thread& reader : loop->readers) {
+            reader.join();
+        }
+        loop->readers.clear();
+    }
+}
+
+void ClientRuntime::stop() {
+    stopping = true;
+    uint64_t one = 1;
+    for (RuntimeLoop* loop : loops) {
+        if (write(loop->wakeFd, &one, sizeof(one)) < 0) {
+            perror("write() to a runtime loop failed");
+        }
+    }
+}
+
+void ClientRuntime::notify(ClientSession* session) {
+    RuntimeLoop* loop = session->loop;
+    {
+        std::lock_guard<std::mutex> lock(loop->inboxMutex);
+        loop->inbox.push_back(RuntimeLoop::Inbound{session, false, std::string()});
+    }
+    uint64_t one = 1;
+    if (write(loop->wakeFd, &one, sizeof(one)) < 0) {
+        perror("write() to a runtime loop failed");
+    }
+}
+
+// The channel has no descriptor to wait on with epoll, so a thread sleeps
+// in it and hands what arrives to the session's loop
+void ClientRuntime::readLocal(RuntimeLoop& loop, ClientSession& session) {
+    char buffer[ECHOMAX];
+    while (!loopsDone) {
+        if (session.channel->receive(buffer, sizeof(buffer), 100) <= 0) {
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(loop.inboxMutex);
+            loop.inbox.push_back(RuntimeLoop::Inbound{&session, true, buffer});
+        }
+        uint64_t one = 1;
+        if (write(loop.wakeFd, &one, sizeof(one)) < 0) {
+            perror("write() to a runtime loop failed");
+        }
+    }
+}
+
+void ClientRuntime::drainInbox(RuntimeLoop& loop) {
+    std::vector<RuntimeLoop::Inbound> inbound;
+    {
+        std::lock_guard<std::mutex> lock(loop.inboxMutex);
+        inbound.swap(loop.inbox);
+    }
+    for (const RuntimeLoop::Inbound& entry : inbound) {
+        if (entry.session->done) {
+            continue;
+        }
+        if (entry.datagram) {
+            receive(loop, *entry.session, entry.text.c_str());
+        } else {
+            offer(loop, *entry.session, SESSION_INPUT, nullptr);
+        }
+    }
+}
+
+void ClientRuntime::stats(RuntimeStats& out) const {
+    out.requests = requests.load();
+    out.replies = replies.load();
+    out.resends = resends.load();
+    out.retryLaters = retryLaters.load();
+    out.timeouts = timeouts.load();
+    out.pushes = pushes.load();
+    for (int i = 0; i < RUNTIME_LATENCY_BUCKETS; ++i) {
+        out.latency[i] = latency[i].load();
+    }
+}
+
+// Upper bound of the bucket holding the given fraction of round trips
+uint64_t ClientRuntime::percentileUs(const RuntimeStats& stats, double fraction) {
+    uint64_t count = 0;
+    for (int i = 0; i < RUNTIME_LATENCY_BUCKETS; ++i) {
+        count += stats.latency[i];
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < RUNTIME_LATENCY_BUCKETS; ++i) {
+        seen += stats.latency[i];
+        if (count > 0 && seen >= fraction * count) {
+            return static_cast<uint64_t>(std::pow(2.0, (i + 1) / 4.0));
+        }
+    }
+    return 0;
+}
+
+void ClientRuntime::arm(RuntimeLoop& loop, ClientSession& session, uint64_t atUs) {
+    RuntimeLoop::Timer timer = {atUs, &session, ++session.generation};
+    loop.timers.push(timer);
+}
+
+void ClientRuntime::transmit(ClientSession& session) {
+    session.sends++;
+    transmit(session, session.pendingCmd, session.pendingData, session.pendingToTracker ? nullptr : &session.pendingTo);
+}
+
+// To the tracker when to is null
+void ClientRuntime::transmit(ClientSession& session, CommandType cmd, const std::string& data, const sockaddr_in* to) {
+    Message msg;
+    msg.cmd = cmd;
+    size_t len = std::min(data.size(), sizeof(msg.data) - 1);
+    memcpy(msg.data, data.data(), len);
+    msg.data[len] = '\0';
+    if (to == nullptr && session.viaLocal) {
+        session.channel->send(msg);
+        return;
+    }
+    // Only the used part of the message goes out; the server terminates it
+    const sockaddr_in& addr = to != nullptr ? *to : session.tracker;
+    sendto(session.sock, &msg, offsetof(Message, data) + len + 1, 0, (struct sockaddr *) &addr, sizeof(addr));
+}
+
+// Runs the flow until it waits again. Pushes and inputs held back during a
+// request are handed over, in order, as soon as the flow is between requests.
+void ClientRuntime::deliver(RuntimeLoop& loop, ClientSession& session, SessionEvent event, const char* text) {
+    std::pair<SessionEvent, std::string> next;
+    while (!session.done) {
+        session.suspended = false;
+        session.resume(event, text);
+        if (!session.suspended) {
+            fprintf(stderr, "client session returned without waiting; finishing it\n");
+            session.done = true;
+        }
+        if (session.done || session.waitingReply || session.held.empty()) {
+            break;
+        }
+        session.sleeping = false;
+        session.generation++;
+        next = std::move(session.held.front());
+        session.held.pop_front();
+        event = next.first;
+        text = event == SESSION_PUSH ? next.second.c_str() : nullptr;
+    }
+    if (session.done) {
+        session.generation++;
+        session.waitingReply = false;
+        session.sleeping = false;
+        session.held.clear();
+        epoll_ctl(loop.epollFd, EPOLL_CTL_DEL, session.sock, nullptr);
+        loop.live--;
+        active--;
+    }
+}
+
+// Hands a push or an input to the flow now, ending a sleep, or after the
+// pending request
+void ClientRuntime::offer(RuntimeLoop& loop, ClientSession& session, SessionEvent event, const char* text) {
+    if (session.waitingReply) {
+        if (session.held.size() < RUNTIME_MAX_HELD) {
+            session.held.push_back(std::make_pair(event, std::string(text != nullptr ? text : "")));
+        }
+        return;
+    }
+    session.sleeping = false;
+    session.generation++;
+    deliver(loop, session, event, text);
+}
+
+void ClientRuntime::receive(RuntimeLoop& loop, ClientSession& session, const char* text) {
+    bool reply = strncmp(text, "SUCCESS ", 8) == 0 || strncmp(text, "FAILURE ", 8) == 0 ||
+                 strncmp(text, "REDIRECT ", 9) == 0;
+    if (!reply) {
+        pushes++;
+        offer(loop, session, SESSION_PUSH, text);
+        return;
+    }
+
+    // Replies to an earlier request, such as a duplicate after a resend, are dropped
+    const char* command = cmdToString(session.pendingCmd);
+    size_t commandLen = strlen(command);
+    const char* rest = text + (text[0] == 'R' ? 9 : 8);
+    if (!session.waitingReply || strncmp(rest, command, commandLen) != 0 || (rest[commandLen] != ' ' && rest[commandLen] != '\0')) {
+        return;
+    }
+
+    uint64_t now = runtimeClockUs();
+    if (text[0] == 'R') {
+        // "REDIRECT <CMD> <ip> <port>": another cluster node owns the player.
+        // The local channel only reaches this host's tracker.
+        char ip[INET_ADDRSTRLEN];
+        int port;
+        if (session.pendingToTracker && session.redirects < RUNTIME_MAX_REDIRECTS &&
+            sscanf(rest + commandLen, " %15s %d", ip, &port) == 2) {
+            session.redirects++;
+            session.viaLocal = false;
+            session.tracker.sin_addr.s_addr = inet_addr(ip);
+            session.tracker.sin_port = htons(port);
+            session.sends = 0;
+            transmit(session);
+            arm(loop, session, now + RUNTIME_REQUEST_TIMEOUT_MS * 1000);
+            return;
+        }
+    } else if (text[0] == 'F' && session.retryLaters < RUNTIME_MAX_RETRY_LATER && strstr(rest, "retry later") != nullptr) {
+        // Jittered so that rate-limited sessions do not come back together
+        retryLaters++;
+        uint32_t meanMs = RUNTIME_RETRY_LATER_MS << std::min<int>(session.retryLaters++, 4);
+        session.sends = 0;
+        arm(loop, session, now + (meanMs / 2 + session.random(meanMs)) * 1000ULL);
+        return;
+    }
+
+    if (strncmp(text, "SUCCESS REGISTER", 16) == 0) {
+        session.token = strtoul(text + 16, nullptr, 10);
+    } else if (strncmp(text, "SUCCESS DEREGISTER", 18) == 0) {
+        session.token = 0;
+    }
+    uint64_t us = std::max<uint64_t>(now - session.firstSentUs, 1);
+    int bucket = std::min(static_cast<int>(std::log2(static_cast<double>(us)) * 4), RUNTIME_LATENCY_BUCKETS - 1);
+    latency[bucket]++;
+    replies++;
+    session.waitingReply = false;
+    session.generation++;
+    deliver(loop, session, SESSION_REPLY, text);
+}
+
+// A request's wait ran out: resend it, or give up after the last send. A
+// wait after a rate-limited reply ends in a resend too.
+void ClientRuntime::expire(RuntimeLoop& loop, ClientSession& session) {
+    uint64_t now = runtimeClockUs();
+    if (session.waitingReply) {
+        if (session.sends < RUNTIME_MAX_SENDS) {
+            if (session.sends > 0) {
+                resends++;
+            }
+            uint64_t waitMs = static_cast<uint64_t>(RUNTIME_REQUEST_TIMEOUT_MS) << session.sends;
+            transmit(session);
+            arm(loop, session, now + waitMs * 1000);
+            return;
+        }
+        timeouts++;
+        session.waitingReply = false;
+        session.generation++;
+        deliver(loop, session, SESSION_TIMEOUT, nullptr);
+    } else if (session.sleeping) {
+        session.sleeping = false;
+        session.generation++;
+        deliver(loop, session, SESSION_WAKE, nullptr);
+    }
+}
+
+void ClientRuntime::runLoop(RuntimeLoop& loop) {
+    for (ClientSession* session : loop.sessions) {
+        deliver(loop, *session, SESSION_START, nullptr);
+    }
+
+    struct epoll_event events[RUNTIME_EPOLL_BATCH];
+    char buffer[ECHOMAX];
+    bool stopSeen = false;
+    while (loop.live > 0) {
+        int timeoutMs = -1;
+        if (!loop.timers.empty()) {
+            uint64_t now = runtimeClockUs();
+            uint64_t at = loop.timers.top().atUs;
+            timeoutMs = at <= now ? 0 : static_cast<int>(std::min<uint64_t>((at - now + 999) / 1000, 1000));
+        }
+        int ready = epoll_wait(loop.epollFd, events, RUNTIME_EPOLL_BATCH, timeoutMs);
+        for (int i = 0; i < ready; ++i) {
+            ClientSession* session = static_cast<ClientSession*>(events[i].data.ptr);
+            if (session == nullptr) {
+                uint64_t count;
+                if (read(loop.wakeFd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                    perror("read() from the wake eventfd failed");
+                }
+                drainInbox(loop);
+                continue;
+            }
+            int len;
+            while (!session->done && (len = recv(session->sock, buffer, sizeof(buffer) - 1, 0)) > 0) {
+                buffer[len] = '\0';
+                receive(loop, *session, buffer);
+            }
+        }
+
+        // Every unfinished session hears about a stop once
+        if (stopping && !stopSeen) {
+            stopSeen = true;
+            for (ClientSession* session : loop.sessions) {
+                if (!session->done && !session->stopped) {
+                    session->stopped = true;
+                    session->waitingReply = false;
+                    session->sleeping = false;
+                    session->generation++;
+                    session->held.clear();
+                    deliver(loop, *session, SESSION_STOP, nullptr);
+                }
+            }
+        }
+
+        uint64_t now = runtimeClockUs();
+        while (!loop.timers.empty() && loop.timers.top().atUs <= now) {
+            RuntimeLoop::Timer timer = loop.timers.top();
+            loop.timers.pop();
+            if (timer.generation == timer.session->generation && !timer.session->done) {
+                expire(loop, *timer.session);
+            }
+        }
+    }
+}
\ No newline at end of file
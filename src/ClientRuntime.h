@@ -0,0 +1,176 @@
+#ifndef CLIENT_RUNTIME_H
+#define CLIENT_RUNTIME_H
+
+#include "Utils.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <netinet/in.h>
+
+#define RUNTIME_REQUEST_TIMEOUT_MS 1000 // Wait before the first resend; doubles with each resend
+#define RUNTIME_MAX_SENDS 4             // Sends of one request before it times out
+#define RUNTIME_RETRY_LATER_MS 200      // Mean wait after a rate-limited reply; doubles with each one
+#define RUNTIME_MAX_RETRY_LATER 8       // Rate-limited replies before the flow sees one
+#define RUNTIME_MAX_REDIRECTS 3
+#define RUNTIME_LATENCY_BUCKETS 96      // Four per octave of microseconds
+#define RUNTIME_MAX_HELD 64             // Events held back during a request; later ones are dropped
+
+class ClientRuntime;
+class LocalChannelClient;
+struct RuntimeLoop;
+
+// Why a session was resumed
+enum SessionEvent {
+    SESSION_START,   // First run on its loop
+    SESSION_REPLY,   // The tracker answered the pending request
+    SESSION_TIMEOUT, // The request went unanswered through every resend
+    SESSION_WAKE,    // A sleep ended
+    SESSION_PUSH,    // An unsolicited datagram, such as a MATCH announcement
+    SESSION_INPUT,   // Another thread handed the session work through ClientRuntime::notify()
+    SESSION_STOP     // The runtime is shutting down; sent once
+};
+
+// One player, written as a resumable flow. resume() runs until the flow has
+// to wait, starts the wait with exactly one of request(), sleep(),
+// waitForPush() or finish(), and returns. The session's loop calls resume() again with the
+// event that ended the wait. A flow keeps its place in members of its own,
+// so a waiting player costs its object and a socket rather than a thread
+// and a stack.
+class ClientSession {
+public:
+    ClientSession();
+    virtual ~ClientSession();
+
+    virtual void resume(SessionEvent event, const char* text) = 0;
+
+    bool finished() const { return done; }
+    uint32_t sessionToken() const { return token; }
+    const sockaddr_in& localAddress() const { return local; } // Where replies and pushes arrive
+
+protected:
+    // Sends a request, resending it until the tracker answers. Rate-limited
+    // replies are retried after a backoff and redirects are followed, so
+    // the flow sees only the final reply.
+    void request(CommandType cmd, const std::string& data);
+    // The same for a server other than the tracker, such as a game host;
+    // redirects are only followed for the tracker
+    void request(const sockaddr_in& to, CommandType cmd, const std::string& data);
+    void sleep(uint32_t ms);
+    void waitForPush(); // Until a push, an input or a stop
+    void finish();
+    // Sends once without waiting, for messages the server does not answer
+    void post(CommandType cmd, const std::string& data);
+    void post(const sockaddr_in& to, CommandType cmd, const std::string& data);
+
+    // Tracker commands. REGISTER keeps the issued session token, and the
+    // others refer to the player by it.
+    void registerPlayer(const std::string& name, const std::string& ip, int tPort, int pPort);
+    void startGame(int n, int holes, const std::string& variant = "");
+    void endGame(uint32_t gameId, const std::vector<int>& scores);
+    void deregisterPlayer();
+    std::string self() const { return "@" + std::to_string(token); }
+
+    uint32_t random(uint32_t bound); // Uniform in [0, bound), from the loop's generator
+    ClientRuntime& runtime();
+
+private:
+    friend class ClientRuntime;
+
+    void startRequest(CommandType cmd, const std::string& data);
+
+    RuntimeLoop* loop;
+    int sock;
+    LocalChannelClient* channel; // Shared-memory channel to the tracker, if attached
+    sockaddr_in tracker;
+    sockaddr_in local;
+    sockaddr_in pendingTo;    // Server of a request not meant for the tracker
+    std::string pendingData;  // Request being waited for, kept for resends
+    std::deque<std::pair<SessionEvent, std::string>> held; // Pushes and inputs that arrived during a request
+    CommandType pendingCmd;
+    uint64_t firstSentUs;
+    uint32_t generation;      // Invalidates timers of waits that already ended
+    uint32_t token;
+    uint8_t sends;
+    uint8_t retryLaters;
+    uint8_t redirects;
+    bool waitingReply;
+    bool pendingToTracker;
+    bool viaLocal;            // Tracker requests go over the channel until a redirect
+    bool sleeping;
+    bool suspended;           // Set by each way of waiting during resume()
+    bool stopped;
+    bool done;
+};
+
+// Counters across every loop, readable while the runtime runs
+struct RuntimeStats {
+    uint64_t requests;
+    uint64_t replies;
+    uint64_t resends;
+    uint64_t retryLaters;
+    uint64_t timeouts;
+    uint64_t pushes;
+    uint64_t latency[RUNTIME_LATENCY_BUCKETS]; // Request round trips, from first send to final reply
+};
+
+// Hosts many client sessions on a few event-loop threads. Each session has
+// its own UDP socket, so replies need no demultiplexing and the tracker
+// tells sessions apart by address. Each loop waits on its sessions'
+// sockets with epoll and keeps their deadlines in a timer heap; a session
+// runs only on its own loop, so sessions take no locks.
+class ClientRuntime {
+public:
+    ClientRuntime(const char* trackerIP, unsigned short trackerPort, int loops);
+    ~ClientRuntime();
+
+    // Before run() only. The session's socket is bound to an ephemeral port
+    // on sourceAddr, in network order, or on any address when it is 0.
+    bool add(ClientSession* session, uint32_t sourceAddr, std::string& error);
+    // Before run() only, after add(). Sends the session's tracker requests
+    // over the local channel of a tracker on this host, and reads the
+    // channel on a thread of its own. A redirect moves the session to UDP.
+    bool attachLocal(ClientSession* session, unsigned short trackerPort, std::string& error);
+    // Runs every session to completion on the loop threads
+    void run();
+    // Resumes every unfinished session with SESSION_STOP; any thread may call it
+    void stop();
+    // Resumes the session with SESSION_INPUT on its loop, once it is not
+    // waiting for a reply; any thread may call it
+    void notify(ClientSession* session);
+
+    size_t sessions() const { return total; }
+    size_t live() const { return active.load(); }
+    void stats(RuntimeStats& out) const;
+    static uint64_t percentileUs(const RuntimeStats& stats, double fraction);
+
+private:
+    friend class ClientSession;
+
+    sockaddr_in trackerAddr;
+    std::vector<RuntimeLoop*> loops;
+    size_t total;
+    std::atomic<size_t> active;
+    std::atomic<bool> stopping;
+    std::atomic<bool> loopsDone; // Ends the local channel readers
+    std::atomic<uint64_t> requests, replies, resends, retryLaters, timeouts, pushes;
+    std::atomic<uint64_t> latency[RUNTIME_LATENCY_BUCKETS];
+
+    void runLoop(RuntimeLoop& loop);
+    void readLocal(RuntimeLoop& loop, ClientSession& session);
+    void drainInbox(RuntimeLoop& loop);
+    void deliver(RuntimeLoop& loop, ClientSession& session, SessionEvent event, const char* text);
+    void offer(RuntimeLoop& loop, ClientSession& session, SessionEvent event, const char* text);
+    void receive(RuntimeLoop& loop, ClientSession& session, const char* text);
+    void expire(RuntimeLoop& loop, ClientSession& session);
+    void transmit(ClientSession& session);
+    void transmit(ClientSession& session, CommandType cmd, const std::string& data, const sockaddr_in* to);
+    void arm(RuntimeLoop& loop, ClientSession& session, uint64_t atUs);
+};
+
+uint64_t runtimeClockUs();
+
+#endif // CLIENT_RUNTIME_H
\ No newline at end of file
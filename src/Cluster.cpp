@@ -0,0 +1,108 @@
+#include "Cluster.h"
+#include <algorithm>
+#include <sstream>
+#include <cstring>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+uint64_t ClusterRing::hash(const std::string& key) {
+    // FNV-1a followed by a 64-bit finalizer to spread nearby keys
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (unsigned char c : key) {
+        h ^= c;
+        h *= 0x100000001b3ull;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+int ClusterRing::addNode(const ClusterNode& node) {
+    int index = static_cast<int>(nodes.size());
+    nodes.push_back(node);
+    std::string base = node.ip + ":" + std::to_string(node.port) + "#";
+    for (int v = 0; v < CLUSTER_VIRTUAL_NODES; ++v) {
+        points.push_back(std::make_pair(hash(base + std::to_string(v)), index));
+    }
+    std::sort(points.begin(), points.end());
+    return index;
+}
+
+int ClusterRing::ownerOf(const std::string& name) const {
+    if (points.empty()) {
+        return -1;
+    }
+    auto it = std::lower_bound(points.begin(), points.end(), std::make_pair(hash(name), 0));
+    if (it == points.end()) {
+        it = points.begin();
+    }
+    return it->second;
+}
+
+ClusterLink::ClusterLink(const ClusterNode& self) {
+    if ((sock = socket(PF_INET, SOCK_DGRAM | SOCK_NONBLOCK, IPPROTO_UDP)) < 0)
+        DieWithError("cluster: socket() failed");
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(self.port + CLUSTER_LINK_PORT_OFFSET);
+    if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+        DieWithError("cluster: bind() failed");
+}
+
+ClusterLink::~ClusterLink() {
+    close(sock);
+}
+
+bool ClusterLink::send(const ClusterNode& node, CommandType cmd, const std::string& data) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr(node.ip.c_str());
+    addr.sin_port = htons(node.port);
+
+    Message msg;
+    msg.cmd = cmd;
+    strncpy(msg.data, data.c_str(), sizeof(msg.data) - 1);
+    msg.data[sizeof(msg.data) - 1] = '\0';
+
+    return sendto(sock, &msg, sizeof(msg), 0, (struct sockaddr *) &addr, sizeof(addr)) == sizeof(msg);
+}
+
+bool ClusterLink::receive(std::string& reply, sockaddr_in& from) {
+    char buffer[ECHOMAX * 8];
+    socklen_t fromLen = sizeof(from);
+    ssize_t n = recvfrom(sock, buffer, sizeof(buffer) - 1, 0, (struct sockaddr *) &from, &fromLen);
+    if (n < 0) {
+        return false;
+    }
+    buffer[n] = '\0';
+    reply = buffer;
+    return true;
+}
+
+// Parses "ip:port,ip:port,..."
+bool parseClusterNodes(const std::string& spec, std::vector<ClusterNode>& nodes) {
+    std::istringstream iss(spec);
+    std::string item;
+    while (std::getline(iss, item, ',')) {
+        size_t colon = item.rfind(':');
+        if (colon == std::string::npos) {
+            return false;
+        }
+        ClusterNode node;
+        node.ip = item.substr(0, colon);
+        node.port = atoi(item.c_str() + colon + 1);
+        if (node.port <= 0) {
+            return false;
+        }
+        nodes.push_back(node);
+    }
+    return !nodes.empty();
+}
\ No newline at end of file
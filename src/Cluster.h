@@ -0,0 +1,58 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include "Utils.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+
+#define CLUSTER_VIRTUAL_NODES 128
+#define CLUSTER_RPC_TIMEOUT_MS 200
+#define CLUSTER_LINK_PORT_OFFSET 1000 // Nodes call each other from their own port plus this
+
+struct ClusterNode {
+    std::string ip;
+    int port;
+};
+
+// Consistent-hash ring over the cluster's tracker nodes. Each node is placed
+// at CLUSTER_VIRTUAL_NODES points on a 64-bit ring and a player name belongs
+// to the first point clockwise of its hash, so adding an Nth node moves only
+// about 1/N of the names.
+class ClusterRing {
+public:
+    int addNode(const ClusterNode& node);
+    int ownerOf(const std::string& name) const;
+    const ClusterNode& node(int index) const { return nodes[index]; }
+    int size() const { return static_cast<int>(nodes.size()); }
+
+    static uint64_t hash(const std::string& key);
+
+private:
+    std::vector<ClusterNode> nodes;
+    std::vector<std::pair<uint64_t, int>> points; // Sorted ring positions
+};
+
+// Non-blocking channel to the other tracker nodes, used for the cross-node
+// reservation protocol. It sends from the node's port plus
+// CLUSTER_LINK_PORT_OFFSET, which is how the other nodes tell cluster
+// traffic from clients. Replies are read by the caller's event loop when
+// fd() is readable; the caller keeps its own deadlines.
+class ClusterLink {
+public:
+    explicit ClusterLink(const ClusterNode& self);
+    ~ClusterLink();
+
+    int fd() const { return sock; }
+    bool send(const ClusterNode& node, CommandType cmd, const std::string& data);
+    // Takes the next queued reply; false when there is none
+    bool receive(std::string& reply, sockaddr_in& from);
+
+private:
+    int sock;
+};
+
+bool parseClusterNodes(const std::string& spec, std::vector<ClusterNode>& nodes);
+
+#endif // CLUSTER_H
\ No newline at end of file
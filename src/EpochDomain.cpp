@@ -0,0 +1,68 @@
+#include "EpochDomain.h"
+#include <functional>
+#include <thread>
+
+EpochDomain::EpochDomain() : globalEpoch(1) {
+    for (auto& slot : slots) {
+        slot.epoch.store(0);
+    }
+}
+
+EpochDomain::~EpochDomain() {
+    for (const auto& item : retired) {
+        item.destroy(item.object);
+    }
+}
+
+// Claims a free slot by storing the epoch into it. Threads start probing at
+// a slot derived from their ID so concurrent readers rarely share a line.
+size_t EpochDomain::pin() {
+    size_t start = std::hash<std::thread::id>()(std::this_thread::get_id()) % EPOCH_READER_SLOTS;
+    for (;;) {
+        for (size_t i = 0; i < EPOCH_READER_SLOTS; ++i) {
+            size_t index = (start + i) % EPOCH_READER_SLOTS;
+            uint64_t expected = 0;
+            uint64_t epoch = globalEpoch.load();
+            if (slots[index].epoch.load(std::memory_order_relaxed) == 0 &&
+                slots[index].epoch.compare_exchange_strong(expected, epoch)) {
+                return index;
+            }
+        }
+        std::this_thread::yield(); // More concurrent readers than slots
+    }
+}
+
+EpochDomain::Guard::Guard(EpochDomain& domain) : domain(domain), slot(domain.pin()) {}
+
+EpochDomain::Guard::~Guard() {
+    domain.slots[slot].epoch.store(0, std::memory_order_release);
+}
+
+// The object must already be unreachable from the published pointer. Bumping
+// the epoch afterwards means any reader pinned at the new epoch or later
+// loaded the pointer after the swap and cannot see the object.
+void EpochDomain::retireRaw(const void* object, void (*destroy)(const void*)) {
+    uint64_t epoch = globalEpoch.fetch_add(1) + 1;
+    retired.push_back(Retired{epoch, object, destroy});
+    collect();
+}
+
+void EpochDomain::collect() {
+    uint64_t oldest = globalEpoch.load();
+    for (const auto& slot : slots) {
+        uint64_t epoch = slot.epoch.load();
+        if (epoch != 0 && epoch < oldest) {
+            oldest = epoch;
+        }
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < retired.size(); ++i) {
+        if (retired[i].epoch <= oldest) {
+            retired[i].destroy(retired[i].object);
+        } else {
+            retired[kept++] = retired[i];
+        }
+    }
+    retired.resize(kept);
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#ifndef EPOCH_DOMAIN_H
+#define EPOCH_DOMAIN_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define EPOCH_READER_SLOTS 64
+
+// Epoch-based reclamation for read-mostly data published through an atomic
+// pointer. A reader pins the current epoch in a slot for the duration of
+// its read; a writer swaps the pointer, retires the old object, and the
+// object is freed once every pinned reader has moved past the epoch in which
+// it was retired. Readers never block and never take a lock. Writers must be
+// serialised by the caller.
+class EpochDomain {
+public:
+    EpochDomain();
+    ~EpochDomain();
+
+    // Pins the current epoch for the lifetime of the guard
+    class Guard {
+    public:
+        explicit Guard(EpochDomain& domain);
+        ~Guard();
+    private:
+        EpochDomain& domain;
+        size_t slot;
+        Guard(const Guard&);
+        Guard& operator=(const Guard&);
+    };
+
+    template <typename T>
+    void retire(const T* object) {
+        retireRaw(object, [](const void* p) { delete static_cast<const T*>(p); });
+    }
+
+    size_t pending() const { return retired.size(); }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch; // Pinned epoch, 0 while free
+    };
+    struct Retired {
+        uint64_t epoch;
+        const void* object;
+        void (*destroy)(const void*);
+    };
+
+    std::atomic<uint64_t> globalEpoch;
+    Slot slots[EPOCH_READER_SLOTS];
+    std::vector<Retired> retired;
+
+    size_t pin();
+    void retireRaw(const void* object, void (*destroy)(const void*));
+    void collect();
+
+    EpochDomain(const EpochDomain&);
+    EpochDomain& operator=(const EpochDomain&);
+};
+
+#endif // EPOCH_DOMAIN_H
\ No newline at end of file
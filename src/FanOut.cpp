@@ -0,0 +1,57 @@
+#include "FanOut.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+FanOut::FanOut(int sock)
+    : sock(sock), addrs(FANOUT_BATCH), headers(FANOUT_BATCH), sentCount(0), droppedCount(0), callCount(0) {
+    memset(headers.data(), 0, headers.size() * sizeof(headers[0]));
+    for (size_t i = 0; i < addrs.size(); ++i) {
+        memset(&addrs[i], 0, sizeof(addrs[i]));
+        addrs[i].sin_family = AF_INET;
+        headers[i].msg_hdr.msg_name = &addrs[i];
+        headers[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+        headers[i].msg_hdr.msg_iov = &iov;
+        headers[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+size_t FanOut::send(const void* data, size_t len, const Endpoint* to, size_t count) {
+    iov.iov_base = const_cast<void*>(data);
+    iov.iov_len = len;
+    size_t delivered = 0;
+    size_t next = 0;
+    while (next < count) {
+        size_t batch = std::min<size_t>(count - next, FANOUT_BATCH);
+        for (size_t i = 0; i < batch; ++i) {
+            addrs[i].sin_addr.s_addr = to[next + i].addr;
+            addrs[i].sin_port = to[next + i].port;
+        }
+
+        // A recipient the kernel rejects ends the call early; skip it and
+        // go on with the rest of the batch
+        size_t done = 0;
+        while (done < batch) {
+            callCount++;
+            int n = sendmmsg(sock, &headers[done], batch - done, MSG_DONTWAIT);
+            if (n > 0) {
+                done += n;
+                delivered += n;
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS || errno == ENOMEM)) {
+                droppedCount += count - next - done;
+                sentCount += delivered;
+                return delivered;
+            }
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            droppedCount++;
+            done++;
+        }
+        next += batch;
+    }
+    sentCount += delivered;
+    return delivered;
+}
\ No newline at end of file
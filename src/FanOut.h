@@ -0,0 +1,37 @@
+#ifndef FAN_OUT_H
+#define FAN_OUT_H
+
+#include "SessionTable.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define FANOUT_BATCH 1024 // Datagrams per sendmmsg() call, the kernel's UIO_MAXIOV
+
+// Sends one payload to many endpoints over a UDP socket. Every datagram of
+// a batch points at the same buffer, so a recipient costs only its address
+// and header, and a whole batch costs one sendmmsg() call. Spectator
+// streams can resynchronize, so datagrams the socket pushes back on are
+// dropped and counted rather than queued.
+class FanOut {
+public:
+    explicit FanOut(int sock);
+
+    // Returns the number of recipients the datagram was handed to
+    size_t send(const void* data, size_t len, const Endpoint* to, size_t count);
+
+    uint64_t sent() const { return sentCount; }
+    uint64_t dropped() const { return droppedCount; }
+    uint64_t calls() const { return callCount; }
+
+private:
+    int sock;
+    std::vector<sockaddr_in> addrs;
+    std::vector<struct mmsghdr> headers;
+    struct iovec iov;
+    uint64_t sentCount, droppedCount, callCount;
+};
+
+#endif // FAN_OUT_H
\ No newline at end of file
@@ -0,0 +1,678 @@
+#include "GameHost.h"
+#include "Trace.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+uint64_t hostClockUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template <class Engine>
+class HostedTableOf : public HostedTable {
+public:
+    HostedTableOf(int players, int holes, uint32_t seed) : engine(players, holes, seed) {}
+
+    int players() const { return engine.getNumPlayers(); }
+    int turn() const { return engine.getCurrentPlayerTurn(); }
+    bool finished() const { return engine.isGameFinished(); }
+
+    // Either replace a card with the one drawn, or, for a card drawn from
+    // the deck, discard it and turn over a face-down card instead
+    const char* move(int seat, bool fromDeck, int replaceSlot, int flipSlot) {
+        TRACE_SCOPE("turn");
+        if (engine.isGameFinished()) {
+            return "Game is over";
+        }
+        if (seat != engine.getCurrentPlayerTurn()) {
+            return "Not your turn";
+        }
+        if (replaceSlot >= Engine::handSize || flipSlot >= Engine::handSize || (replaceSlot < 0) == (flipSlot < 0)) {
+            return "Invalid card slot";
+        }
+        if (!fromDeck && replaceSlot < 0) {
+            return "A card taken from the discard pile must replace one";
+        }
+        if (flipSlot >= 0 && engine.getHand(seat)[flipSlot].faceUp) {
+            return "Card is already face up";
+        }
+        try {
+            Card card = engine.drawCard(fromDeck);
+            if (replaceSlot >= 0) {
+                engine.replaceCard(seat, replaceSlot, card);
+            } else {
+                engine.discardCard(card);
+                engine.flipCard(seat, flipSlot);
+            }
+        } catch (const std::exception&) {
+            return "No cards left to draw";
+        }
+        engine.nextTurn();
+        return nullptr;
+    }
+
+    // "<hole> <turn> <discard> | <name> <card>... | ..."
+    void render(const std::string* names, std::string& out) const {
+        out += std::to_string(engine.getCurrentHole());
+        out += ' ';
+        out += names[engine.getCurrentPlayerTurn()];
+        out += ' ';
+        out += engine.topDiscard().toString();
+        for (int p = 0; p < engine.getNumPlayers(); ++p) {
+            out += " | ";
+            out += names[p];
+            for (const Card& card : engine.getHand(p)) {
+                out += ' ';
+                out += card.toString();
+            }
+        }
+    }
+
+    void renderScores(const std::string* names, std::string& out) const {
+        typename Engine::Scores scores = engine.getFinalScores();
+        for (int p = 0; p < engine.getNumPlayers(); ++p) {
+            out += ' ';
+            out += names[p];
+            out += ' ';
+            out += std::to_string(scores[p]);
+        }
+    }
+
+    void view(TableView& out) const {
+        out.hole = engine.getCurrentHole();
+        out.turn = engine.getCurrentPlayerTurn();
+        out.players = engine.getNumPlayers();
+        out.handSize = Engine::handSize;
+        out.discard = engine.topDiscard();
+        for (int p = 0; p < out.players; ++p) {
+            const typename Engine::Hand& hand = engine.getHand(p);
+            for (int i = 0; i < Engine::handSize; ++i) {
+                out.cards[p][i] = hand[i];
+            }
+        }
+    }
+
+private:
+    Engine engine;
+};
+
+// Whether a spectator would see any difference between the two cards
+static bool sameFace(const Card& a, const Card& b) {
+    return a.faceUp == b.faceUp && (!a.faceUp || (a.rank == b.rank && a.suit == b.suit));
+}
+
+// SipHash-2-4 of two 64-bit words, so a cookie cannot be forged without the
+// host's key
+static uint64_t sipHash(const uint64_t key[2], uint64_t m0, uint64_t m1) {
+    uint64_t v0 = key[0] ^ 0x736f6d6570736575ULL, v1 = key[1] ^ 0x646f72616e646f6dULL;
+    uint64_t v2 = key[0] ^ 0x6c7967656e657261ULL, v3 = key[1] ^ 0x7465646279746573ULL;
+    auto rotl = [](uint64_t x, int b) { return (x << b) | (x >> (64 - b)); };
+    auto round = [&]() {
+        v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);
+        v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;
+        v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;
+        v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);
+    };
+    const uint64_t words[3] = {m0, m1, 16ULL << 56}; // The last word carries the length
+    for (uint64_t m : words) {
+        v3 ^= m;
+        round();
+        round();
+        v0 ^= m;
+    }
+    v2 ^= 0xff;
+    for (int i = 0; i < 4; ++i) {
+        round();
+    }
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+namespace {
+struct TableFactory {
+    int players;
+    int holes;
+    uint32_t seed;
+    HostedTable* table;
+
+    template <class Engine>
+    void run() {
+        table = new HostedTableOf<Engine>(players, holes, seed);
+    }
+};
+}
+
+HostedTable* createHostedTable(int variant, int players, int holes, uint32_t seed) {
+    TableFactory factory = {players, holes, seed, nullptr};
+    visitGolfVariant(variant, factory);
+    return factory.table;
+}
+
+GameHost::GameHost(int numShards, int tickMs, const Endpoint& tracker)
+    : tickMs(tickMs), tracker(tracker), eventFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), stopping(false), openTables(0),
+      playedMoves(0), maxLatencyUs(0) {
+    if (eventFd < 0) {
+        DieWithError("host: eventfd() failed");
+    }
+    std::random_device random;
+    for (uint64_t& word : cookieKey) {
+        word = (static_cast<uint64_t>(random()) << 32) | random();
+    }
+    for (int i = 0; i < numShards; ++i) {
+        shards.emplace_back(new Shard());
+        shards.back()->seed = static_cast<uint32_t>(hostClockUs()) + i * 7919u;
+    }
+    for (auto& shard : shards) {
+        Shard* s = shard.get();
+        s->worker = std::thread([this, s]() { run(*s); });
+    }
+}
+
+GameHost::~GameHost() {
+    stopping = true;
+    for (auto& shard : shards) {
+        shard->worker.join();
+    }
+    close(eventFd);
+}
+
+// Routes a request by the table ID that leads its arguments
+void GameHost::submit(CommandType cmd, const std::string& data, const Endpoint& from, uint64_t receivedUs) {
+    char* end = nullptr;
+    unsigned long table = strtoul(data.c_str(), &end, 10);
+    const char* error = nullptr;
+    if (end == data.c_str()) {
+        error = " Missing table ID";
+    } else if (cmd == CMD_TABLE_OPEN && (from.addr != tracker.addr || from.port != tracker.port)) {
+        error = " Only the tracker opens tables";
+    }
+    if (error != nullptr) {
+        std::lock_guard<std::mutex> lock(outboxMutex);
+        outbox.push_back({from, std::string("FAILURE ") + cmdToString(cmd) + error});
+        uint64_t one = 1;
+        (void) !write(eventFd, &one, sizeof(one));
+        return;
+    }
+    Shard& shard = *shards[table % shards.size()];
+    std::lock_guard<std::mutex> lock(shard.inboxMutex);
+    shard.inbox.push_back({cmd, static_cast<uint32_t>(table), from, std::string(end), receivedUs});
+}
+
+void GameHost::drain(std::vector<HostOutput>& out, std::vector<HostBroadcast>& broadcasts) {
+    uint64_t count;
+    (void) !read(eventFd, &count, sizeof(count));
+    std::lock_guard<std::mutex> lock(outboxMutex);
+    if (out.empty()) {
+        out.swap(outbox);
+    } else {
+        out.insert(out.end(), outbox.begin(), outbox.end());
+        outbox.clear();
+    }
+    if (broadcasts.empty()) {
+        broadcasts.swap(broadcastOutbox);
+    } else {
+        broadcasts.insert(broadcasts.end(), broadcastOutbox.begin(), broadcastOutbox.end());
+        broadcastOutbox.clear();
+    }
+}
+
+void GameHost::run(Shard& shard) {
+    std::vector<HostRequest> batch;
+    std::vector<HostOutput> out;
+    std::vector<HostBroadcast> broadcasts;
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point next = Clock::now();
+    uint64_t lastSweepMs = 0;
+
+    while (!stopping) {
+        // Fixed ticks; a tick that overran starts the next one at once
+        next += std::chrono::milliseconds(tickMs);
+        Clock::time_point now = Clock::now();
+        if (next > now) {
+            std::this_thread::sleep_until(next);
+        } else {
+            next = now;
+        }
+
+        TRACE_SAMPLE();
+        TRACE_SCOPE("tick");
+        {
+            std::lock_guard<std::mutex> lock(shard.inboxMutex);
+            batch.swap(shard.inbox);
+        }
+        uint64_t nowMs = hostClockUs() / 1000;
+        uint64_t oldestUs = UINT64_MAX;
+        for (HostRequest& request : batch) {
+            oldestUs = std::min(oldestUs, request.receivedUs);
+            handle(shard, request, out, nowMs);
+        }
+        batch.clear();
+
+        // Each changed table is rendered once for all of its seats
+        for (uint32_t id : shard.changed) {
+            auto it = shard.tables.find(id);
+            if (it != shard.tables.end()) {
+                it->second.dirty = false;
+                publish(id, it->second, out);
+                if (it->second.spectators) {
+                    spectate(id, it->second, broadcasts);
+                }
+                if (it->second.game->finished()) {
+                    shard.tables.erase(it);
+                    openTables--;
+                }
+            }
+        }
+        shard.changed.clear();
+
+        if (nowMs - lastSweepMs >= 1000) {
+            lastSweepMs = nowMs;
+            for (auto it = shard.tables.begin(); it != shard.tables.end();) {
+                if (nowMs - it->second.lastMoveMs >= GAMEHOST_IDLE_MS) {
+                    it = shard.tables.erase(it);
+                    openTables--;
+                } else {
+                    expireWatchers(it->second, nowMs);
+                    ++it;
+                }
+            }
+        }
+
+        if (!out.empty() || !broadcasts.empty()) {
+            {
+                std::lock_guard<std::mutex> lock(outboxMutex);
+                if (outbox.empty()) {
+                    outbox.swap(out);
+                } else {
+                    outbox.insert(outbox.end(), out.begin(), out.end());
+                }
+                if (broadcastOutbox.empty()) {
+                    broadcastOutbox.swap(broadcasts);
+                } else {
+                    broadcastOutbox.insert(broadcastOutbox.end(), broadcasts.begin(), broadcasts.end());
+                }
+            }
+            out.clear();
+            broadcasts.clear();
+            uint64_t one = 1;
+            (void) !write(eventFd, &one, sizeof(one));
+
+            uint64_t latency = hostClockUs() - oldestUs;
+            uint64_t seen = maxLatencyUs.load();
+            while (oldestUs != UINT64_MAX && latency > seen && !maxLatencyUs.compare_exchange_weak(seen, latency)) {
+            }
+        }
+    }
+}
+
+void GameHost::handle(Shard& shard, HostRequest& request, std::vector<HostOutput>& out, uint64_t nowMs) {
+    switch (request.cmd) {
+        case CMD_TABLE_OPEN:
+            open(shard, request, out, nowMs);
+            break;
+        case CMD_TABLE_JOIN:
+            join(shard, request, out);
+            break;
+        case CMD_TABLE_MOVE:
+            play(shard, request, out, nowMs);
+            break;
+        case CMD_TABLE_WATCH:
+            watch(shard, request, out, nowMs);
+            break;
+        case CMD_TABLE_UNWATCH:
+            unwatch(shard, request, out, nowMs);
+            break;
+        default:
+            out.push_back({request.from, "FAILURE Unknown command"});
+    }
+}
+
+// "<table> <variant> <holes> <name> <secret>...", seats in order, dealer
+// first. Failures name the table too, since the tracker may have several
+// opens outstanding.
+void GameHost::open(Shard& shard, HostRequest& request, std::vector<HostOutput>& out, uint64_t nowMs) {
+    std::istringstream iss(request.args);
+    std::string variantName, name, secret;
+    std::vector<std::string> names, secrets;
+    int holes = 0;
+    iss >> variantName >> holes;
+    while (iss >> name >> secret) {
+        names.push_back(name);
+        secrets.push_back(secret);
+    }
+    int players = static_cast<int>(names.size());
+
+    int variant = findGolfVariant(variantName);
+    const char* error = nullptr;
+    if (variant < 0) {
+        error = "Unknown game variant";
+    } else if (holes < 1 || holes > GOLF_MAX_HOLES) {
+        error = "Invalid number of holes";
+    } else if (players < 1 || players > MAX_PLAYERS) {
+        error = "Invalid number of players";
+    } else if (shard.tables.count(request.table)) {
+        // A resent open of the same table succeeds again; any other open of
+        // that ID is refused
+        const Table& existing = shard.tables[request.table];
+        bool same = existing.variant == variant && existing.holes == holes && existing.game->players() == players;
+        for (int p = 0; same && p < players; ++p) {
+            same = existing.names[p] == names[p] && existing.secrets[p] == secrets[p];
+        }
+        if (same) {
+            out.push_back({request.from, "SUCCESS TABLE_OPEN " + std::to_string(request.table)});
+            return;
+        }
+        error = "Table already open";
+    } else if (openTables.load() >= GAMEHOST_MAX_TABLES) {
+        error = "Too many tables";
+    }
+    if (error != nullptr) {
+        out.push_back({request.from, "FAILURE TABLE_OPEN " + std::to_string(request.table) + " " + error});
+        return;
+    }
+
+    Table table;
+    table.game.reset(createHostedTable(variant, players, holes, shard.seed++));
+    table.variant = variant;
+    table.holes = holes;
+    for (int p = 0; p < MAX_PLAYERS; ++p) {
+        table.names[p] = p < players ? names[p] : "";
+        table.secrets[p] = p < players ? secrets[p] : "";
+        table.joined[p] = false;
+    }
+    table.dirty = false;
+    table.lastMoveMs = nowMs;
+    shard.tables.insert(std::make_pair(request.table, std::move(table)));
+    openTables++;
+    out.push_back({request.from, "SUCCESS TABLE_OPEN " + std::to_string(request.table)});
+}
+
+// "<table> <name> <secret>": binds the sender to that seat and sends it the
+// table. A seat stays with the endpoint that joined it first; joining again
+// from there is a harmless resend.
+void GameHost::join(Shard& shard, HostRequest& request, std::vector<HostOutput>& out) {
+    auto it = shard.tables.find(request.table);
+    if (it == shard.tables.end()) {
+        out.push_back({request.from, "FAILURE TABLE_JOIN Table not found"});
+        return;
+    }
+    std::istringstream iss(request.args);
+    std::string name, secret;
+    iss >> name >> secret;
+    Table& table = it->second;
+    for (int p = 0; p < table.game->players(); ++p) {
+        if (table.names[p] == name) {
+            if (secret.empty() || secret != table.secrets[p]) {
+                break;
+            }
+            if (table.joined[p] && (table.seats[p].addr != request.from.addr || table.seats[p].port != request.from.port)) {
+                out.push_back({request.from, "FAILURE TABLE_JOIN Seat already taken"});
+                return;
+            }
+            table.seats[p] = request.from;
+            table.joined[p] = true;
+            markChanged(shard, request.table, table);
+            out.push_back({request.from, "SUCCESS TABLE_JOIN " + std::to_string(request.table) + " " + std::to_string(p)});
+            return;
+        }
+    }
+    out.push_back({request.from, "FAILURE TABLE_JOIN No such seat, or wrong secret"});
+}
+
+// "<table> <secret> deck|discard replace|flip <slot>", from the endpoint
+// that joined the seat. The new state is pushed to every seat; the mover
+// is also answered, so a lost move can be resent.
+void GameHost::play(Shard& shard, HostRequest& request, std::vector<HostOutput>& out, uint64_t nowMs) {
+    auto it = shard.tables.find(request.table);
+    if (it == shard.tables.end()) {
+        out.push_back({request.from, "FAILURE TABLE_MOVE Table not found"});
+        return;
+    }
+    std::istringstream iss(request.args);
+    std::string secret, source, action;
+    int slot = -1;
+    iss >> secret >> source >> action >> slot;
+    Table& table = it->second;
+    int seat = -1;
+    for (int p = 0; p < table.game->players(); ++p) {
+        if (table.joined[p] && table.secrets[p] == secret && table.seats[p].addr == request.from.addr &&
+            table.seats[p].port == request.from.port) {
+            seat = p;
+            break;
+        }
+    }
+    if (seat < 0) {
+        out.push_back({request.from, "FAILURE TABLE_MOVE Not seated at this table"});
+        return;
+    }
+
+    if ((source != "deck" && source != "discard") || (action != "replace" && action != "flip")) {
+        out.push_back({request.from, "FAILURE TABLE_MOVE Expected deck|discard replace|flip <slot>"});
+        return;
+    }
+    const char* error = table.game->move(seat, source == "deck", action == "replace" ? slot : -1,
+                                         action == "flip" ? slot : -1);
+    if (error != nullptr) {
+        out.push_back({request.from, std::string("FAILURE TABLE_MOVE ") + error});
+        return;
+    }
+    markChanged(shard, request.table, table);
+    table.lastMoveMs = nowMs;
+    playedMoves++;
+    out.push_back({request.from, "SUCCESS TABLE_MOVE " + std::to_string(request.table)});
+}
+
+void GameHost::markChanged(Shard& shard, uint32_t id, Table& table) {
+    if (!table.dirty) {
+        table.dirty = true;
+        shard.changed.push_back(id);
+    }
+}
+
+// Pushes "TABLE <id> ..." to every joined seat, and "RESULT <id> <name>
+// <score>..." once the last hole is scored
+void GameHost::publish(uint32_t id, Table& table, std::vector<HostOutput>& out) {
+    std::string text;
+    if (table.game->finished()) {
+        text = "RESULT " + std::to_string(id);
+        table.game->renderScores(table.names, text);
+    } else {
+        text = "TABLE " + std::to_string(id) + " ";
+        table.game->render(table.names, text);
+    }
+    for (int p = 0; p < table.game->players(); ++p) {
+        if (table.joined[p]) {
+            out.push_back({table.seats[p], text});
+        }
+    }
+}
+
+static std::shared_ptr<const std::string> keyframe(uint32_t id, uint32_t seq, const HostedTable& game,
+                                                   const std::string* names) {
+    std::shared_ptr<std::string> text = std::make_shared<std::string>("KEY " + std::to_string(id) + " " +
+                                                                      std::to_string(seq) + " ");
+    game.render(names, *text);
+    return text;
+}
+
+// Keyed to the sender's address, so only a sender that receives at that
+// address can echo it back
+uint64_t GameHost::cookie(const Endpoint& from, uint32_t table, uint64_t epoch) const {
+    return sipHash(cookieKey, (static_cast<uint64_t>(from.addr) << 16) | from.port,
+                   (epoch << 32) | table);
+}
+
+bool GameHost::validCookie(const HostRequest& request, const std::string& given, uint64_t nowMs) const {
+    char* end = nullptr;
+    uint64_t value = strtoull(given.c_str(), &end, 16);
+    if (given.empty() || *end != '\0') {
+        return false;
+    }
+    uint64_t epoch = nowMs / GAMEHOST_COOKIE_MS;
+    return value == cookie(request.from, request.table, epoch) ||
+           (epoch > 0 && value == cookie(request.from, request.table, epoch - 1));
+}
+
+// "<table> [<cookie>]". Without a valid cookie the sender is only told one,
+// "SUCCESS TABLE_WATCH <table> COOKIE <cookie>", in one short reply, so a
+// spoofed source can neither be subscribed nor flooded. With
+// it, the sender is subscribed, or its lease renewed, and sent a fresh
+// keyframe. Watching again is also how a spectator that missed a datagram
+// catches up.
+void GameHost::watch(Shard& shard, HostRequest& request, std::vector<HostOutput>& out, uint64_t nowMs) {
+    auto it = shard.tables.find(request.table);
+    if (it == shard.tables.end()) {
+        out.push_back({request.from, "FAILURE TABLE_WATCH Table not found"});
+        return;
+    }
+    std::istringstream iss(request.args);
+    std::string given;
+    iss >> given;
+    if (!validCookie(request, given, nowMs)) {
+        char text[64];
+        snprintf(text, sizeof(text), "SUCCESS TABLE_WATCH %u COOKIE %016llx", request.table,
+                 static_cast<unsigned long long>(cookie(request.from, request.table, nowMs / GAMEHOST_COOKIE_MS)));
+        out.push_back({request.from, text});
+        return;
+    }
+
+    Table& table = it->second;
+    if (!table.spectators) {
+        table.spectators.reset(new Spectators());
+        Spectators& audience = *table.spectators;
+        audience.watchers = std::make_shared<std::vector<Endpoint>>();
+        audience.seq = 0;
+        audience.sinceKeyframe = 0;
+        table.game->view(audience.last);
+    }
+    Spectators& audience = *table.spectators;
+
+    size_t index = 0;
+    while (index < audience.watchers->size() && ((*audience.watchers)[index].addr != request.from.addr ||
+                                                 (*audience.watchers)[index].port != request.from.port)) {
+        index++;
+    }
+    if (index == audience.watchers->size()) {
+        if (audience.watchers->size() >= GAMEHOST_MAX_SPECTATORS) {
+            out.push_back({request.from, "FAILURE TABLE_WATCH Too many spectators"});
+            return;
+        }
+        // Copy on write while the network thread still holds a snapshot
+        if (audience.watchers.use_count() > 1) {
+            audience.watchers = std::make_shared<std::vector<Endpoint>>(*audience.watchers);
+        }
+        audience.watchers->push_back(request.from);
+        audience.leaseEndMs.push_back(0);
+    }
+    audience.leaseEndMs[index] = nowMs + GAMEHOST_WATCH_LEASE_MS;
+
+    out.push_back({request.from, "SUCCESS TABLE_WATCH " + std::to_string(request.table) + " " +
+                                     std::to_string(audience.seq)});
+    out.push_back({request.from, *keyframe(request.table, audience.seq, *table.game, table.names)});
+}
+
+// "<table> <cookie>"
+void GameHost::unwatch(Shard& shard, HostRequest& request, std::vector<HostOutput>& out, uint64_t nowMs) {
+    std::istringstream iss(request.args);
+    std::string given;
+    iss >> given;
+    if (!validCookie(request, given, nowMs)) {
+        out.push_back({request.from, "FAILURE TABLE_UNWATCH Invalid cookie"});
+        return;
+    }
+    auto it = shard.tables.find(request.table);
+    if (it != shard.tables.end() && it->second.spectators) {
+        Spectators& audience = *it->second.spectators;
+        for (size_t i = 0; i < audience.watchers->size(); ++i) {
+            const Endpoint& e = (*audience.watchers)[i];
+            if (e.addr == request.from.addr && e.port == request.from.port) {
+                dropWatcher(audience, i);
+                break;
+            }
+        }
+        if (audience.watchers->empty()) {
+            it->second.spectators.reset();
+        }
+    }
+    out.push_back({request.from, "SUCCESS TABLE_UNWATCH " + std::to_string(request.table)});
+}
+
+void GameHost::dropWatcher(Spectators& audience, size_t index) {
+    if (audience.watchers.use_count() > 1) {
+        audience.watchers = std::make_shared<std::vector<Endpoint>>(*audience.watchers);
+    }
+    std::vector<Endpoint>& watchers = *audience.watchers;
+    watchers[index] = watchers.back();
+    watchers.pop_back();
+    audience.leaseEndMs[index] = audience.leaseEndMs.back();
+    audience.leaseEndMs.pop_back();
+}
+
+// Drops the spectators whose lease ran out, and the table's audience with
+// the last of them
+void GameHost::expireWatchers(Table& table, uint64_t nowMs) {
+    if (!table.spectators) {
+        return;
+    }
+    Spectators& audience = *table.spectators;
+    for (size_t i = audience.leaseEndMs.size(); i-- > 0;) {
+        if (audience.leaseEndMs[i] <= nowMs) {
+            dropWatcher(audience, i);
+        }
+    }
+    if (audience.watchers->empty()) {
+        table.spectators.reset();
+    }
+}
+
+// Encodes a table's change once for all of its spectators: "DELTA <id>
+// <seq> <hole> <turn> <discard> <seat>.<slot>=<card>...", listing only cards
+// that look different, or a fresh "KEY <id> <seq> ..." when a new hole is
+// dealt or enough deltas have piled up. A finished game sends its RESULT.
+void GameHost::spectate(uint32_t id, Table& table, std::vector<HostBroadcast>& broadcasts) {
+    Spectators& audience = *table.spectators;
+    std::shared_ptr<const std::string> text;
+    if (table.game->finished()) {
+        std::shared_ptr<std::string> result = std::make_shared<std::string>("RESULT " + std::to_string(id));
+        table.game->renderScores(table.names, *result);
+        text = result;
+    } else {
+        TableView now;
+        table.game->view(now);
+        uint32_t seq = ++audience.seq;
+        if (now.hole != audience.last.hole || audience.sinceKeyframe >= GAMEHOST_KEYFRAME_INTERVAL) {
+            text = keyframe(id, seq, *table.game, table.names);
+            audience.sinceKeyframe = 0;
+        } else {
+            audience.sinceKeyframe++;
+            std::shared_ptr<std::string> delta = std::make_shared<std::string>("DELTA " + std::to_string(id) + " " +
+                                                                              std::to_string(seq) + " ");
+            *delta += std::to_string(now.hole);
+            *delta += ' ';
+            *delta += table.names[now.turn];
+            *delta += ' ';
+            *delta += now.discard.toString();
+            for (int p = 0; p < now.players; ++p) {
+                for (int i = 0; i < now.handSize; ++i) {
+                    if (!sameFace(now.cards[p][i], audience.last.cards[p][i])) {
+                        *delta += ' ';
+                        *delta += std::to_string(p);
+                        *delta += '.';
+                        *delta += std::to_string(i);
+                        *delta += '=';
+                        *delta += now.cards[p][i].toString();
+                    }
+                }
+            }
+            text = delta;
+        }
+        audience.last = now;
+    }
+    if (!audience.watchers->empty()) {
+        broadcasts.push_back({text, audience.watchers});
+    }
+}
\ No newline at end of file
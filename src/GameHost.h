@@ -0,0 +1,162 @@
+#ifndef GAME_HOST_H
+#define GAME_HOST_H
+
+#include "GameLogic.h"
+#include "SessionTable.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#define GAMEHOST_TICK_MS 5             // Moves wait at most this long for their batch
+#define GAMEHOST_MAX_TABLES 65536      // Across all shards
+#define GAMEHOST_IDLE_MS (10 * 60 * 1000) // Tables without a move for this long are closed
+#define GAMEHOST_MAX_SPECTATORS 16384  // Per table
+#define GAMEHOST_KEYFRAME_INTERVAL 32  // Deltas between spectator keyframes
+#define GAMEHOST_WATCH_LEASE_MS 30000  // Spectators that do not renew for this long are dropped
+#define GAMEHOST_COOKIE_MS 60000       // Watch cookies change this often; the last one still works
+
+// A request for a table, routed to the shard that owns it
+struct HostRequest {
+    CommandType cmd;
+    uint32_t table;
+    Endpoint from;
+    std::string args;
+    uint64_t receivedUs;
+};
+
+// A reply or pushed table state, sent by the network thread
+struct HostOutput {
+    Endpoint to;
+    std::string text;
+};
+
+// One pushed datagram shared by many recipients. The audience is a
+// snapshot of a table's spectators, shared rather than copied; the host
+// copies the list before changing it while a snapshot is still out.
+struct HostBroadcast {
+    std::shared_ptr<const std::string> text;
+    std::shared_ptr<const std::vector<Endpoint>> to;
+};
+
+// What a spectator can see of a table
+struct TableView {
+    int hole;
+    int turn;
+    int players;
+    int handSize;
+    Card discard;
+    Card cards[MAX_PLAYERS][GOLF_MAX_HAND];
+};
+
+// A hosted game of any variant, behind a virtual interface so one shard can
+// hold tables of every variant. Each implementation wraps a fully
+// specialized GolfEngine.
+class HostedTable {
+public:
+    virtual ~HostedTable() {}
+    virtual int players() const = 0;
+    virtual int turn() const = 0;
+    virtual bool finished() const = 0;
+    // Returns an error message, or nullptr when the move was played
+    virtual const char* move(int seat, bool fromDeck, int replaceSlot, int flipSlot) = 0;
+    virtual void render(const std::string* names, std::string& out) const = 0;
+    virtual void renderScores(const std::string* names, std::string& out) const = 0;
+    virtual void view(TableView& out) const = 0;
+};
+
+HostedTable* createHostedTable(int variant, int players, int holes, uint32_t seed);
+
+// Authoritative game hosting. Tables are sharded across worker threads by
+// table ID, and each worker alone touches its tables, so table state needs
+// no locks. The network thread hands requests to a shard's inbox. Once per
+// tick the shard swaps the inbox out, plays the whole batch, renders each
+// changed table once for all of its seats, and hands the outputs back
+// through an eventfd-signalled outbox. Only the tracker opens tables, and
+// it hands each seat a secret that its player must show to join and move.
+// Spectators of a table get each
+// change encoded once as a delta, with a keyframe every so often for
+// spectators who lost a datagram. A spectator must echo a cookie keyed to
+// its address before it is added, and renew within a lease to stay.
+class GameHost {
+public:
+    // Tables are opened only by TABLE_OPEN from the tracker's link endpoint
+    GameHost(int shards, int tickMs, const Endpoint& tracker);
+    ~GameHost();
+
+    void submit(CommandType cmd, const std::string& data, const Endpoint& from, uint64_t receivedUs);
+    void drain(std::vector<HostOutput>& out, std::vector<HostBroadcast>& broadcasts);
+    int wakeFd() const { return eventFd; }
+
+    size_t tables() const { return openTables.load(); }
+    uint64_t moves() const { return playedMoves.load(); }
+    // Worst time from receipt to the reply being handed back since the last call
+    uint64_t takeMaxLatencyUs() { return maxLatencyUs.exchange(0); }
+
+private:
+    struct Spectators {
+        std::shared_ptr<std::vector<Endpoint>> watchers;
+        std::vector<uint64_t> leaseEndMs; // Parallel to watchers
+        uint32_t seq;
+        uint32_t sinceKeyframe;
+        TableView last;
+    };
+
+    struct Table {
+        std::unique_ptr<HostedTable> game;
+        int variant;                      // Kept so a resent TABLE_OPEN can be matched
+        int holes;
+        std::string names[MAX_PLAYERS];
+        std::string secrets[MAX_PLAYERS]; // Issued by the tracker, one per seat
+        Endpoint seats[MAX_PLAYERS];
+        bool joined[MAX_PLAYERS];
+        bool dirty;
+        uint64_t lastMoveMs;
+        std::unique_ptr<Spectators> spectators; // Only while someone watches
+    };
+
+    struct Shard {
+        std::thread worker;
+        std::mutex inboxMutex;
+        std::vector<HostRequest> inbox;
+        std::unordered_map<uint32_t, Table> tables;
+        std::vector<uint32_t> changed; // Tables to publish at the end of the tick
+        uint32_t seed;
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    int tickMs;
+    Endpoint tracker;
+    int eventFd;
+    std::atomic<bool> stopping;
+    std::atomic<size_t> openTables;
+    std::atomic<uint64_t> playedMoves;
+    std::atomic<uint64_t> maxLatencyUs;
+    std::mutex outboxMutex;
+    std::vector<HostOutput> outbox;
+    std::vector<HostBroadcast> broadcastOutbox;
+    uint64_t cookieKey[2];
+
+    void run(Shard& shard);
+    void handle(Shard& shard, HostRequest& request, std::vector<HostOutput>& out, uint64_t nowMs);
+    void open(Shard& shard, HostRequest& request, std::vector<HostOutput>& out, uint64_t nowMs);
+    void join(Shard& shard, HostRequest& request, std::vector<HostOutput>& out);
+    void play(Shard& shard, HostRequest& request, std::vector<HostOutput>& out, uint64_t nowMs);
+    void watch(Shard& shard, HostRequest& request, std::vector<HostOutput>& out, uint64_t nowMs);
+    void unwatch(Shard& shard, HostRequest& request, std::vector<HostOutput>& out, uint64_t nowMs);
+    uint64_t cookie(const Endpoint& from, uint32_t table, uint64_t epoch) const;
+    bool validCookie(const HostRequest& request, const std::string& given, uint64_t nowMs) const;
+    void dropWatcher(Spectators& audience, size_t index);
+    void expireWatchers(Table& table, uint64_t nowMs);
+    void markChanged(Shard& shard, uint32_t id, Table& table);
+    void publish(uint32_t id, Table& table, std::vector<HostOutput>& out);
+    void spectate(uint32_t id, Table& table, std::vector<HostBroadcast>& broadcasts);
+};
+
+uint64_t hostClockUs();
+
+#endif // GAME_HOST_H
\ No newline at end of file
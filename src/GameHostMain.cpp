@@ -0,0 +1,159 @@
+#include "GameHost.h"
+#include "Transport.h"
+#include "FanOut.h"
+#include "Cluster.h"
+#include "Trace.h"
+#include <stdio.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <thread>
+#include <vector>
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s <UDP HOST PORT> --tracker <IP:PORT> [--shards <N>] [--tick <MS>]\n"
+                    "       [--transport sockets|io_uring] [--quiet]\n", program);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        usage(argv[0]);
+    }
+
+    unsigned short hostPort = atoi(argv[1]);
+    int shards = std::max(1u, std::thread::hardware_concurrency());
+    int tickMs = GAMEHOST_TICK_MS;
+    std::string transportKind = "sockets";
+    bool quiet = false;
+    std::vector<ClusterNode> trackers;
+
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    TRACE_INIT("GameHost", true);
+
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "--shards") == 0 && i + 1 < argc) {
+            shards = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--tracker") == 0 && i + 1 < argc) {
+            if (!parseClusterNodes(argv[++i], trackers) || trackers.size() != 1) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "--tick") == 0 && i + 1 < argc) {
+            tickMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--transport") == 0 && i + 1 < argc) {
+            transportKind = argv[++i];
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            quiet = true;
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (shards < 1 || tickMs < 1 || trackers.empty()) {
+        usage(argv[0]);
+    }
+    // The tracker opens tables from its link socket
+    Endpoint tracker = {inet_addr(trackers[0].ip.c_str()),
+                        htons(static_cast<uint16_t>(trackers[0].port + CLUSTER_LINK_PORT_OFFSET))};
+
+    int sock;
+    if ((sock = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0)
+        DieWithError("host: socket() failed");
+
+    struct sockaddr_in hostAddr;
+    memset(&hostAddr, 0, sizeof(hostAddr));
+    hostAddr.sin_family = AF_INET;
+    hostAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    hostAddr.sin_port = htons(hostPort);
+    if (bind(sock, (struct sockaddr *) &hostAddr, sizeof(hostAddr)) < 0)
+        DieWithError("host: bind() failed");
+
+    Transport* transport = createTransport(transportKind, sock);
+    GameHost host(shards, tickMs, tracker);
+    printf("Game host is running on port %d (%d shards, %d ms ticks, %s transport)\n", hostPort, shards, tickMs,
+           transport->name());
+
+    std::vector<InboundDatagram> batch(TRANSPORT_MAX_BATCH);
+    std::vector<HostOutput> outputs;
+    std::vector<HostBroadcast> broadcasts;
+    FanOut spectators(sock);
+    uint64_t lastReportMs = hostClockUs() / 1000;
+    uint64_t lastMoves = 0;
+    uint64_t lastSpectated = 0;
+
+    for (;;) {
+        // Wake for requests, and when a shard has finished a tick
+        // revents stay zero when poll() is interrupted
+        struct pollfd fds[2];
+        memset(fds, 0, sizeof(fds));
+        fds[0].fd = transport->fd();
+        fds[0].events = transport->pollEvents();
+        fds[1].fd = host.wakeFd();
+        fds[1].events = POLLIN;
+        if (poll(fds, 2, 1000) < 0 && errno != EINTR)
+            DieWithError("host: poll() failed");
+        transport->stats().syscalls++;
+        if (TRACE_POLL())
+            break;
+        transport->ready(fds[0].revents);
+
+        uint64_t nowUs = hostClockUs();
+        int depth = (fds[0].revents & POLLIN) ? transport->receive(batch.data(), TRANSPORT_MAX_BATCH) : 0;
+        for (int i = 0; i < depth; ++i) {
+            const Message& msg = *batch[i].msg;
+            Endpoint from = {batch[i].addr.sin_addr.s_addr, batch[i].addr.sin_port};
+            if (!quiet) {
+                char clientIP[INET_ADDRSTRLEN];
+                inet_ntop(AF_INET, &batch[i].addr.sin_addr, clientIP, sizeof(clientIP));
+                printf("Received from client %s: Command %d, Data: %s\n", clientIP, msg.cmd, msg.data);
+            }
+            host.submit(msg.cmd, msg.data, from, nowUs);
+        }
+
+        if (fds[1].revents & POLLIN) {
+            host.drain(outputs, broadcasts);
+            for (const HostOutput& output : outputs) {
+                struct sockaddr_in to;
+                memset(&to, 0, sizeof(to));
+                to.sin_family = AF_INET;
+                to.sin_addr.s_addr = output.to.addr;
+                to.sin_port = output.to.port;
+                transport->send(output.text.c_str(), output.text.length(), to);
+            }
+            outputs.clear();
+        }
+        transport->flush();
+
+        // Spectator updates go out after the replies, one sendmmsg() per
+        // batch of recipients sharing the encoded update
+        for (const HostBroadcast& broadcast : broadcasts) {
+            spectators.send(broadcast.text->data(), broadcast.text->size(), broadcast.to->data(), broadcast.to->size());
+        }
+        broadcasts.clear();
+
+        uint64_t nowMs = hostClockUs() / 1000;
+        if (nowMs - lastReportMs >= 1000) {
+            uint64_t moves = host.moves();
+            if (moves != lastMoves) {
+                printf("host: %zu tables, %llu moves/s, worst move latency %.2f ms\n", host.tables(),
+                       (unsigned long long) (moves - lastMoves), host.takeMaxLatencyUs() / 1000.0);
+            }
+            if (spectators.sent() != lastSpectated) {
+                printf("host: %llu spectator datagrams/s, %llu dropped in total, %llu sendmmsg calls in total\n",
+                       (unsigned long long) (spectators.sent() - lastSpectated),
+                       (unsigned long long) spectators.dropped(), (unsigned long long) spectators.calls());
+            }
+            lastMoves = moves;
+            lastSpectated = spectators.sent();
+            lastReportMs = nowMs;
+        }
+        transport->report(nowMs);
+    }
+
+    delete transport;
+    close(sock);
+    return 0;
+}
\ No newline at end of file
@@ -2,26 +2,217 @@
 #define GAME_LOGIC_H
 
 #include "Utils.h"
-#include <vector>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
 #include <string>
 
-class SixGolfGameLogic {
+#define GOLF_DECK_SIZE 52
+#define GOLF_MAX_HOLES 9
+
+// Card layout of a golf variant: Rows x Cols cards per hand, of which
+// FaceUp are turned over at random when a hole is dealt
+template <int Rows, int Cols, int FaceUp>
+struct GolfGrid {
+    static constexpr int rows = Rows;
+    static constexpr int cols = Cols;
+    static constexpr int handSize = Rows * Cols;
+    static constexpr int initialFaceUp = FaceUp;
+    static_assert(Rows >= 1 && Cols >= 1 && FaceUp >= 0 && FaceUp <= Rows * Cols, "invalid golf grid");
+    static_assert(Rows * Cols * MAX_PLAYERS + 1 <= GOLF_DECK_SIZE, "a full table cannot be dealt from one deck");
+};
+
+// The scoring the engine has always used: pips at face value, aces one,
+// court cards ten, and no column bonuses
+struct ClassicScoring {
+    static constexpr int cardValue(int rank) {
+        return rank == 14 ? 1 : rank <= 10 ? rank : 10;
+    }
+    static constexpr bool columnsCancel = false;
+};
+
+// House rules: twos minus two, kings free, and a face-up column of matching
+// ranks scores nothing
+struct HouseScoring {
+    static constexpr int cardValue(int rank) {
+        return rank == 2 ? -2 : rank == 13 ? 0 : rank == 14 ? 1 : rank <= 10 ? rank : 10;
+    }
+    static constexpr bool columnsCancel = true;
+};
+
+// Per-rank values of a scoring policy, indexed by Card::rank, and the
+// bounds a hand's score can take, all fixed at compile time
+template <class Scoring>
+struct ScoreTable {
+    static constexpr int minValue(int rank = 2) {
+        return rank == 14 ? Scoring::cardValue(14)
+                          : Scoring::cardValue(rank) < minValue(rank + 1) ? Scoring::cardValue(rank) : minValue(rank + 1);
+    }
+    static constexpr int maxValue(int rank = 2) {
+        return rank == 14 ? Scoring::cardValue(14)
+                          : Scoring::cardValue(rank) > maxValue(rank + 1) ? Scoring::cardValue(rank) : maxValue(rank + 1);
+    }
+    static constexpr int values[15] = {
+        0, 0,
+        Scoring::cardValue(2), Scoring::cardValue(3), Scoring::cardValue(4), Scoring::cardValue(5),
+        Scoring::cardValue(6), Scoring::cardValue(7), Scoring::cardValue(8), Scoring::cardValue(9),
+        Scoring::cardValue(10), Scoring::cardValue(11), Scoring::cardValue(12), Scoring::cardValue(13),
+        Scoring::cardValue(14)
+    };
+};
+
+template <class Scoring>
+constexpr int ScoreTable<Scoring>::values[15];
+
+// One golf variant's engine. Hands, deck, discard pile and score sheet are
+// fixed-size arrays sized by the grid, so dealing and playing never
+// allocate. Rule differences are resolved at compile time: the hand size,
+// grid shape and scoring policy are template parameters.
+template <class Grid, class Scoring>
+class GolfEngine {
 public:
-    SixGolfGameLogic(int numPlayers, int numHoles);
-    void startNewHole();
-    void dealCards();
-    bool isHoleFinished() const;
-    bool isGameFinished() const;
-    int getCurrentPlayerTurn() const;
-    void nextTurn();
-    Card drawCard(bool fromDeck);
-    void discardCard(const Card& card);
-    void replaceCard(int playerIndex, int cardIndex, const Card& newCard);
-    void flipCard(int playerIndex, int cardIndex);
-    int calculateScore(int playerIndex) const;
-    void calculateHoleScores();
-    std::vector<int> getFinalScores() const;
-    int getWinner() const;
+    static constexpr int handSize = Grid::handSize;
+    static constexpr int minHoleScore = handSize * (ScoreTable<Scoring>::minValue() < 0 ? ScoreTable<Scoring>::minValue() : 0);
+    static constexpr int maxHoleScore = handSize * ScoreTable<Scoring>::maxValue();
+    typedef std::array<Card, handSize> Hand;
+    typedef std::array<int, MAX_PLAYERS> Scores;
+
+    static int cardValue(int rank) { return ScoreTable<Scoring>::values[rank]; }
+
+    GolfEngine(int numPlayers, int numHoles, uint32_t seed = std::random_device()())
+        : numPlayers(numPlayers), numHoles(numHoles), currentHole(0), currentPlayerTurn(0),
+          holeFinished(false), gameFinished(false), deckSize(0), discardSize(0), rng(seed) {
+        if (numPlayers < 1 || numPlayers > MAX_PLAYERS || numHoles < 1 || numHoles > GOLF_MAX_HOLES) {
+            throw std::invalid_argument("Invalid number of players or holes");
+        }
+        for (auto& sheet : playerScores) {
+            sheet.fill(0);
+        }
+        startNewHole();
+    }
+
+    void startNewHole() {
+        currentHole++;
+        holeFinished = false;
+        deckSize = 0;
+        const char suits[] = {'H', 'D', 'S', 'C'};
+        for (char suit : suits) {
+            for (int rank = 2; rank <= 14; ++rank) {
+                deck[deckSize++] = Card(rank, suit);
+            }
+        }
+        std::shuffle(deck.begin(), deck.begin() + deckSize, rng);
+        discardSize = 0;
+        dealCards();
+        initializePlayerHands();
+    }
+
+    void dealCards() {
+        for (int i = 0; i < handSize; ++i) {
+            for (int p = 0; p < numPlayers; ++p) {
+                playerHands[p][i] = deck[--deckSize];
+            }
+        }
+        discardCard(deck[--deckSize]);
+    }
+
+    bool isHoleFinished() const { return holeFinished; }
+    bool isGameFinished() const { return gameFinished; }
+    int getCurrentPlayerTurn() const { return currentPlayerTurn; }
+    int getCurrentHole() const { return currentHole; }
+    int getNumPlayers() const { return numPlayers; }
+    const Hand& getHand(int playerIndex) const { return playerHands[playerIndex]; }
+    const Card& topDiscard() const { return discardPile[discardSize - 1]; }
+
+    void nextTurn() {
+        currentPlayerTurn = (currentPlayerTurn + 1) % numPlayers;
+        checkHoleFinished();
+    }
+
+    // An empty deck is rebuilt from the discard pile under its top card
+    Card drawCard(bool fromDeck) {
+        if (!fromDeck) {
+            if (discardSize == 0) {
+                throw std::runtime_error("Discard pile is empty");
+            }
+            return discardPile[--discardSize];
+        }
+        if (deckSize == 0) {
+            if (discardSize < 2) {
+                throw std::runtime_error("Deck is empty");
+            }
+            for (int i = 0; i < discardSize - 1; ++i) {
+                deck[deckSize] = discardPile[i];
+                deck[deckSize++].faceUp = false;
+            }
+            discardPile[0] = discardPile[discardSize - 1];
+            discardSize = 1;
+            std::shuffle(deck.begin(), deck.begin() + deckSize, rng);
+        }
+        return deck[--deckSize];
+    }
+
+    void discardCard(const Card& card) {
+        discardPile[discardSize] = card;
+        discardPile[discardSize++].faceUp = true;
+    }
+
+    void replaceCard(int playerIndex, int cardIndex, const Card& newCard) {
+        Card oldCard = playerHands[playerIndex][cardIndex];
+        playerHands[playerIndex][cardIndex] = newCard;
+        playerHands[playerIndex][cardIndex].faceUp = true;
+        discardCard(oldCard);
+    }
+
+    void flipCard(int playerIndex, int cardIndex) {
+        playerHands[playerIndex][cardIndex].faceUp = true;
+    }
+
+    // Face-down cards do not count. A column cancels only when every card in
+    // it is face up and of one rank.
+    int calculateScore(int playerIndex) const {
+        const Hand& hand = playerHands[playerIndex];
+        int score = 0;
+        for (int c = 0; c < Grid::cols; ++c) {
+            int column = 0;
+            bool cancels = Scoring::columnsCancel && Grid::rows > 1;
+            for (int r = 0; r < Grid::rows; ++r) {
+                const Card& card = hand[r * Grid::cols + c];
+                if (!card.faceUp) {
+                    cancels = false;
+                    continue;
+                }
+                column += ScoreTable<Scoring>::values[card.rank];
+                cancels = cancels && card.rank == hand[c].rank;
+            }
+            score += cancels ? 0 : column;
+        }
+        return score;
+    }
+
+    void calculateHoleScores() {
+        for (int i = 0; i < numPlayers; ++i) {
+            playerScores[i][currentHole - 1] = calculateScore(i);
+        }
+    }
+
+    Scores getFinalScores() const {
+        Scores finalScores;
+        finalScores.fill(0);
+        for (int i = 0; i < numPlayers; ++i) {
+            for (int h = 0; h < numHoles; ++h) {
+                finalScores[i] += playerScores[i][h];
+            }
+        }
+        return finalScores;
+    }
+
+    int getWinner() const {
+        Scores finalScores = getFinalScores();
+        return static_cast<int>(std::min_element(finalScores.begin(), finalScores.begin() + numPlayers) - finalScores.begin());
+    }
 
 private:
     int numPlayers;
@@ -30,14 +221,161 @@ private:
     int currentPlayerTurn;
     bool holeFinished;
     bool gameFinished;
-    Deck deck;
-    std::vector<Card> discardPile;
-    std::vector<std::vector<Card>> playerHands;
-    std::vector<std::vector<int>> playerScores;
-
-    void initializeGame();
-    void initializePlayerHands();
-    void checkHoleFinished();
+    std::array<Card, GOLF_DECK_SIZE> deck;
+    int deckSize;
+    std::array<Card, GOLF_DECK_SIZE> discardPile;
+    int discardSize;
+    std::array<Hand, MAX_PLAYERS> playerHands;
+    std::array<std::array<int, GOLF_MAX_HOLES>, MAX_PLAYERS> playerScores;
+    std::mt19937 rng;
+
+    // Turns Grid::initialFaceUp distinct cards of each hand face up
+    void initializePlayerHands() {
+        for (int p = 0; p < numPlayers; ++p) {
+            std::array<int, handSize> indices;
+            for (int i = 0; i < handSize; ++i) {
+                indices[i] = i;
+            }
+            for (int i = 0; i < Grid::initialFaceUp; ++i) {
+                std::uniform_int_distribution<int> pick(i, handSize - 1);
+                std::swap(indices[i], indices[pick(rng)]);
+                playerHands[p][indices[i]].faceUp = true;
+            }
+        }
+    }
+
+    void checkHoleFinished() {
+        for (int p = 0; p < numPlayers && !holeFinished; ++p) {
+            const Hand& hand = playerHands[p];
+            holeFinished = std::all_of(hand.begin(), hand.end(), [](const Card& card) { return card.faceUp; });
+        }
+
+        if (holeFinished) {
+            calculateHoleScores();
+            if (currentHole == numHoles) {
+                gameFinished = true;
+            } else {
+                startNewHole();
+            }
+        }
+    }
+};
+
+// Worst face-up card a new card would improve on, or a face-down card to
+// take when none would; -1 when the card is not worth keeping
+template <class Engine>
+int greedySlot(const typename Engine::Hand& hand, int value) {
+    int worst = -1;
+    for (int i = 0; i < Engine::handSize; ++i) {
+        if (hand[i].faceUp && value < Engine::cardValue(hand[i].rank) &&
+            (worst < 0 || Engine::cardValue(hand[i].rank) > Engine::cardValue(hand[worst].rank))) {
+            worst = i;
+        }
+    }
+    if (worst < 0 && value <= 4) {
+        for (int i = 0; i < Engine::handSize; ++i) {
+            if (!hand[i].faceUp) {
+                return i;
+            }
+        }
+    }
+    return worst;
+}
+
+// Plays the current player's turn and passes it on. take(hand, discard) and
+// keep(hand, drawn) name the slot a card goes to, or -1: the discard is
+// taken when take() names a slot, else a card is drawn, and a drawn card
+// that is not kept is discarded and the first face-down card turned over.
+template <class Engine, class Take, class Keep>
+void playGolfTurn(Engine& game, Take take, Keep keep) {
+    int p = game.getCurrentPlayerTurn();
+    const typename Engine::Hand& hand = game.getHand(p);
+    int slot = take(hand, game.topDiscard());
+    bool fromDeck = slot < 0;
+    Card card = game.drawCard(!fromDeck);
+    if (fromDeck) {
+        slot = keep(hand, card);
+    }
+    if (slot >= 0) {
+        game.replaceCard(p, slot, card);
+    } else {
+        game.discardCard(card);
+        for (int i = 0; i < Engine::handSize; ++i) {
+            if (!hand[i].faceUp) {
+                game.flipCard(p, i);
+                break;
+            }
+        }
+    }
+    game.nextTurn();
+}
+
+// A turn of the greedy bot shared by the simulator, the bot swarm and the
+// benchmarks
+template <class Engine>
+void playGreedyTurn(Engine& game) {
+    auto greedy = [](const typename Engine::Hand& hand, const Card& card) {
+        return greedySlot<Engine>(hand, Engine::cardValue(card.rank));
+    };
+    playGolfTurn(game, greedy, greedy);
+}
+
+// Every variant the tracker and the simulator know, as
+// X(name, rows, cols, face-up cards, scoring). The first entry is the default.
+#define GOLF_VARIANT_LIST(X)                    \
+    X(six, 2, 3, 2, ClassicScoring)             \
+    X(four, 2, 2, 2, ClassicScoring)            \
+    X(eight, 2, 4, 2, ClassicScoring)           \
+    X(nine, 3, 3, 3, ClassicScoring)            \
+    X(six_house, 2, 3, 2, HouseScoring)         \
+    X(four_house, 2, 2, 2, HouseScoring)        \
+    X(eight_house, 2, 4, 2, HouseScoring)       \
+    X(nine_house, 3, 3, 3, HouseScoring)
+
+// Cards in the largest hand of any variant in GOLF_VARIANT_LIST
+constexpr int golfLargest(int size) {
+    return size;
+}
+template <class... Sizes>
+constexpr int golfLargest(int size, Sizes... sizes) {
+    return size > golfLargest(sizes...) ? size : golfLargest(sizes...);
+}
+constexpr int golfMaxHand() {
+#define GOLF_HAND_SIZE(name, rows, cols, faceUp, scoring) (rows) * (cols),
+    return golfLargest(GOLF_VARIANT_LIST(GOLF_HAND_SIZE) 0);
+#undef GOLF_HAND_SIZE
+}
+#define GOLF_MAX_HAND golfMaxHand()
+
+typedef GolfEngine<GolfGrid<2, 3, 2>, ClassicScoring> SixGolfGameLogic;
+
+// What the tracker needs to know about a variant without playing it
+struct GolfVariant {
+    const char* name;
+    int rows;
+    int cols;
+    int minHoleScore;
+    int maxHoleScore;
 };
 
+int golfVariantCount();
+const GolfVariant& golfVariant(int index);
+int findGolfVariant(const std::string& name); // -1 when unknown
+
+// Calls visitor.template run<Engine>() with the named variant's engine type,
+// so a caller such as the simulator runs a fully specialized engine
+// without virtual dispatch. Returns false for an unknown index.
+template <class Visitor>
+bool visitGolfVariant(int index, Visitor& visitor) {
+    int i = 0;
+#define GOLF_VISIT(name, rows, cols, faceUp, scoring)                                \
+    if (index == i++) {                                                              \
+        visitor.template run<GolfEngine<GolfGrid<rows, cols, faceUp>, scoring>>();  \
+        return true;                                                                 \
+    }
+    GOLF_VARIANT_LIST(GOLF_VISIT)
+#undef GOLF_VISIT
+    return false;
+}
+
 #endif // GAME_LOGIC_H
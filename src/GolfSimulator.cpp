@@ -0,0 +1,132 @@
+// Plays whole golf games between greedy bots on any rule variant, to compare
+// variants and measure the engine. Each variant runs on its own specialized
+// engine, and the play loop is checked to make no heap allocations. Given a
+// directory of StrategyGen output, the bots in odd seats play by the
+// variant's strategy table instead.
+//
+// Usage: GolfSimulator [variant|all] [games] [players] [holes] [seed] [strategy directory]
+
+#include "GameLogic.h"
+#include "Strategy.h"
+#include "Trace.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+typedef std::chrono::steady_clock Clock;
+
+static std::atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size) {
+    allocations++;
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+struct Simulation {
+    int games;
+    int players;
+    int holes;
+    uint32_t seed;
+    std::string strategyDirectory;
+    const char* variant;
+
+    template <class Engine>
+    void run() {
+        StrategyTable strategy;
+        if (!strategyDirectory.empty()) {
+            std::string error;
+            if (!strategy.load(strategyDirectory + "/" + variant + ".strategy", error) || !strategy.fits<Engine>()) {
+                printf("no strategy table (%s)\n", error.empty() ? "generated for another grid" : error.c_str());
+                return;
+            }
+        }
+
+        int64_t totalScore = 0;
+        int64_t seatScores[2] = {0, 0};
+        int64_t turns = 0;
+        int wins[MAX_PLAYERS] = {0};
+        uint64_t allocationsBefore = allocations.load();
+        Clock::time_point start = Clock::now();
+
+        for (int g = 0; g < games; ++g) {
+            Engine game(players, holes, seed + g);
+            TRACE_SAMPLE();
+            TRACE_SCOPE("game");
+            while (!game.isGameFinished()) {
+                TRACE_SCOPE("turn");
+                // Odd seats play the strategy table when one is loaded
+                if (strategy.loaded() && game.getCurrentPlayerTurn() % 2 == 1) {
+                    playGolfTurn(game,
+                        [&strategy](const typename Engine::Hand& hand, const Card& card) { return strategy.take<Engine>(hand, card); },
+                        [&strategy](const typename Engine::Hand& hand, const Card& card) { return strategy.keep<Engine>(hand, card); });
+                } else {
+                    playGreedyTurn(game);
+                }
+                turns++;
+            }
+            typename Engine::Scores scores = game.getFinalScores();
+            for (int p = 0; p < players; ++p) {
+                totalScore += scores[p];
+                seatScores[p % 2] += scores[p];
+            }
+            wins[game.getWinner()]++;
+        }
+
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        printf("%8.0f games/s %8.0f turns/s  mean hole score %6.2f  allocations %llu  wins",
+               games / seconds, turns / seconds, static_cast<double>(totalScore) / (games * players * holes),
+               static_cast<unsigned long long>(allocations.load() - allocationsBefore));
+        for (int p = 0; p < players; ++p) {
+            printf(" %d", wins[p]);
+        }
+        if (strategy.loaded() && players > 1) {
+            int tabled = players / 2, greedy = players - tabled;
+            printf("  hole score greedy %.2f tabled %.2f", static_cast<double>(seatScores[0]) / (games * greedy * holes),
+                   static_cast<double>(seatScores[1]) / (games * tabled * holes));
+        }
+        printf("\n");
+    }
+};
+
+int main(int argc, char* argv[]) {
+    std::string variant = argc > 1 ? argv[1] : "all";
+    Simulation sim;
+    sim.games = argc > 2 ? atoi(argv[2]) : 100000;
+    sim.players = argc > 3 ? atoi(argv[3]) : 4;
+    sim.holes = argc > 4 ? atoi(argv[4]) : 9;
+    sim.seed = argc > 5 ? static_cast<uint32_t>(strtoul(argv[5], nullptr, 10)) : 1;
+    sim.strategyDirectory = argc > 6 ? argv[6] : "";
+    int only = variant == "all" ? -1 : findGolfVariant(variant);
+    TRACE_INIT("GolfSimulator", false);
+    if (sim.games <= 0 || sim.players < 1 || sim.players > MAX_PLAYERS || sim.holes < 1 ||
+        sim.holes > GOLF_MAX_HOLES || (variant != "all" && only < 0)) {
+        fprintf(stderr, "Usage: %s [variant|all] [games] [players 1-%d] [holes 1-%d] [seed] [strategy directory]\n",
+                argv[0], MAX_PLAYERS, GOLF_MAX_HOLES);
+        fprintf(stderr, "Variants:");
+        for (int i = 0; i < golfVariantCount(); ++i) {
+            fprintf(stderr, " %s", golfVariant(i).name);
+        }
+        fprintf(stderr, "\n");
+        return 1;
+    }
+
+    for (int i = 0; i < golfVariantCount(); ++i) {
+        if (only < 0 || only == i) {
+            printf("%-12s", golfVariant(i).name);
+            sim.variant = golfVariant(i).name;
+            visitGolfVariant(i, sim);
+        }
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#include "Invitations.h"
+#include <algorithm>
+#include <limits>
+
+static uint64_t inviteKey(uint32_t gameId, uint32_t player) {
+    return (static_cast<uint64_t>(gameId) << 32) | player;
+}
+
+InvitationQueue::InvitationQueue() : earliestMs(std::numeric_limits<uint64_t>::max()) {}
+
+// The first send goes out with the next call to due()
+void InvitationQueue::add(uint32_t gameId, uint32_t player, const Endpoint& to,
+                          const std::shared_ptr<const std::string>& message, uint64_t nowMs) {
+    Pending& pending = invites[inviteKey(gameId, player)];
+    pending.invitation.to = to;
+    pending.invitation.message = message;
+    pending.nextMs = nowMs;
+    pending.sends = 0;
+    earliestMs = std::min(earliestMs, nowMs);
+}
+
+bool InvitationQueue::ack(uint32_t gameId, uint32_t player) {
+    return invites.erase(inviteKey(gameId, player)) > 0;
+}
+
+void InvitationQueue::cancelGame(uint32_t gameId) {
+    for (auto it = invites.begin(); it != invites.end();) {
+        it = (it->first >> 32) == gameId ? invites.erase(it) : std::next(it);
+    }
+}
+
+void InvitationQueue::clear() {
+    invites.clear();
+    earliestMs = std::numeric_limits<uint64_t>::max();
+}
+
+void InvitationQueue::due(uint64_t nowMs, std::vector<Invitation>& out) {
+    if (nowMs < earliestMs) {
+        return;
+    }
+    earliestMs = std::numeric_limits<uint64_t>::max();
+    for (auto it = invites.begin(); it != invites.end();) {
+        Pending& pending = it->second;
+        if (pending.nextMs <= nowMs) {
+            if (pending.sends == INVITE_MAX_SENDS) {
+                it = invites.erase(it);
+                continue;
+            }
+            out.push_back(pending.invitation);
+            pending.nextMs = nowMs + (static_cast<uint64_t>(INVITE_RETRY_MS) << pending.sends);
+            pending.sends++;
+        }
+        earliestMs = std::min(earliestMs, pending.nextMs);
+        ++it;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef INVITATIONS_H
+#define INVITATIONS_H
+
+#include "SessionTable.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define INVITE_RETRY_MS 250   // Wait before the first resend; doubles with each resend
+#define INVITE_MAX_SENDS 5    // Sends of one invitation before it is given up
+
+// A START notification due to go out now
+struct Invitation {
+    Endpoint to;
+    std::shared_ptr<const std::string> message; // One copy per game, shared by its seats
+};
+
+// START notifications for the seated players of new games, resent until
+// each player acknowledges with START_ACK. Pending invitations are keyed by
+// game and player. Nothing is scanned until the earliest resend comes due,
+// so the tracker loop can ask for due invitations every iteration.
+class InvitationQueue {
+public:
+    InvitationQueue();
+
+    void add(uint32_t gameId, uint32_t player, const Endpoint& to, const std::shared_ptr<const std::string>& message,
+             uint64_t nowMs);
+    bool ack(uint32_t gameId, uint32_t player);
+    void cancelGame(uint32_t gameId);
+    void clear();
+    // Appends the invitations to send now and schedules their next resend
+    void due(uint64_t nowMs, std::vector<Invitation>& out);
+    size_t pending() const { return invites.size(); }
+
+private:
+    struct Pending {
+        Invitation invitation;
+        uint64_t nextMs;
+        int sends;
+    };
+
+    std::unordered_map<uint64_t, Pending> invites; // (game ID << 32) | player handle
+    uint64_t earliestMs;
+};
+
+#endif // INVITATIONS_H
\ No newline at end of file
@@ -0,0 +1,368 @@
+#include "IoUringTransport.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+// user_data of the receive and buffer operations; sends carry their slot index
+#define RECV_TAG 0xFFFFFFFFFFFFFFFFull
+#define PROVIDE_TAG 0xFFFFFFFFFFFFFFFEull
+
+static int ioUringSetup(unsigned entries, struct io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int ioUringRegister(int fd, unsigned opcode, const void* arg, unsigned count) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+// The kernel and this process share the ring indices
+static unsigned loadAcquire(const unsigned* p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static void storeRelease(unsigned* p, unsigned value) {
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+IoUringTransport::IoUringTransport(int sock)
+    : ringFd(-1), sock(sock), sqRing(MAP_FAILED), sqRingSize(0), cqRing(MAP_FAILED), cqRingSize(0),
+      sqes(static_cast<struct io_uring_sqe*>(MAP_FAILED)), sqesSize(0), localTail(0), submitted(0),
+      bufRing(static_cast<struct io_uring_buf_ring*>(MAP_FAILED)), bufRingSize(0), recvBuffers(nullptr),
+      recvBufferSize(0), bufTail(0), ringBuffers(false), recvArmed(false), slots(URING_SEND_SLOTS), freeSlot(0),
+      slotsInUse(0) {
+    for (int i = 0; i < URING_SEND_SLOTS; ++i) {
+        slots[i].next = i + 1 < URING_SEND_SLOTS ? i + 1 : -1;
+    }
+}
+
+IoUringTransport* IoUringTransport::create(int sock, std::string& error) {
+    IoUringTransport* transport = new IoUringTransport(sock);
+    if (!transport->setup(error)) {
+        delete transport;
+        return nullptr;
+    }
+    return transport;
+}
+
+IoUringTransport::~IoUringTransport() {
+    if (bufRing != MAP_FAILED) {
+        munmap(bufRing, bufRingSize);
+    }
+    delete[] recvBuffers;
+    if (sqes != MAP_FAILED) {
+        munmap(sqes, sqesSize);
+    }
+    if (cqRing != MAP_FAILED && cqRing != sqRing) {
+        munmap(cqRing, cqRingSize);
+    }
+    if (sqRing != MAP_FAILED) {
+        munmap(sqRing, sqRingSize);
+    }
+    if (ringFd >= 0) {
+        close(ringFd);
+    }
+}
+
+// Multishot RECVMSG needs Linux 6.0; older kernels would accept the ring
+// and the buffer registration but fail the first receive
+static bool kernelAtLeast(int major, int minor) {
+    struct utsname name;
+    int haveMajor = 0, haveMinor = 0;
+    if (uname(&name) != 0 || sscanf(name.release, "%d.%d", &haveMajor, &haveMinor) != 2) {
+        return false;
+    }
+    return haveMajor > major || (haveMajor == major && haveMinor >= minor);
+}
+
+bool IoUringTransport::setup(std::string& error) {
+    if (!kernelAtLeast(6, 0)) {
+        error = "multishot receive needs Linux 6.0 or later";
+        return false;
+    }
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = URING_CQ_ENTRIES;
+    if ((ringFd = ioUringSetup(URING_SQ_ENTRIES, &params)) < 0) {
+        error = std::string("io_uring_setup: ") + strerror(errno);
+        return false;
+    }
+
+    // Map the rings; recent kernels share one mapping for both
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) {
+        sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+    }
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) {
+        error = std::string("mmap: ") + strerror(errno);
+        return false;
+    }
+    cqRing = single ? sqRing
+                    : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+    sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = static_cast<struct io_uring_sqe*>(
+        mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+    if (cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+        error = std::string("mmap: ") + strerror(errno);
+        return false;
+    }
+
+    char* sq = static_cast<char*>(sqRing);
+    char* cq = static_cast<char*>(cqRing);
+    sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqEntries = params.sq_entries;
+    sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+    localTail = submitted = *sqTail;
+
+    // Registering the socket saves a file table lookup per operation
+    if (ioUringRegister(ringFd, IORING_REGISTER_FILES, &sock, 1) < 0) {
+        error = std::string("register files: ") + strerror(errno);
+        return false;
+    }
+
+    // Provided buffers: each holds the recvmsg header, the
+    // sender's address and one request
+    memset(&recvTemplate, 0, sizeof(recvTemplate));
+    recvTemplate.msg_namelen = sizeof(sockaddr_in);
+    recvBufferSize = sizeof(struct io_uring_recvmsg_out) + sizeof(sockaddr_in) + sizeof(Message);
+    recvBufferSize = (recvBufferSize + 63) & ~static_cast<size_t>(63);
+    recvBuffers = new char[URING_RECV_BUFFERS * recvBufferSize];
+    bufRingSize = URING_RECV_BUFFERS * sizeof(struct io_uring_buf);
+    bufRing = static_cast<struct io_uring_buf_ring*>(
+        mmap(nullptr, bufRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0));
+    if (bufRing == MAP_FAILED) {
+        error = std::string("mmap: ") + strerror(errno);
+        return false;
+    }
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(bufRing);
+    reg.ring_entries = URING_RECV_BUFFERS;
+    reg.bgid = URING_BUFFER_GROUP;
+    ringBuffers = ioUringRegister(ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) == 0;
+    if (ringBuffers) {
+        for (uint16_t bid = 0; bid < URING_RECV_BUFFERS; ++bid) {
+            returnBuffer(bid);
+        }
+    } else {
+        provideBuffers(0, URING_RECV_BUFFERS);
+    }
+
+    armReceive();
+    flush();
+    return true;
+}
+
+struct io_uring_sqe* IoUringTransport::nextSqe() {
+    if (localTail - loadAcquire(sqHead) >= sqEntries) {
+        flush(); // Ring full: hand what we have to the kernel first
+        if (localTail - loadAcquire(sqHead) >= sqEntries) {
+            return nullptr;
+        }
+    }
+    unsigned index = localTail & sqMask;
+    struct io_uring_sqe* sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqArray[index] = index;
+    localTail++;
+    return sqe;
+}
+
+void IoUringTransport::armReceive() {
+    struct io_uring_sqe* sqe = nextSqe();
+    if (sqe == nullptr) {
+        return;
+    }
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = 0; // Index into the registered files
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe->addr = reinterpret_cast<uint64_t>(&recvTemplate);
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = RECV_TAG;
+    recvArmed = true;
+}
+
+// Hands a run of buffers to the kernel with a PROVIDE_BUFFERS entry, for
+// kernels that cannot register a buffer ring. It rides along with the next
+// submission and posts no completion unless it fails.
+void IoUringTransport::provideBuffers(uint16_t firstBid, unsigned count) {
+    struct io_uring_sqe* sqe = nextSqe();
+    if (sqe == nullptr) {
+        return;
+    }
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = static_cast<int>(count);
+    sqe->addr = reinterpret_cast<uint64_t>(recvBuffers + firstBid * recvBufferSize);
+    sqe->len = static_cast<uint32_t>(recvBufferSize);
+    sqe->off = firstBid;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+    sqe->user_data = PROVIDE_TAG;
+}
+
+// Returns the buffers the last receive() handed out, coalescing
+// consecutive IDs when they go back through PROVIDE_BUFFERS
+void IoUringTransport::returnLentBuffers() {
+    if (ringBuffers) {
+        for (uint16_t bid : lentBuffers) {
+            returnBuffer(bid);
+        }
+    } else if (!lentBuffers.empty()) {
+        std::sort(lentBuffers.begin(), lentBuffers.end());
+        size_t start = 0;
+        for (size_t i = 1; i <= lentBuffers.size(); ++i) {
+            if (i == lentBuffers.size() || lentBuffers[i] != lentBuffers[i - 1] + 1) {
+                provideBuffers(lentBuffers[start], static_cast<unsigned>(i - start));
+                start = i;
+            }
+        }
+    }
+    lentBuffers.clear();
+}
+
+// The ring's entries start at its first byte, with the tail overlaying the
+// first entry's reserved field. Compiled as C++, the header's flexible
+// array member places bufs 8 bytes in, so the entries are indexed directly.
+void IoUringTransport::returnBuffer(uint16_t bid) {
+    struct io_uring_buf* buf = &reinterpret_cast<struct io_uring_buf*>(bufRing)[bufTail & (URING_RECV_BUFFERS - 1)];
+    buf->addr = reinterpret_cast<uint64_t>(recvBuffers + bid * recvBufferSize);
+    buf->len = static_cast<uint32_t>(recvBufferSize);
+    buf->bid = bid;
+    bufTail++;
+    __atomic_store_n(&bufRing->tail, bufTail, __ATOMIC_RELEASE);
+}
+
+void IoUringTransport::releaseSlot(int index) {
+    slots[index].next = freeSlot;
+    freeSlot = index;
+    slotsInUse--;
+}
+
+int IoUringTransport::enter(unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    counters.syscalls++;
+    return static_cast<int>(syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+short IoUringTransport::pollEvents() const {
+    return POLLIN;
+}
+
+// Reaps completions straight from the shared ring. Receive completions
+// become requests, and send completions free their slots.
+int IoUringTransport::receive(InboundDatagram* batch, int max) {
+    returnLentBuffers();
+
+    int count = 0;
+    unsigned head = *cqHead;
+    unsigned tail = loadAcquire(cqTail);
+    while (head != tail && count < max) {
+        const struct io_uring_cqe& cqe = cqes[head & cqMask];
+        head++;
+
+        if (cqe.user_data == PROVIDE_TAG) {
+            fprintf(stderr, "io_uring: PROVIDE_BUFFERS failed: %s\n", strerror(-cqe.res));
+            continue;
+        }
+        if (cqe.user_data != RECV_TAG) {
+            if (cqe.res < 0) {
+                counters.dropped++;
+            }
+            releaseSlot(static_cast<int>(cqe.user_data));
+            continue;
+        }
+
+        if (!(cqe.flags & IORING_CQE_F_MORE)) {
+            recvArmed = false;
+        }
+
+        if (cqe.res < 0 || !(cqe.flags & IORING_CQE_F_BUFFER)) {
+            continue; // -ENOBUFS: re-armed below once buffers are back
+        }
+
+        uint16_t bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        char* buf = recvBuffers + bid * recvBufferSize;
+        const struct io_uring_recvmsg_out* out = reinterpret_cast<const struct io_uring_recvmsg_out*>(buf);
+        lentBuffers.push_back(bid);
+
+        InboundDatagram& d = batch[count++];
+        d.msg = reinterpret_cast<Message*>(buf + sizeof(*out) + recvTemplate.msg_namelen + recvTemplate.msg_controllen);
+        d.len = out->payloadlen < sizeof(Message) ? out->payloadlen : sizeof(Message);
+        memset(&d.addr, 0, sizeof(d.addr));
+        memcpy(&d.addr, buf + sizeof(*out), std::min<size_t>(out->namelen, sizeof(d.addr)));
+        terminateMessage(d.msg, d.len);
+    }
+    storeRelease(cqHead, head);
+
+    if (!recvArmed) {
+        armReceive();
+    }
+    counters.received += count;
+    return count;
+}
+
+bool IoUringTransport::send(const void* data, size_t len, const sockaddr_in& to) {
+    if (freeSlot < 0) {
+        counters.dropped++;
+        return false;
+    }
+    struct io_uring_sqe* sqe = nextSqe();
+    if (sqe == nullptr) {
+        counters.dropped++;
+        return false;
+    }
+
+    int index = freeSlot;
+    SendSlot& slot = slots[index];
+    freeSlot = slot.next;
+    slotsInUse++;
+
+    slot.payload.assign(static_cast<const char*>(data), len);
+    slot.to = to;
+    slot.iov.iov_base = &slot.payload[0];
+    slot.iov.iov_len = len;
+    memset(&slot.hdr, 0, sizeof(slot.hdr));
+    slot.hdr.msg_name = &slot.to;
+    slot.hdr.msg_namelen = sizeof(slot.to);
+    slot.hdr.msg_iov = &slot.iov;
+    slot.hdr.msg_iovlen = 1;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = 0;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->addr = reinterpret_cast<uint64_t>(&slot.hdr);
+    sqe->len = 1;
+    sqe->user_data = static_cast<uint64_t>(index);
+    counters.sent++;
+    return true;
+}
+
+// One io_uring_enter() submits everything prepared since the last flush
+void IoUringTransport::flush() {
+    unsigned toSubmit = localTail - submitted;
+    if (toSubmit == 0) {
+        return;
+    }
+    storeRelease(sqTail, localTail);
+    int n = enter(toSubmit, 0, 0);
+    if (n > 0) {
+        submitted += n;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#ifndef IO_URING_TRANSPORT_H
+#define IO_URING_TRANSPORT_H
+
+#include "Transport.h"
+#include <linux/io_uring.h>
+
+#define URING_SQ_ENTRIES 1024
+#define URING_CQ_ENTRIES 4096
+#define URING_RECV_BUFFERS 1024     // Provided receive buffers, a power of two
+#define URING_SEND_SLOTS 1024       // Replies in flight
+#define URING_BUFFER_GROUP 0
+
+// io_uring transport driven through the raw system calls. The socket is
+// registered as a fixed file. One multishot RECVMSG keeps receiving into a
+// registered ring of provided buffers, or into buffers handed over with
+// PROVIDE_BUFFERS where the kernel cannot register a ring. Either way, a
+// datagram costs no syscall on the way in.
+// Its request is parsed in place, and the buffer goes back to the ring on
+// the next receive(). Replies are SENDMSG entries from a fixed pool of send
+// slots, and flush() submits each loop iteration's replies with a single
+// io_uring_enter(). The ring descriptor polls readable whenever
+// completions are waiting.
+class IoUringTransport : public Transport {
+public:
+    static IoUringTransport* create(int sock, std::string& error);
+    ~IoUringTransport();
+
+    const char* name() const { return "io_uring"; }
+    int fd() const { return ringFd; }
+    short pollEvents() const;
+    void ready(short) {}
+    int receive(InboundDatagram* batch, int max);
+    bool send(const void* data, size_t len, const sockaddr_in& to);
+    void flush();
+    bool congested() const { return slotsInUse * 2 > URING_SEND_SLOTS; }
+
+private:
+    struct SendSlot {
+        struct msghdr hdr;
+        struct iovec iov;
+        sockaddr_in to;
+        std::string payload;
+        int next; // Free list link
+    };
+
+    int ringFd;
+    int sock;
+
+    // Submission and completion rings, shared with the kernel
+    void* sqRing;
+    size_t sqRingSize;
+    void* cqRing;
+    size_t cqRingSize;
+    struct io_uring_sqe* sqes;
+    size_t sqesSize;
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned sqMask;
+    unsigned sqEntries;
+    unsigned* sqArray;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned cqMask;
+    struct io_uring_cqe* cqes;
+    unsigned localTail;  // SQEs prepared
+    unsigned submitted;  // SQEs handed to the kernel
+
+    // Provided receive buffers
+    struct io_uring_buf_ring* bufRing;
+    size_t bufRingSize;
+    char* recvBuffers;
+    size_t recvBufferSize;
+    uint16_t bufTail;
+    bool ringBuffers;   // Buffer ring registered; otherwise PROVIDE_BUFFERS
+    std::vector<uint16_t> lentBuffers; // Handed out by the last receive()
+    struct msghdr recvTemplate;
+    bool recvArmed;
+
+    std::vector<SendSlot> slots;
+    int freeSlot;
+    int slotsInUse;
+
+    IoUringTransport(int sock);
+    bool setup(std::string& error);
+    struct io_uring_sqe* nextSqe();
+    void armReceive();
+    void returnBuffer(uint16_t bid);
+    void provideBuffers(uint16_t firstBid, unsigned count);
+    void returnLentBuffers();
+    void releaseSlot(int index);
+    int enter(unsigned toSubmit, unsigned minComplete, unsigned flags);
+};
+
+#endif // IO_URING_TRANSPORT_H
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "Leaderboard.h"
+#include <utility>
+
+Leaderboard::Leaderboard() : levels(1), count(0), rngState(0x9E3779B97F4A7C15ull) {
+    head.entry = Entry{0, 0};
+    head.links.assign(LEADERBOARD_MAX_LEVEL, Node::Link{nullptr, 0});
+}
+
+Leaderboard::~Leaderboard() {
+    Node* node = head.links[0].next;
+    while (node != nullptr) {
+        Node* next = node->links[0].next;
+        delete node;
+        node = next;
+    }
+}
+
+// Only the head's links point into the list, so moving swaps them
+Leaderboard::Leaderboard(Leaderboard&& other) : Leaderboard() {
+    *this = std::move(other);
+}
+
+Leaderboard& Leaderboard::operator=(Leaderboard&& other) {
+    std::swap(head.links, other.head.links);
+    std::swap(levels, other.levels);
+    std::swap(count, other.count);
+    std::swap(rngState, other.rngState);
+    return *this;
+}
+
+// Geometric level with p = 1/4, from a xorshift generator
+int Leaderboard::randomLevel() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    uint64_t bits = rngState;
+    int level = 1;
+    while ((bits & 3) == 0 && level < LEADERBOARD_MAX_LEVEL) {
+        level++;
+        bits >>= 2;
+    }
+    return level;
+}
+
+void Leaderboard::insert(const Entry& entry) {
+    Node* update[LEADERBOARD_MAX_LEVEL];
+    size_t rank[LEADERBOARD_MAX_LEVEL];
+
+    // Find the predecessor on every level and its rank
+    Node* node = &head;
+    for (int i = levels - 1; i >= 0; --i) {
+        rank[i] = (i == levels - 1) ? 0 : rank[i + 1];
+        while (node->links[i].next != nullptr && before(node->links[i].next->entry, entry)) {
+            rank[i] += node->links[i].span;
+            node = node->links[i].next;
+        }
+        update[i] = node;
+    }
+
+    int level = randomLevel();
+    if (level > levels) {
+        for (int i = levels; i < level; ++i) {
+            rank[i] = 0;
+            update[i] = &head;
+            head.links[i].span = count;
+        }
+        levels = level;
+    }
+
+    Node* added = new Node;
+    added->entry = entry;
+    added->links.resize(level);
+    for (int i = 0; i < level; ++i) {
+        added->links[i].next = update[i]->links[i].next;
+        update[i]->links[i].next = added;
+        added->links[i].span = update[i]->links[i].span - (rank[0] - rank[i]);
+        update[i]->links[i].span = (rank[0] - rank[i]) + 1;
+    }
+    for (int i = level; i < levels; ++i) {
+        update[i]->links[i].span++;
+    }
+    count++;
+}
+
+bool Leaderboard::erase(const Entry& entry) {
+    Node* update[LEADERBOARD_MAX_LEVEL];
+    Node* node = &head;
+    for (int i = levels - 1; i >= 0; --i) {
+        while (node->links[i].next != nullptr && before(node->links[i].next->entry, entry)) {
+            node = node->links[i].next;
+        }
+        update[i] = node;
+    }
+
+    Node* target = node->links[0].next;
+    if (target == nullptr || target->entry.rating != entry.rating || target->entry.player != entry.player) {
+        return false;
+    }
+
+    for (int i = 0; i < levels; ++i) {
+        if (update[i]->links[i].next == target) {
+            update[i]->links[i].span += target->links[i].span - 1;
+            update[i]->links[i].next = target->links[i].next;
+        } else {
+            update[i]->links[i].span--;
+        }
+    }
+    while (levels > 1 && head.links[levels - 1].next == nullptr) {
+        levels--;
+    }
+    delete target;
+    count--;
+    return true;
+}
+
+size_t Leaderboard::rankOf(const Entry& entry) const {
+    size_t rank = 0;
+    const Node* node = &head;
+    for (int i = levels - 1; i >= 0; --i) {
+        while (node->links[i].next != nullptr && !before(entry, node->links[i].next->entry)) {
+            rank += node->links[i].span;
+            node = node->links[i].next;
+        }
+        if (node != &head && node->entry.rating == entry.rating && node->entry.player == entry.player) {
+            return rank;
+        }
+    }
+    return 0;
+}
+
+void Leaderboard::top(size_t k, std::vector<Entry>& out) const {
+    for (const Node* node = head.links[0].next; node != nullptr && k > 0; node = node->links[0].next, --k) {
+        out.push_back(node->entry);
+    }
+}
\ No newline at end of file
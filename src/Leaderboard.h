@@ -0,0 +1,55 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define LEADERBOARD_MAX_LEVEL 32
+
+// Indexable skiplist of rated players, best rating first. Every link records
+// how many entries it skips, so insert, erase, rank-of-player and
+// entry-at-rank all run in O(log n) expected time.
+class Leaderboard {
+public:
+    struct Entry {
+        int rating;
+        uint32_t player; // Registry handle; breaks rating ties
+    };
+
+    Leaderboard();
+    ~Leaderboard();
+    Leaderboard(Leaderboard&& other);
+    Leaderboard& operator=(Leaderboard&& other);
+
+    void insert(const Entry& entry);
+    bool erase(const Entry& entry);
+    size_t rankOf(const Entry& entry) const; // 1-based, 0 when absent
+    void top(size_t k, std::vector<Entry>& out) const;
+    size_t size() const { return count; }
+
+private:
+    struct Node {
+        Entry entry;
+        struct Link {
+            Node* next;
+            size_t span; // Entries passed by following this link
+        };
+        std::vector<Link> links;
+    };
+
+    Node head;
+    int levels;
+    size_t count;
+    uint64_t rngState;
+
+    static bool before(const Entry& a, const Entry& b) {
+        return a.rating > b.rating || (a.rating == b.rating && a.player < b.player);
+    }
+    int randomLevel();
+
+    Leaderboard(const Leaderboard&);
+    Leaderboard& operator=(const Leaderboard&);
+};
+
+#endif // LEADERBOARD_H
\ No newline at end of file
@@ -0,0 +1,214 @@
+#include "LocalChannel.h"
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOCAL_WRAP 0xFFFFFFFFu
+#define LOCAL_MAX_RECORD (LOCAL_RING_BYTES / 2)
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex words must be plain 32-bit integers");
+static_assert((LOCAL_RING_BYTES & (LOCAL_RING_BYTES - 1)) == 0, "ring size must be a power of two");
+
+std::string localRegionName(unsigned short port) {
+    return "/golf-tracker-" + std::to_string(port);
+}
+
+// Shared futexes: the word lives in memory mapped by several processes
+void localWait(std::atomic<uint32_t>* word, uint32_t expected, int timeoutMs) {
+    struct timespec timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_nsec = (timeoutMs % 1000) * 1000000L;
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+}
+
+void localWake(std::atomic<uint32_t>* word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// Spinning only pays when the other side runs on another core
+int localSpinLimit() {
+    return sysconf(_SC_NPROCESSORS_ONLN) > 1 ? LOCAL_SPIN : 0;
+}
+
+static uint32_t recordSize(size_t len) {
+    return static_cast<uint32_t>((sizeof(uint32_t) + len + 7) & ~static_cast<size_t>(7));
+}
+
+void LocalRing::reset() {
+    head.store(0);
+    tail.store(0);
+    waiting.store(0);
+}
+
+// Fails when the ring lacks room; the caller decides whether to drop
+bool LocalRing::push(const void* payload, size_t len) {
+    uint32_t record = recordSize(len);
+    if (record > LOCAL_MAX_RECORD) {
+        return false;
+    }
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    uint32_t h = head.load(std::memory_order_acquire);
+    uint32_t offset = t & (LOCAL_RING_BYTES - 1);
+    uint32_t toEnd = LOCAL_RING_BYTES - offset;
+    uint32_t needed = record <= toEnd ? record : toEnd + record;
+    if (t - h > LOCAL_RING_BYTES || LOCAL_RING_BYTES - (t - h) < needed) {
+        return false;
+    }
+    if (record > toEnd) {
+        uint32_t wrap = LOCAL_WRAP;
+        memcpy(data + offset, &wrap, sizeof(wrap));
+        t += toEnd;
+        offset = 0;
+    }
+    uint32_t length = static_cast<uint32_t>(len);
+    memcpy(data + offset, &length, sizeof(length));
+    memcpy(data + offset + sizeof(length), payload, len);
+
+    tail.store(t + record);
+    if (waiting.load()) {
+        localWake(&tail);
+    }
+    return true;
+}
+
+// Copies the next record into out, truncated to cap. Returns its full
+// length, 0 when the ring is empty, or -1 when the ring is corrupt.
+int LocalRing::pop(void* out, size_t cap) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    uint32_t t = tail.load(std::memory_order_acquire);
+    if (h == t) {
+        return 0;
+    }
+    if (t - h > LOCAL_RING_BYTES || (h & 7) != 0) {
+        return -1;
+    }
+    uint32_t offset = h & (LOCAL_RING_BYTES - 1);
+    uint32_t length;
+    memcpy(&length, data + offset, sizeof(length));
+    if (length == LOCAL_WRAP) {
+        h += LOCAL_RING_BYTES - offset;
+        offset = 0;
+        if (h == t || t - h > LOCAL_RING_BYTES) {
+            return -1;
+        }
+        memcpy(&length, data, sizeof(length));
+    }
+    uint32_t record = recordSize(length);
+    if (record > LOCAL_MAX_RECORD || record > t - h || offset + record > LOCAL_RING_BYTES) {
+        return -1;
+    }
+    memcpy(out, data + offset + sizeof(length), length < cap ? length : cap);
+    head.store(h + record, std::memory_order_release);
+    return static_cast<int>(length);
+}
+
+// Sleeps until the producer publishes a record or the timeout passes
+void LocalRing::wait(int timeoutMs) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    waiting.store(1);
+    if (tail.load() == h) {
+        localWait(&tail, h, timeoutMs);
+    }
+    waiting.store(0);
+}
+
+void LocalRegion::knock() {
+    doorbell.fetch_add(1);
+    if (serverWaiting.load()) {
+        localWake(&doorbell);
+    }
+}
+
+LocalChannelClient::LocalChannelClient() : region(nullptr), slot(nullptr), spinLimit(localSpinLimit()) {}
+
+LocalChannelClient::~LocalChannelClient() {
+    detach();
+}
+
+// Maps the tracker's region and claims a free slot in it
+bool LocalChannelClient::attach(unsigned short port, std::string& error) {
+    int fd = shm_open(localRegionName(port).c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        error = "no local channel on port " + std::to_string(port) + ": " + strerror(errno);
+        return false;
+    }
+    void* mapped = mmap(nullptr, sizeof(LocalRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        error = std::string("mmap: ") + strerror(errno);
+        return false;
+    }
+    region = static_cast<LocalRegion*>(mapped);
+    if (region->magic != LOCAL_MAGIC || region->channels != LOCAL_CHANNELS) {
+        error = "local channel region has an unexpected layout";
+        detach();
+        return false;
+    }
+
+    for (int i = 0; i < LOCAL_CHANNELS; ++i) {
+        LocalSlot& candidate = region->slots[i];
+        int32_t expected = LOCAL_FREE;
+        if (candidate.owner.compare_exchange_strong(expected, LOCAL_CLAIMING)) {
+            candidate.requests.reset();
+            candidate.responses.reset();
+            candidate.generation.fetch_add(1);
+            candidate.owner.store(getpid());
+            slot = &candidate;
+            return true;
+        }
+    }
+    error = "all local channels are in use";
+    detach();
+    return false;
+}
+
+// Hands the slot back; the tracker frees it once it has stopped serving it
+void LocalChannelClient::detach() {
+    if (slot != nullptr) {
+        slot->owner.store(LOCAL_CLOSED);
+        region->knock();
+        slot = nullptr;
+    }
+    if (region != nullptr) {
+        munmap(region, sizeof(LocalRegion));
+        region = nullptr;
+    }
+}
+
+bool LocalChannelClient::send(const Message& msg) {
+    size_t len = offsetof(Message, data) + strnlen(msg.data, sizeof(msg.data)) + 1;
+    if (slot == nullptr || !slot->requests.push(&msg, len < sizeof(msg) ? len : sizeof(msg))) {
+        return false;
+    }
+    region->knock();
+    return true;
+}
+
+// Returns the length of the next reply, written NUL-terminated and truncated
+// to fit buffer, 0 on timeout, or -1 when the channel is broken
+int LocalChannelClient::receive(char* buffer, size_t size, int timeoutMs) {
+    if (slot == nullptr || size == 0) {
+        return -1;
+    }
+    int len = slot->responses.pop(buffer, size - 1);
+    for (int spin = 0; len == 0 && spin < spinLimit; ++spin) {
+        len = slot->responses.pop(buffer, size - 1);
+    }
+    if (len == 0) {
+        slot->responses.wait(timeoutMs);
+        len = slot->responses.pop(buffer, size - 1);
+    }
+    if (len > 0) {
+        if (static_cast<size_t>(len) >= size) {
+            len = static_cast<int>(size - 1);
+        }
+        buffer[len] = '\0';
+    }
+    return len;
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#ifndef LOCAL_CHANNEL_H
+#define LOCAL_CHANNEL_H
+
+#include "Utils.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#define LOCAL_CHANNELS 16                // Clients attached to one tracker at a time
+#define LOCAL_RING_BYTES (128 * 1024)    // Per direction; a power of two
+#define LOCAL_SPIN 2000                  // Polls before sleeping, on multi-core hosts
+#define LOCAL_MAGIC 0x474F4C46u
+
+// Slot owner values besides the client's pid
+#define LOCAL_FREE 0
+#define LOCAL_CLAIMING -1
+#define LOCAL_CLOSED -2
+
+// Single-producer/single-consumer byte ring in shared memory. Records are a
+// 32-bit length and the payload, padded to 8 bytes; a record that would run
+// past the end is preceded by a wrap marker. The consumer sleeps on a futex
+// on tail, and the producer only wakes it when it has announced it waits.
+struct LocalRing {
+    std::atomic<uint32_t> head;     // Consumer position
+    char headPad[60];
+    std::atomic<uint32_t> tail;     // Producer position
+    std::atomic<uint32_t> waiting;  // Consumer is asleep on tail
+    char tailPad[56];
+    char data[LOCAL_RING_BYTES];
+
+    void reset();
+    bool push(const void* payload, size_t len);
+    int pop(void* out, size_t cap);
+    void wait(int timeoutMs);
+};
+
+struct LocalSlot {
+    std::atomic<int32_t> owner;        // Client pid, or one of the states above
+    std::atomic<uint32_t> generation;  // Bumped on every claim
+    char pad[56];
+    LocalRing requests;
+    LocalRing responses;
+};
+
+// The region a tracker publishes as /golf-tracker-<port>. Clients ring the
+// doorbell after queueing a request; the tracker's channel thread sleeps on
+// it when every slot is idle.
+struct LocalRegion {
+    uint32_t magic;
+    uint32_t channels;
+    std::atomic<uint32_t> doorbell;
+    std::atomic<uint32_t> serverWaiting;
+    char pad[48];
+    LocalSlot slots[LOCAL_CHANNELS];
+
+    void knock();
+};
+
+std::string localRegionName(unsigned short port);
+void localWait(std::atomic<uint32_t>* word, uint32_t expected, int timeoutMs);
+void localWake(std::atomic<uint32_t>* word);
+int localSpinLimit();
+
+// A co-located client's end of a channel: requests go out as Message
+// records, and replies and pushed notifications come back as text
+class LocalChannelClient {
+public:
+    LocalChannelClient();
+    ~LocalChannelClient();
+
+    bool attach(unsigned short port, std::string& error);
+    void detach();
+    bool attached() const { return slot != nullptr; }
+
+    bool send(const Message& msg);
+    int receive(char* buffer, size_t size, int timeoutMs);
+
+private:
+    LocalRegion* region;
+    LocalSlot* slot;
+    int spinLimit;
+};
+
+#endif // LOCAL_CHANNEL_H
\ No newline at end of file
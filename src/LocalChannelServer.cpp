@@ -0,0 +1,180 @@
+#include "LocalChannelServer.h"
+#include "Replication.h"
+#include "Transport.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#define LOCAL_IDLE_WAIT_MS 100
+#define LOCAL_REAP_MS 1000
+
+LocalChannelServer::LocalChannelServer(TrackerServer& server, unsigned short port)
+    : server(server), name(localRegionName(port)), region(nullptr), stopping(false), served(0), dropped(0) {}
+
+LocalChannelServer::~LocalChannelServer() {
+    if (worker.joinable()) {
+        stopping = true;
+        region->knock();
+        localWake(&region->doorbell);
+        worker.join();
+    }
+    if (region != nullptr) {
+        munmap(region, sizeof(LocalRegion));
+        shm_unlink(name.c_str());
+    }
+}
+
+// Creates the region, replacing one left behind by an earlier tracker on
+// the same port, and starts serving it
+bool LocalChannelServer::start(std::string& error) {
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        error = "shm_open " + name + ": " + strerror(errno);
+        return false;
+    }
+    if (ftruncate(fd, sizeof(LocalRegion)) < 0) {
+        error = std::string("ftruncate: ") + strerror(errno);
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void* mapped = mmap(nullptr, sizeof(LocalRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        error = std::string("mmap: ") + strerror(errno);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    region = new (mapped) LocalRegion();
+    region->channels = LOCAL_CHANNELS;
+    for (int i = 0; i < LOCAL_CHANNELS; ++i) {
+        region->slots[i].owner.store(LOCAL_FREE);
+        region->slots[i].generation.store(0);
+        region->slots[i].requests.reset();
+        region->slots[i].responses.reset();
+    }
+    __atomic_store_n(&region->magic, LOCAL_MAGIC, __ATOMIC_RELEASE);
+
+    worker = std::thread(&LocalChannelServer::run, this);
+    return true;
+}
+
+void LocalChannelServer::push(const Endpoint& to, const std::string& message) {
+    {
+        std::lock_guard<std::mutex> lock(pushMutex);
+        pushed.push_back({to, message});
+    }
+    region->knock();
+}
+
+// Slot index in the low bits, claim generation above, so a token bound to
+// an earlier client of the same slot never matches the next one
+Endpoint LocalChannelServer::endpointOf(int index, uint32_t generation) {
+    Endpoint endpoint;
+    endpoint.addr = 0;
+    endpoint.port = htons(static_cast<uint16_t>(index + 1 + LOCAL_CHANNELS * (generation % 4000)));
+    return endpoint;
+}
+
+// One pass over every attached slot and the pushed messages. Returns
+// whether there was anything to do.
+bool LocalChannelServer::serve() {
+    bool busy = false;
+    Message msg;
+    for (int i = 0; i < LOCAL_CHANNELS; ++i) {
+        LocalSlot& slot = region->slots[i];
+        if (slot.owner.load(std::memory_order_acquire) <= 0) {
+            continue;
+        }
+        Endpoint from = endpointOf(i, slot.generation.load());
+        int len;
+        while ((len = slot.requests.pop(&msg, sizeof(msg))) > 0) {
+            busy = true;
+            terminateMessage(&msg, static_cast<size_t>(len));
+            std::string response = server.handleCommand(msg, from);
+            if (response.empty()) {
+                continue; // Acknowledgements have no reply
+            }
+            if (slot.responses.push(response.c_str(), response.length())) {
+                served++;
+            } else {
+                dropped++;
+            }
+        }
+        if (len < 0) {
+            fprintf(stderr, "local channel %d: corrupt request ring, detaching client\n", i);
+            slot.owner.store(LOCAL_FREE);
+        }
+    }
+
+    std::vector<Pushed> batch;
+    {
+        std::lock_guard<std::mutex> lock(pushMutex);
+        batch.swap(pushed);
+    }
+    for (const Pushed& p : batch) {
+        busy = true;
+        for (int i = 0; i < LOCAL_CHANNELS; ++i) {
+            LocalSlot& slot = region->slots[i];
+            Endpoint endpoint = endpointOf(i, slot.generation.load());
+            if (slot.owner.load() > 0 && endpoint.port == p.to.port) {
+                if (!slot.responses.push(p.message.c_str(), p.message.length())) {
+                    dropped++;
+                }
+                break;
+            }
+        }
+    }
+    return busy;
+}
+
+// Frees slots whose clients detached, and with checkPids those whose
+// process has gone away without detaching
+void LocalChannelServer::reap(bool checkPids) {
+    for (int i = 0; i < LOCAL_CHANNELS; ++i) {
+        LocalSlot& slot = region->slots[i];
+        int32_t owner = slot.owner.load();
+        if (owner == LOCAL_CLOSED || (checkPids && owner > 0 && kill(owner, 0) < 0 && errno == ESRCH)) {
+            slot.owner.store(LOCAL_FREE);
+        }
+    }
+}
+
+void LocalChannelServer::run() {
+    int spinLimit = localSpinLimit();
+    int idle = 0;
+    uint64_t lastReap = monotonicMs();
+    while (!stopping) {
+        uint64_t now = monotonicMs();
+        bool checkPids = now - lastReap >= LOCAL_REAP_MS;
+        if (checkPids) {
+            lastReap = now;
+        }
+        reap(checkPids);
+
+        if (serve()) {
+            idle = 0;
+            continue;
+        }
+        if (idle++ < spinLimit) {
+            continue;
+        }
+
+        // Announce the sleep, then look once more so a request queued in
+        // between is not missed; a client knocking after this wakes us
+        uint32_t bell = region->doorbell.load();
+        region->serverWaiting.store(1);
+        if (!serve()) {
+            localWait(&region->doorbell, bell, LOCAL_IDLE_WAIT_MS);
+        }
+        region->serverWaiting.store(0);
+        idle = 0;
+    }
+}
\ No newline at end of file
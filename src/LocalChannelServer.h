@@ -0,0 +1,50 @@
+#ifndef LOCAL_CHANNEL_SERVER_H
+#define LOCAL_CHANNEL_SERVER_H
+
+#include "TrackerServer.h"
+#include "LocalChannel.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Serves co-located clients over the shared-memory region next to the UDP
+// socket. A dedicated thread drains every attached slot's request ring,
+// runs the requests through TrackerServer and writes the replies back.
+// Local clients appear to the tracker as endpoint 0.0.0.0 with a port
+// encoding the slot and its claim generation, which no UDP sender can have.
+class LocalChannelServer {
+public:
+    LocalChannelServer(TrackerServer& server, unsigned short port);
+    ~LocalChannelServer();
+
+    bool start(std::string& error);
+
+    // Queues an unsolicited message, such as a match announcement
+    void push(const Endpoint& to, const std::string& message);
+
+    static bool isLocal(const Endpoint& endpoint) { return endpoint.addr == 0; }
+
+private:
+    struct Pushed {
+        Endpoint to;
+        std::string message;
+    };
+
+    TrackerServer& server;
+    std::string name;
+    LocalRegion* region;
+    std::thread worker;
+    std::atomic<bool> stopping;
+    std::mutex pushMutex;
+    std::vector<Pushed> pushed;
+    uint64_t served, dropped;
+
+    void run();
+    bool serve();
+    void reap(bool checkPids);
+    static Endpoint endpointOf(int index, uint32_t generation);
+};
+
+#endif // LOCAL_CHANNEL_SERVER_H
\ No newline at end of file
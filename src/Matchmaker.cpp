@@ -0,0 +1,152 @@
+#include "Matchmaker.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+Matchmaker::Matchmaker(Tracker& tracker) : tracker(tracker), nextTicket(1), waiting(0) {
+    for (int size = MATCH_MIN_TABLE; size <= MAX_PLAYERS; ++size) {
+        for (int holes = 1; holes <= MATCH_MAX_HOLES; ++holes) {
+            for (int band = 0; band < MATCH_RATING_BANDS; ++band) {
+                Bucket bucket;
+                bucket.tableSize = size;
+                bucket.holes = holes;
+                buckets.push_back(bucket);
+            }
+        }
+    }
+}
+
+size_t Matchmaker::bucketIndex(int tableSize, int holes, int rating) const {
+    int band = rating / MATCH_RATING_BAND;
+    band = band < 0 ? 0 : (band >= MATCH_RATING_BANDS ? MATCH_RATING_BANDS - 1 : band);
+    return ((tableSize - MATCH_MIN_TABLE) * MATCH_MAX_HOLES + (holes - 1)) * MATCH_RATING_BANDS + band;
+}
+
+// An entry is live while its ticket is the player's current one and the
+// player has not been pulled into a game some other way
+bool Matchmaker::isLive(const Entry& entry) {
+    PlayerInfo* player = tracker.player(entry.player);
+    return player != nullptr && player->matchTicket == entry.ticket && player->state == "free";
+}
+
+// Clears the ticket of an entry leaving the queue, unless the player has
+// queued again since
+void Matchmaker::release(const Entry& entry) {
+    PlayerInfo* player = tracker.player(entry.player);
+    if (player != nullptr && player->matchTicket == entry.ticket) {
+        player->matchTicket = 0;
+    }
+}
+
+std::string Matchmaker::enqueue(uint32_t handle, int tableSize, int holes, const Endpoint& from) {
+    PlayerInfo* player = tracker.player(handle);
+    if (player == nullptr || player->state != "free") {
+        return "FAILURE Player not available";
+    }
+    if (tableSize < MATCH_MIN_TABLE || tableSize > MAX_PLAYERS) {
+        return "FAILURE Invalid table size";
+    }
+    if (holes < 1 || holes > MATCH_MAX_HOLES) {
+        return "FAILURE Invalid number of holes";
+    }
+    if (player->matchTicket != 0) {
+        return "FAILURE Already queued";
+    }
+
+    size_t index = bucketIndex(tableSize, holes, player->rating);
+    Bucket& bucket = buckets[index];
+    if (bucket.entries.empty()) {
+        active.push_back(index);
+    }
+    player->matchTicket = nextTicket++;
+    if (nextTicket == 0) {
+        nextTicket = 1;
+    }
+    bucket.entries.push_back(Entry{handle, player->matchTicket, from});
+    waiting++;
+    return "SUCCESS " + std::to_string(index);
+}
+
+std::string Matchmaker::cancel(uint32_t handle) {
+    PlayerInfo* player = tracker.player(handle);
+    if (player == nullptr || player->matchTicket == 0) {
+        return "FAILURE Not queued";
+    }
+    player->matchTicket = 0;
+    return "SUCCESS";
+}
+
+void Matchmaker::tick(std::vector<MatchNotification>& notifications) {
+    auto start = std::chrono::steady_clock::now();
+    size_t tables = 0;
+    size_t stillActive = 0;
+
+    for (size_t a = 0; a < active.size(); ++a) {
+        Bucket& bucket = buckets[active[a]];
+        Entry seats[MAX_PLAYERS];
+        int seated = 0;
+        size_t pending = 0; // First entry not yet part of a formed table
+
+        for (size_t i = 0; i < bucket.entries.size(); ++i) {
+            if (!isLive(bucket.entries[i])) {
+                release(bucket.entries[i]);
+                continue;
+            }
+            seats[seated++] = bucket.entries[i];
+            if (seated < bucket.tableSize) {
+                continue;
+            }
+
+            // Seat a whole table; the longest-waiting player deals
+            GameInfo game;
+            game.gameId = 0;
+            game.dealer = seats[0].player;
+            game.numPlayers = seated - 1;
+            game.holes = bucket.holes;
+            game.variant = 0;
+            for (int s = 1; s < seated; ++s) {
+                game.players[s - 1] = seats[s].player;
+            }
+            std::string announce = tracker.createGame(game);
+            if (announce.compare(0, 7, "SUCCESS") == 0) {
+                notifications.push_back(MatchNotification());
+                MatchNotification& note = notifications.back();
+                note.message.swap(announce);
+                note.message.replace(0, 7, "MATCH");
+                note.numSeats = seated;
+                for (int s = 0; s < seated; ++s) {
+                    note.seats[s] = seats[s].from;
+                }
+                tables++;
+            }
+            // Seating cleared the tickets; a table that could not be created
+            // drops its entries, which must not keep the players queued
+            for (int s = 0; s < seated; ++s) {
+                release(seats[s]);
+            }
+            seated = 0;
+            pending = i + 1;
+        }
+
+        // Keep the partial table queued and compact consumed and stale
+        // entries away, so dead entries past the seated prefix do not pile up
+        bucket.entries.erase(bucket.entries.begin(), bucket.entries.begin() + pending);
+        bucket.entries.erase(std::remove_if(bucket.entries.begin(), bucket.entries.end(),
+                                            [this](const Entry& entry) { return !isLive(entry); }),
+                             bucket.entries.end());
+        if (!bucket.entries.empty()) {
+            active[stillActive++] = active[a];
+        }
+    }
+    active.resize(stillActive);
+
+    waiting = 0;
+    for (size_t index : active) {
+        waiting += buckets[index].entries.size();
+    }
+
+    if (tables > 0) {
+        long us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        printf("matchmaker: formed %zu tables in %ld us, %zu players still queued\n", tables, us, waiting);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef MATCHMAKER_H
+#define MATCHMAKER_H
+
+#include "Tracker.h"
+#include "SessionTable.h"
+#include <string>
+#include <vector>
+
+#define MATCH_TICK_MS 100
+#define MATCH_RATING_BAND 200   // Rating points per band
+#define MATCH_RATING_BANDS 16
+#define MATCH_MIN_TABLE 2
+#define MATCH_MAX_HOLES 9
+
+// A table formed by the matcher; the same message goes to every seat
+struct MatchNotification {
+    std::string message;
+    Endpoint seats[MAX_PLAYERS];
+    int numSeats;
+};
+
+// Per-bucket FIFO queues of waiting players. Buckets are keyed by desired
+// table size, hole count and rating band, and a batched matcher seats whole
+// tables from each bucket once per tick. Cancelling only clears the player's
+// ticket; stale queue entries are skipped when the matcher reaches them.
+class Matchmaker {
+public:
+    explicit Matchmaker(Tracker& tracker);
+
+    std::string enqueue(uint32_t player, int tableSize, int holes, const Endpoint& from);
+    std::string cancel(uint32_t player);
+    void tick(std::vector<MatchNotification>& notifications);
+    size_t queued() const { return waiting; }
+
+private:
+    struct Entry {
+        uint32_t player;
+        uint32_t ticket;
+        Endpoint from;
+    };
+
+    struct Bucket {
+        int tableSize;
+        int holes;
+        std::vector<Entry> entries;
+    };
+
+    Tracker& tracker;
+    std::vector<Bucket> buckets;
+    std::vector<size_t> active; // Buckets with waiting entries
+    uint32_t nextTicket;
+    size_t waiting;
+
+    size_t bucketIndex(int tableSize, int holes, int rating) const;
+    bool isLive(const Entry& entry);
+    void release(const Entry& entry);
+};
+
+#endif // MATCHMAKER_H
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include "MutationLog.h"
+
+MutationLog::MutationLog() : firstSeq(1) {}
+
+uint64_t MutationLog::append(const std::string& record) {
+    std::lock_guard<std::mutex> lock(mtx);
+    records.push_back(record);
+    return firstSeq + records.size() - 1;
+}
+
+uint64_t MutationLog::head() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return firstSeq + records.size() - 1;
+}
+
+uint64_t MutationLog::tail() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return firstSeq;
+}
+
+bool MutationLog::get(uint64_t seq, std::string& record) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (seq < firstSeq || seq >= firstSeq + records.size()) {
+        return false;
+    }
+    record = records[seq - firstSeq];
+    return true;
+}
+
+// Copies every record after seq, and the head they end at. Fails when some
+// of them were trimmed already, or seq is ahead of the log.
+bool MutationLog::since(uint64_t seq, std::vector<std::string>& out, uint64_t& headSeq) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    headSeq = firstSeq + records.size() - 1;
+    if (seq + 1 < firstSeq || seq > headSeq) {
+        return false;
+    }
+    out.insert(out.end(), records.begin() + (seq + 1 - firstSeq), records.end());
+    return true;
+}
+
+// Drops every record up to and including upTo
+void MutationLog::trim(uint64_t upTo) {
+    std::lock_guard<std::mutex> lock(mtx);
+    while (!records.empty() && firstSeq <= upTo) {
+        records.pop_front();
+        firstSeq++;
+    }
+}
\ No newline at end of file
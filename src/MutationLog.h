@@ -0,0 +1,29 @@
+#ifndef MUTATION_LOG_H
+#define MUTATION_LOG_H
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Sequenced log of tracker mutations. Each record is one line of text; the
+// first appended record has sequence number 1.
+class MutationLog {
+public:
+    MutationLog();
+
+    uint64_t append(const std::string& record);
+    uint64_t head() const;
+    uint64_t tail() const;
+    bool get(uint64_t seq, std::string& record) const;
+    bool since(uint64_t seq, std::vector<std::string>& out, uint64_t& headSeq) const;
+    void trim(uint64_t upTo);
+
+private:
+    mutable std::mutex mtx;
+    std::deque<std::string> records;
+    uint64_t firstSeq;
+};
+
+#endif // MUTATION_LOG_H
\ No newline at end of file
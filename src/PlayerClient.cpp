@@ -6,29 +6,81 @@
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <thread>
 #include <vector>
 #include <sstream>
 #include <map>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include <chrono>
 #include "Utils.h"
+#include "ClientRuntime.h"
+#include "Trace.h"
+#include "ReliableChannel.h"
 
-#define ECHOMAX 1024
+#define PROBE_MAX_PEERS 32
+#define PROBE_ROUNDS 3
+#define PROBE_WAIT_MS 200
+#define WATCH_RENEW_MS 10000 // A third of the game host's spectator lease
 
-class PlayerClient {
+// A table being spectated on a game host, rebuilt from a keyframe and the
+// deltas after it. The host's cookie is echoed to renew the watch.
+struct SpectatorView {
+    uint32_t table = 0;
+    uint32_t seq = 0;
+    bool synced = false;
+    std::string cookie;
+    uint64_t renewAtMs = 0; // Zero until the first renewal is scheduled
+    std::string hole, turn, discard;
+    std::vector<std::string> names;
+    std::vector<std::vector<std::string>> cards;
+};
+
+// Our seat at a game played on a game host, from the START_GAME reply or
+// START invitation that dealt us in
+struct HostedSeat {
+    uint32_t table = 0;
+    struct sockaddr_in host;
+    std::string secret; // Shown to the host to join and move
+};
+
+// The REPL is a thin front-end over a ClientRuntime session. The REPL
+// thread hands one request at a time to the runtime's loop with call(),
+// which sends it with the runtime's resends, rate-limit backoff and
+// redirects, and waits for the final reply. Pushes from the tracker and
+// from a game host are handled on the loop between requests.
+class PlayerClient : public ClientSession {
 private:
-    int trackerSock;
-    struct sockaddr_in trackerServAddr;
     std::string playerName;
     std::string playerIP;
     int tPort;
     int pPort;
     bool isRegistered = false;
-    std::vector<int> peerSockets;
-    std::mutex mtx;
-    std::condition_variable cv;
-    std::string lastResponse;
+    int probeSock = -1; // Bound to the peer port: probes and table traffic
+    std::map<std::string, ReliableChannel*> peers; // Players at our table, guarded by peerMtx
+    std::mutex peerMtx;
+    std::mutex mtx;              // Guards hostAddr, spectating and seat, which the loop also uses
+    struct sockaddr_in hostAddr; // Game host of the spectated table
+    SpectatorView spectating;    // Guarded by mtx
+    HostedSeat seat;             // Guarded by mtx
+    std::map<std::string, std::string> lobby; // Player -> "ip t_port p_port state", as of lobbyVersion
+    uint64_t lobbyVersion = 0;
+    bool lobbyResync = false;
+    uint32_t lastInvitation = 0; // Game of the last START notification, to spot resends
+
+    // The request handed from the REPL thread to the loop, guarded by callMtx
+    std::mutex callMtx;
+    std::condition_variable callCv;
+    bool callQueued = false;  // Not yet taken by the loop
+    bool callWaiting = false; // The REPL thread waits for the reply
+    CommandType callCmd = CMD_REGISTER;
+    std::string callData;
+    bool callToHost = false;
+    struct sockaddr_in callTo;
+    std::string callReply;
+    uint32_t renewing = 0; // Table whose watch the loop is renewing, while it waits for the reply
 
     void setupNonBlocking(int sock) {
         int flags = fcntl(sock, F_GETFL, 0);
@@ -37,120 +89,473 @@ private:
         if (fcntl(sock, F_SETFL, flags) == -1) DieWithError("fcntl F_SETFL O_NONBLOCK");
     }
 
-    void handleTrackerCommunication() {
-        char buffer[ECHOMAX];
-        struct sockaddr_in fromAddr;
-        unsigned int fromSize = sizeof(fromAddr);
-        int recvMsgSize;
+    // Runs on the REPL thread. Returns the final reply, or an empty string
+    // when every resend went unanswered or the client is stopping.
+    std::string call(CommandType cmd, const std::string& data, const sockaddr_in* to) {
+        std::unique_lock<std::mutex> lock(callMtx);
+        callCmd = cmd;
+        callData = data;
+        callToHost = to != nullptr;
+        if (to != nullptr) {
+            callTo = *to;
+        }
+        callQueued = true;
+        callWaiting = true;
+        lock.unlock();
+        runtime().notify(this);
+        lock.lock();
+        callCv.wait(lock, [this]() { return !callWaiting; });
+        return callReply;
+    }
 
-        while (true) {
-            if ((recvMsgSize = recvfrom(trackerSock, buffer, ECHOMAX, 0, 
-                (struct sockaddr *) &fromAddr, &fromSize)) > 0) {
-                buffer[recvMsgSize] = '\0';
-                std::cout << "Received from tracker: " << buffer << std::endl;
-                
-                std::lock_guard<std::mutex> lock(mtx);
-                lastResponse = buffer;
-                cv.notify_one();
+    void completeCall(const char* reply) {
+        std::lock_guard<std::mutex> lock(callMtx);
+        if (callWaiting) {
+            callQueued = false;
+            callWaiting = false;
+            callReply = reply;
+            callCv.notify_one();
+        }
+    }
+
+    void showSpectatorView() {
+        std::cout << "Table " << spectating.table << ", hole " << spectating.hole << ", " << spectating.turn
+                  << " to play, discard " << spectating.discard << std::endl;
+        for (size_t p = 0; p < spectating.names.size(); ++p) {
+            std::cout << "  " << spectating.names[p] << ":";
+            for (const std::string& card : spectating.cards[p]) {
+                std::cout << " " << card;
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            std::cout << std::endl;
         }
     }
 
-    void handlePeerCommunication(int sock, const std::string& peerName) {
-        char buffer[ECHOMAX];
-        struct sockaddr_in fromAddr;
-        unsigned int fromSize = sizeof(fromAddr);
-        int recvMsgSize;
+    // "KEY <id> <seq> <hole> <turn> <discard> | <name> <card>... | ..." and
+    // "DELTA <id> <seq> <hole> <turn> <discard> <seat>.<slot>=<card>...". A
+    // gap in the sequence asks the host for its keyframe again.
+    void handleSpectatorUpdate(const char* buffer) {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::istringstream iss(buffer);
+        std::string kind;
+        uint32_t table, seq;
+        iss >> kind >> table >> seq;
+        if (table != spectating.table) {
+            return;
+        }
+        if (kind == "KEY") {
+            if (spectating.synced && seq == spectating.seq) {
+                return; // A renewal's keyframe of what we already show
+            }
+            spectating.names.clear();
+            spectating.cards.clear();
+            iss >> spectating.hole >> spectating.turn >> spectating.discard;
+            std::string token;
+            while (iss >> token) {
+                if (token == "|") {
+                    spectating.names.emplace_back();
+                    spectating.cards.emplace_back();
+                } else if (!spectating.names.empty() && spectating.names.back().empty()) {
+                    spectating.names.back() = token;
+                } else if (!spectating.cards.empty()) {
+                    spectating.cards.back().push_back(token);
+                }
+            }
+            spectating.synced = true;
+        } else {
+            if (spectating.synced && seq <= spectating.seq) {
+                return; // Duplicate or late
+            }
+            if (!spectating.synced || seq != spectating.seq + 1) {
+                if (spectating.synced) {
+                    std::cout << "Missed a table update, resynchronizing." << std::endl;
+                    spectating.synced = false;
+                    spectating.renewAtMs = 1; // Renewing the watch sends a keyframe
+                }
+                return;
+            }
+            iss >> spectating.hole >> spectating.turn >> spectating.discard;
+            std::string change;
+            while (iss >> change) {
+                size_t p = 0, i = 0;
+                char dot = 0, eq = 0;
+                std::istringstream cs(change);
+                if (cs >> p >> dot >> i >> eq && p < spectating.cards.size() && i < spectating.cards[p].size()) {
+                    cs >> spectating.cards[p][i];
+                }
+            }
+        }
+        spectating.seq = seq;
+        showSpectatorView();
+    }
 
-        while (true) {
-            if ((recvMsgSize = recvfrom(sock, buffer, ECHOMAX, 0, 
-                (struct sockaddr *) &fromAddr, &fromSize)) > 0) {
-                buffer[recvMsgSize] = '\0';
-                std::cout << "Received from " << peerName << ": " << buffer << std::endl;
-                // Handle peer messages here
+    // Runs on the loop, for anything that is not a reply to our request
+    void handlePush(const char* buffer) {
+        // Unsolicited pushes from a game host we are spectating
+        if (strncmp(buffer, "KEY ", 4) == 0 || strncmp(buffer, "DELTA ", 6) == 0) {
+            handleSpectatorUpdate(buffer);
+            return;
+        }
+        // Pushes from the game host of our own table
+        if (strncmp(buffer, "TABLE ", 6) == 0) {
+            std::cout << "Table " << buffer + 6 << std::endl;
+            return;
+        }
+        if (strncmp(buffer, "RESULT ", 7) == 0) {
+            std::cout << "Game over, final scores: " << buffer + 7 << std::endl;
+            uint32_t table = strtoul(buffer + 7, nullptr, 10);
+            std::lock_guard<std::mutex> lock(mtx);
+            if (table == spectating.table) {
+                spectating = SpectatorView();
+            }
+            if (table == seat.table) {
+                seat = HostedSeat();
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            return;
+        }
+
+        std::cout << "Received from tracker: " << buffer << std::endl;
+
+        // Unsolicited push: a dealer started a game with us in it. The
+        // tracker resends it until acknowledged, so every copy is acknowledged.
+        if (strncmp(buffer, "START ", 6) == 0) {
+            uint32_t gameId = strtoul(buffer + 6, nullptr, 10);
+            post(CMD_START_ACK, std::to_string(gameId) + " " + playerRef(playerName));
+            if (gameId != lastInvitation) {
+                lastInvitation = gameId;
+                std::cout << "Invited into game " << gameId << "!" << std::endl;
+                setupPeerConnections(buffer);
+                noteHostedSeat(gameId, buffer);
+            }
+            return;
+        }
+
+        // Unsolicited push: the matchmaker seated us at a table
+        if (strncmp(buffer, "MATCH ", 6) == 0) {
+            std::cout << "Matched into a game!" << std::endl;
+            setupPeerConnections(buffer);
         }
     }
 
-    bool waitForResponse(const std::string &expectedPrefix, int timeoutSeconds = 5)
-    {
+    static uint64_t clockUs() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Runs on the loop at the end of every resume. While a table is
+    // watched, its lease is renewed every WATCH_RENEW_MS, or at once for a
+    // resync or a new cookie; otherwise the session just waits for a push.
+    void waitForNext() {
         std::unique_lock<std::mutex> lock(mtx);
-        bool received = cv.wait_for(lock, std::chrono::seconds(timeoutSeconds),
-            [this, &expectedPrefix]() {
-                return !lastResponse.empty() && lastResponse.substr(0, expectedPrefix.length()) == expectedPrefix;
-            });
+        if (spectating.table == 0 || spectating.cookie.empty()) {
+            lock.unlock();
+            waitForPush();
+            return;
+        }
+        uint64_t now = clockUs() / 1000;
+        if (spectating.renewAtMs == 0) {
+            spectating.renewAtMs = now + WATCH_RENEW_MS;
+        }
+        if (now < spectating.renewAtMs) {
+            uint32_t wait = static_cast<uint32_t>(spectating.renewAtMs - now);
+            lock.unlock();
+            sleep(wait);
+            return;
+        }
+        spectating.renewAtMs = now + WATCH_RENEW_MS;
+        renewing = spectating.table;
+        struct sockaddr_in host = hostAddr;
+        std::string data = std::to_string(spectating.table) + " " + spectating.cookie;
+        lock.unlock();
+        request(host, CMD_TABLE_WATCH, data);
+    }
 
-        if (received)
-        {
-            const char *buffer = lastResponse.c_str();
-            if (strncmp(buffer, "SUCCESS REGISTER", 16) == 0)
-            {
-                std::cout << "Successfully registered!" << std::endl;
-                isRegistered = true;
+    // "SUCCESS TABLE_WATCH <id> <seq>" keeps watching, a new cookie is used
+    // at once, and a failure ends the watch. An unanswered renewal is tried
+    // again when the next one is due.
+    void handleRenewal(const char* reply) {
+        std::lock_guard<std::mutex> lock(mtx);
+        uint32_t table = renewing;
+        renewing = 0;
+        if (table != spectating.table) {
+            return; // The REPL moved on meanwhile
+        }
+        if (strncmp(reply, "SUCCESS TABLE_WATCH ", 20) == 0) {
+            std::istringstream iss(reply + 20);
+            uint32_t id;
+            std::string word, cookie;
+            if (iss >> id >> word >> cookie && word == "COOKIE") {
+                spectating.cookie = cookie;
+                spectating.renewAtMs = 1;
             }
-            else if (strncmp(buffer, "SUCCESS DEREGISTER", 18) == 0)
+        } else if (strncmp(reply, "FAILURE", 7) == 0) {
+            std::cout << "Stopped watching table " << table << ": " << reply + 8 << std::endl;
+            spectating = SpectatorView();
+        }
+    }
+
+    // The peer port answers "PING <x>" with "PONG <x>" so that other players
+    // can measure their round trip to us, and carries the reliable channels
+    // to the players at our table
+    void handlePeerTraffic() {
+        char buffer[RELIABLE_MTU + 1];
+        struct sockaddr_in fromAddr;
+        socklen_t fromSize;
+        int recvMsgSize;
+        std::vector<std::string> delivered;
+
+        while (true) {
+            // Wake for datagrams, and when a channel has a message to resend
+            int timeoutMs = 100;
             {
-                std::cout << "Successfully deregistered!" << std::endl;
-                isRegistered = false;
+                std::lock_guard<std::mutex> lock(peerMtx);
+                uint64_t now = clockUs();
+                for (const auto& peer : peers) {
+                    uint64_t next = peer.second->nextTimerUs();
+                    timeoutMs = next <= now ? 0 : std::min<int>(timeoutMs, (next - now + 999) / 1000);
+                }
             }
-            else if (strncmp(buffer, "SUCCESS START_GAME", 18) == 0)
-            {
-                std::cout << "Game started successfully!" << std::endl;
-                std::string gameInfo = buffer + 19;
-                std::cout << "Game info: " << gameInfo << std::endl;
-                setupPeerConnections(buffer + 19); // Skip "SUCCESS START_GAME "
+            struct pollfd pfd;
+            pfd.fd = probeSock;
+            pfd.events = POLLIN;
+            if (poll(&pfd, 1, timeoutMs) > 0) {
+                fromSize = sizeof(fromAddr);
+                recvMsgSize = recvfrom(probeSock, buffer, RELIABLE_MTU, 0, (struct sockaddr *) &fromAddr, &fromSize);
+                if (recvMsgSize > 0 && static_cast<uint8_t>(buffer[0]) == RELIABLE_MAGIC) {
+                    std::lock_guard<std::mutex> lock(peerMtx);
+                    for (const auto& peer : peers) {
+                        const sockaddr_in& addr = peer.second->peer();
+                        if (addr.sin_addr.s_addr == fromAddr.sin_addr.s_addr && addr.sin_port == fromAddr.sin_port) {
+                            peer.second->onDatagram(buffer, recvMsgSize, clockUs(), delivered);
+                            for (const std::string& message : delivered) {
+                                std::cout << "Received from " << peer.first << ": " << message << std::endl;
+                            }
+                            delivered.clear();
+                            break;
+                        }
+                    }
+                } else if (recvMsgSize > 0) {
+                    buffer[recvMsgSize] = '\0';
+                    if (strncmp(buffer, "PING ", 5) == 0) {
+                        buffer[1] = 'O';
+                        sendto(probeSock, buffer, recvMsgSize, 0, (struct sockaddr *) &fromAddr, fromSize);
+                    } else {
+                        std::cout << "Received from peer: " << buffer << std::endl;
+                    }
+                }
             }
-            else if (strncmp(buffer, "SUCCESS QUERY_PLAYERS", 21) == 0)
-            {
-                std::cout << "Player query successful. Players:" << std::endl;
-                std::cout << buffer + 22 << std::endl; // Skip "SUCCESS QUERY_PLAYERS "
+
+            std::lock_guard<std::mutex> lock(peerMtx);
+            uint64_t now = clockUs();
+            for (const auto& peer : peers) {
+                peer.second->poll(now);
             }
-            else if (strncmp(buffer, "SUCCESS QUERY_GAMES", 19) == 0)
-            {
-                std::cout << "Game query successful. Games:" << std::endl;
-                std::cout << buffer + 20 << std::endl; // Skip "SUCCESS QUERY_GAMES "
+        }
+    }
+
+    void startProbeResponder() {
+        int sock = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (sock < 0) DieWithError("socket() failed");
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(pPort);
+        if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+            std::cout << "Peer port " << pPort << " is in use; other players cannot reach us." << std::endl;
+            close(sock);
+            return;
+        }
+        probeSock = sock;
+        std::thread peerThread(&PlayerClient::handlePeerTraffic, this);
+        peerThread.detach();
+    }
+
+    // Refers to ourselves by session token so the tracker need not match names
+    std::string playerRef(const std::string& name) const {
+        if (sessionToken() != 0 && name == playerName) {
+            return "@" + std::to_string(sessionToken());
+        }
+        return name;
+    }
+
+    // "<version> <count> + <name> <ip> <t_port> <p_port> <state> | - <name> ..."
+    // or "<version> RESYNC"
+    void applyLobbyChanges(const char* changes) {
+        std::istringstream iss(changes);
+        uint64_t version;
+        std::string count;
+        iss >> version >> count;
+        if (count == "RESYNC") {
+            std::cout << "Lobby changed too much since the last update, fetching it again." << std::endl;
+            lobby.clear();
+            lobbyVersion = 0;
+            lobbyResync = true;
+            return;
+        }
+        std::string op, name;
+        int changed = 0;
+        while (iss >> op >> name) {
+            if (op == "+") {
+                std::string ip, tPort, pPort, state;
+                iss >> ip >> tPort >> pPort >> state;
+                lobby[name] = ip + " " + tPort + " " + pPort + " " + state;
+            } else {
+                lobby.erase(name);
             }
-            else if (strncmp(buffer, "FAILURE", 7) == 0)
-            {
-                std::cout << "Operation failed: " << buffer + 8 << std::endl;
+            changed++;
+        }
+        lobbyVersion = version;
+        std::cout << "Lobby at version " << version << ": " << lobby.size() << " players, " << changed
+                  << " changed" << std::endl;
+        for (const auto& entry : lobby) {
+            std::cout << "  " << entry.first << " " << entry.second << std::endl;
+        }
+    }
+
+    // Reports the final reply to a request; the runtime already kept the
+    // session token from REGISTER
+    void handleResponse(const char* buffer)
+    {
+        if (strncmp(buffer, "SUCCESS REGISTER", 16) == 0)
+        {
+            std::cout << "Successfully registered!" << std::endl;
+            isRegistered = true;
+        }
+        else if (strncmp(buffer, "SUCCESS DEREGISTER", 18) == 0)
+        {
+            std::cout << "Successfully deregistered!" << std::endl;
+            isRegistered = false;
+        }
+        else if (strncmp(buffer, "SUCCESS START_GAME", 18) == 0)
+        {
+            std::cout << "Game started successfully!" << std::endl;
+            std::string gameInfo = buffer + 19;
+            std::cout << "Game info: " << gameInfo << std::endl;
+            setupPeerConnections(buffer + 8); // Skip "SUCCESS "
+            noteHostedSeat(strtoul(buffer + 19, nullptr, 10), buffer);
+        }
+        else if (strncmp(buffer, "SUCCESS QUERY_PLAYERS_SINCE", 27) == 0)
+        {
+            applyLobbyChanges(buffer + 28);
+        }
+        else if (strncmp(buffer, "SUCCESS QUERY_PLAYERS", 21) == 0)
+        {
+            std::cout << "Player query successful. Players:" << std::endl;
+            std::cout << buffer + 22 << std::endl; // Skip "SUCCESS QUERY_PLAYERS "
+        }
+        else if (strncmp(buffer, "SUCCESS QUERY_GAMES", 19) == 0)
+        {
+            std::cout << "Game query successful. Games:" << std::endl;
+            std::cout << buffer + 20 << std::endl; // Skip "SUCCESS QUERY_GAMES "
+        }
+        else if (strncmp(buffer, "SUCCESS MATCH_ENQUEUE", 21) == 0)
+        {
+            std::cout << "Queued for matchmaking." << std::endl;
+        }
+        else if (strncmp(buffer, "SUCCESS MATCH_CANCEL", 20) == 0)
+        {
+            std::cout << "Left the matchmaking queue." << std::endl;
+        }
+        else if (strncmp(buffer, "SUCCESS TABLE_JOIN", 18) == 0)
+        {
+            std::cout << "Seated at table " << buffer + 19 << "." << std::endl; // "<table> <seat>"
+        }
+        else if (strncmp(buffer, "SUCCESS TABLE_MOVE", 18) == 0)
+        {
+            std::cout << "Move played." << std::endl;
+        }
+        else if (strncmp(buffer, "SUCCESS TABLE_WATCH", 19) == 0)
+        {
+            // The host first answers with a cookie, to be sent back to subscribe
+            std::istringstream iss(buffer + 19);
+            uint32_t table;
+            std::string word, cookie;
+            std::lock_guard<std::mutex> lock(mtx);
+            if (iss >> table >> word >> cookie && word == "COOKIE") {
+                if (table == spectating.table) {
+                    spectating.cookie = cookie;
+                }
+            } else {
+                std::cout << "Watching table " << spectating.table << "." << std::endl;
             }
-            lastResponse.clear();
         }
-        else
+        else if (strncmp(buffer, "SUCCESS TABLE_UNWATCH", 21) == 0)
         {
-            std::cout << "No response received or unexpected response." << std::endl;
+            std::cout << "Stopped watching." << std::endl;
+        }
+        else if (strncmp(buffer, "SUCCESS REPORT_RTT", 18) == 0)
+        {
+            std::cout << "Reported round trips to " << buffer + 19 << " players." << std::endl;
+        }
+        else if (strncmp(buffer, "SUCCESS MULTI", 13) == 0)
+        {
+            std::cout << "Batch completed. Results:" << std::endl;
+            std::cout << buffer + 14 << std::endl; // Skip "SUCCESS MULTI "
+        }
+        else if (strncmp(buffer, "FAILURE", 7) == 0)
+        {
+            std::cout << "Operation failed: " << buffer + 8 << std::endl;
+        }
+        else if (strncmp(buffer, "REDIRECT", 8) == 0)
+        {
+            std::cout << "Redirected too many times: " << buffer << std::endl;
         }
-
-        return received;
     }
 
 public:
-    PlayerClient(const char *servIP, unsigned short servPort) : isRegistered(false) {
-        if ((trackerSock = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0)
-            DieWithError("socket() failed");
-
-        memset(&trackerServAddr, 0, sizeof(trackerServAddr));
-        trackerServAddr.sin_family = AF_INET;
-        trackerServAddr.sin_addr.s_addr = inet_addr(servIP);
-        trackerServAddr.sin_port = htons(servPort);
-
-        setupNonBlocking(trackerSock);
+    void resume(SessionEvent event, const char* text) {
+        switch (event) {
+        case SESSION_INPUT: {
+            std::unique_lock<std::mutex> lock(callMtx);
+            if (!callQueued) {
+                break;
+            }
+            callQueued = false;
+            CommandType cmd = callCmd;
+            std::string data = callData;
+            bool toHost = callToHost;
+            struct sockaddr_in to = callTo;
+            lock.unlock();
+            if (toHost) {
+                request(to, cmd, data);
+            } else {
+                request(cmd, data);
+            }
+            return;
+        }
+        case SESSION_REPLY:
+        case SESSION_TIMEOUT:
+            if (renewing != 0) {
+                handleRenewal(text != nullptr ? text : "");
+            } else {
+                completeCall(text != nullptr ? text : "");
+            }
+            break;
+        case SESSION_PUSH:
+            handlePush(text);
+            break;
+        case SESSION_STOP:
+            completeCall("");
+            finish();
+            return;
+        default:
+            break;
+        }
+        waitForNext();
     }
 
-    void sendMessage(CommandType cmd, const std::string &data)
+    // Hands the request to the loop and waits for its final reply
+    void sendMessage(CommandType cmd, const std::string &data, const sockaddr_in* to = nullptr)
     {
-        Message msg;
-        msg.cmd = cmd;
-        strncpy(msg.data, data.c_str(), sizeof(msg.data) - 1);
-        msg.data[sizeof(msg.data) - 1] = '\0';
-
-        if (sendto(trackerSock, &msg, sizeof(msg), 0, (struct sockaddr *)&trackerServAddr, sizeof(trackerServAddr)) != sizeof(msg))
-            DieWithError("sendto() sent a different number of bytes than expected");
-
+        TRACE_SAMPLE();
+        TRACE_SCOPE_DETAIL("round trip", cmdToString(cmd));
         std::cout << cmdToString(cmd) << " request sent. Waiting for response..." << std::endl;
-        waitForResponse("SUCCESS " + std::string(cmdToString(cmd)));
+        std::string reply = call(cmd, data, to);
+        if (reply.empty()) {
+            std::cout << "No response received or unexpected response." << std::endl;
+            return;
+        }
+        handleResponse(reply.c_str());
     }
 
     void registerPlayer(const std::string& name, const std::string& ip, int trackerPort, int peerPort) {
@@ -166,88 +571,348 @@ public:
 
         std::string data = name + " " + ip + " " + std::to_string(trackerPort) + " " + std::to_string(peerPort);
         sendMessage(CMD_REGISTER, data);
+        if (isRegistered && probeSock < 0) {
+            startProbeResponder();
+        }
     }
 
-    void deregisterPlayer() {
+    // Pings the peer port of up to PROBE_MAX_PEERS other players a few times
+    // and reports the best round trip to each, so the tracker can seat us
+    // next to players we reach quickly
+    void probePeers() {
         if (!isRegistered) {
-            std::cout << "Not registered. Please register first." << std::endl;
+            std::cout << "You must be registered to probe other players." << std::endl;
             return;
         }
+        refreshLobby();
 
-        Message msg;
-        msg.cmd = CMD_DEREGISTER;
-        snprintf(msg.data, sizeof(msg.data), "%s", playerName.c_str());
+        std::vector<std::string> names;
+        std::vector<struct sockaddr_in> addrs;
+        for (const auto& entry : lobby) {
+            std::istringstream iss(entry.second);
+            std::string ip;
+            int t, p;
+            if (entry.first == playerName || !(iss >> ip >> t >> p)) {
+                continue;
+            }
+            struct sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = inet_addr(ip.c_str());
+            addr.sin_port = htons(p);
+            names.push_back(entry.first);
+            addrs.push_back(addr);
+            if (names.size() == PROBE_MAX_PEERS) {
+                break;
+            }
+        }
+        if (names.empty()) {
+            std::cout << "No other players to probe." << std::endl;
+            return;
+        }
 
-        if (sendto(trackerSock, &msg, sizeof(msg), 0, (struct sockaddr *)&trackerServAddr, sizeof(trackerServAddr)) != sizeof(msg))
-            DieWithError("sendto() sent a different number of bytes than expected");
+        int sock = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (sock < 0) DieWithError("socket() failed");
+        setupNonBlocking(sock);
 
-        std::cout << "De-registration request sent. Waiting for response..." << std::endl;
+        typedef std::chrono::steady_clock Clock;
+        std::vector<Clock::time_point> sentAt(names.size());
+        std::vector<long> best(names.size(), -1);
+        for (int round = 0; round < PROBE_ROUNDS; ++round) {
+            for (size_t i = 0; i < names.size(); ++i) {
+                std::string ping = "PING " + std::to_string(i) + " " + std::to_string(round);
+                sentAt[i] = Clock::now();
+                sendto(sock, ping.data(), ping.size(), 0, (struct sockaddr *) &addrs[i], sizeof(addrs[i]));
+            }
+            Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(PROBE_WAIT_MS);
+            for (Clock::time_point now = Clock::now(); now < deadline; now = Clock::now()) {
+                struct pollfd pfd;
+                pfd.fd = sock;
+                pfd.events = POLLIN;
+                int waitMs = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+                if (poll(&pfd, 1, waitMs + 1) <= 0) {
+                    continue;
+                }
+                char buffer[64];
+                int len = recv(sock, buffer, sizeof(buffer) - 1, 0);
+                if (len <= 0) {
+                    continue;
+                }
+                buffer[len] = '\0';
+                unsigned long idx;
+                int r;
+                if (sscanf(buffer, "PONG %lu %d", &idx, &r) != 2 || r != round || idx >= names.size()) {
+                    continue; // A late reply from an earlier round
+                }
+                long us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - sentAt[idx]).count();
+                if (best[idx] < 0 || us < best[idx]) {
+                    best[idx] = std::max(us, 1L);
+                }
+            }
+        }
+        close(sock);
 
-        waitForResponse("SUCCESS DEREGISTER");
+        // Reports go out in as many requests as it takes to fit the samples
+        std::string head = playerRef(playerName);
+        std::string data = head;
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (best[i] < 0) {
+                std::cout << "  " << names[i] << ": no reply" << std::endl;
+                continue;
+            }
+            std::cout << "  " << names[i] << ": " << best[i] / 1000.0 << " ms" << std::endl;
+            std::string sample = " " + names[i] + " " + std::to_string(best[i]);
+            if (data.size() + sample.size() >= sizeof(Message::data)) {
+                sendMessage(CMD_REPORT_RTT, data);
+                data = head;
+            }
+            data += sample;
+        }
+        if (data.size() > head.size()) {
+            sendMessage(CMD_REPORT_RTT, data);
+        }
     }
 
-    void startGame(const std::string& dealer, int n, int holes) {
+    void deregisterPlayer() {
+        if (!isRegistered) {
+            std::cout << "Not registered. Please register first." << std::endl;
+            return;
+        }
+
+        sendMessage(CMD_DEREGISTER, playerRef(playerName));
+    }
+
+    void startGame(const std::string& dealer, int n, int holes, const std::string& options) {
         if (!isRegistered) {
             std::cout << "You must be registered to start a game." << std::endl;
             return;
         }
-        std::string data = dealer + " " + std::to_string(n) + " " + std::to_string(holes);
+        std::string data = playerRef(dealer) + " " + std::to_string(n) + " " + std::to_string(holes);
+        if (!options.empty()) {
+            data += " " + options;
+        }
         sendMessage(CMD_START_GAME, data);
     }
 
-    void endGame(int gameId, const std::string& dealer) {
+    void endGame(uint32_t gameId, const std::string& dealer, const std::vector<int>& scores) {
         if (!isRegistered) {
             std::cout << "You must be registered to end a game." << std::endl;
             return;
         }
-        std::string data = std::to_string(gameId) + " " + dealer;
+        std::string data = std::to_string(gameId) + " " + playerRef(dealer);
+        for (int score : scores) {
+            data += " " + std::to_string(score);
+        }
         sendMessage(CMD_END_GAME, data);
     }
 
+    // Sends several commands in one datagram; ops are "<COMMAND> <args>" strings
+    void sendBatch(const std::vector<std::string>& ops) {
+        std::string data;
+        for (const auto& op : ops) {
+            data += op + "\n";
+        }
+        if (data.size() >= sizeof(Message::data)) {
+            std::cout << "Batch too large for a single request." << std::endl;
+            return;
+        }
+        sendMessage(CMD_MULTI, data);
+    }
+
+    void enqueueForMatch(int tableSize, int holes) {
+        if (!isRegistered) {
+            std::cout << "You must be registered to queue for a game." << std::endl;
+            return;
+        }
+        sendMessage(CMD_MATCH_ENQUEUE, playerRef(playerName) + " " + std::to_string(tableSize) + " " + std::to_string(holes));
+    }
+
+    void cancelMatch() {
+        if (!isRegistered) {
+            std::cout << "Not registered. Please register first." << std::endl;
+            return;
+        }
+        sendMessage(CMD_MATCH_CANCEL, playerRef(playerName));
+    }
+
+    // Brings the local copy of the player listing up to date with only the
+    // changes since the last refresh
+    void refreshLobby() {
+        sendMessage(CMD_QUERY_PLAYERS_SINCE, std::to_string(lobbyVersion));
+        if (lobbyResync) {
+            lobbyResync = false;
+            sendMessage(CMD_QUERY_PLAYERS_SINCE, "0");
+        }
+    }
+
+    void watchTable(const char* hostIP, int hostPort, uint32_t table) {
+        struct sockaddr_in oldHost, newHost;
+        uint32_t oldTable;
+        std::string oldCookie;
+        memset(&newHost, 0, sizeof(newHost));
+        newHost.sin_family = AF_INET;
+        newHost.sin_addr.s_addr = inet_addr(hostIP);
+        newHost.sin_port = htons(hostPort);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            oldHost = hostAddr;
+            oldTable = spectating.table;
+            oldCookie = spectating.cookie;
+            hostAddr = newHost;
+            spectating = SpectatorView();
+            spectating.table = table;
+        }
+        if (oldTable != 0 && oldTable != table) {
+            sendMessage(CMD_TABLE_UNWATCH, std::to_string(oldTable) + " " + oldCookie, &oldHost);
+        }
+        sendMessage(CMD_TABLE_WATCH, std::to_string(table), &newHost);
+        std::string cookie;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (spectating.table == table) {
+                cookie = spectating.cookie;
+            }
+        }
+        if (!cookie.empty()) {
+            sendMessage(CMD_TABLE_WATCH, std::to_string(table) + " " + cookie, &newHost);
+        }
+    }
+
+    void unwatchTable() {
+        uint32_t table;
+        std::string cookie;
+        struct sockaddr_in host;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            table = spectating.table;
+            cookie = spectating.cookie;
+            host = hostAddr;
+            spectating = SpectatorView();
+        }
+        if (table == 0) {
+            std::cout << "Not watching a table." << std::endl;
+            return;
+        }
+        sendMessage(CMD_TABLE_UNWATCH, std::to_string(table) + " " + cookie, &host);
+    }
+
+    // A hosted game's announcement ends in "HOST <ip> <port> <secret>"
+    void noteHostedSeat(uint32_t gameId, const char* gameInfo) {
+        const char* hosted = strstr(gameInfo, " HOST ");
+        if (hosted == nullptr) {
+            return;
+        }
+        std::istringstream iss(hosted + 6);
+        std::string ip, secret;
+        int port = 0;
+        if (!(iss >> ip >> port >> secret)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        seat.table = gameId;
+        memset(&seat.host, 0, sizeof(seat.host));
+        seat.host.sin_family = AF_INET;
+        seat.host.sin_addr.s_addr = inet_addr(ip.c_str());
+        seat.host.sin_port = htons(port);
+        seat.secret = secret;
+        std::cout << "The game is played on the game host at " << ip << ":" << port << "; type 'join' to take your seat."
+                  << std::endl;
+    }
+
+    void joinTable() {
+        HostedSeat mine;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            mine = seat;
+        }
+        if (mine.table == 0) {
+            std::cout << "Not dealt into a hosted game." << std::endl;
+            return;
+        }
+        sendMessage(CMD_TABLE_JOIN, std::to_string(mine.table) + " " + playerName + " " + mine.secret, &mine.host);
+    }
+
+    void playMove(const std::string& source, const std::string& action, int slot) {
+        HostedSeat mine;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            mine = seat;
+        }
+        if (mine.table == 0) {
+            std::cout << "Not dealt into a hosted game." << std::endl;
+            return;
+        }
+        sendMessage(CMD_TABLE_MOVE, std::to_string(mine.table) + " " + mine.secret + " " + source + " " + action + " " +
+                                        std::to_string(slot), &mine.host);
+    }
+
+    // "<START_GAME|START|MATCH> <game_id> <holes> <count> <name> <ip> <p_port>..."
     void setupPeerConnections(const char* gameInfo) {
         std::istringstream iss(gameInfo);
-        std::string success;
-        int gameId, holes, numPlayers;
-        iss >> success >> gameId >> holes >> numPlayers;
+        std::string kind;
+        uint32_t gameId;
+        int holes, numPlayers;
+        iss >> kind >> gameId >> holes >> numPlayers;
 
-        for (int i = 0; i < numPlayers; ++i) {
-            std::string name, ip, rightName, rightIp;
-            int port, rightPort;
-            iss >> name >> ip >> port >> rightName >> rightIp >> rightPort;
+        // Moves go over a reliable channel per player, sharing the peer port
+        std::lock_guard<std::mutex> lock(peerMtx);
+        for (const auto& peer : peers) {
+            delete peer.second;
+        }
+        peers.clear();
+        if (probeSock < 0) {
+            std::cout << "Peer port is not bound, cannot reach the other players." << std::endl;
+            return;
+        }
 
+        for (int i = 0; i < numPlayers; ++i) {
+            std::string name, ip;
+            int port;
+            if (!(iss >> name >> ip >> port)) {
+                break;
+            }
             if (name != playerName) {
-                int sock = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
-                if (sock < 0) DieWithError("socket() failed");
-
-                setupNonBlocking(sock);
-
                 struct sockaddr_in peerAddr;
                 memset(&peerAddr, 0, sizeof(peerAddr));
                 peerAddr.sin_family = AF_INET;
                 peerAddr.sin_addr.s_addr = inet_addr(ip.c_str());
                 peerAddr.sin_port = htons(port);
-
-                peerSockets.push_back(sock);
-
-                // Start a new thread to handle communication with this peer
-                std::thread peerThread(&PlayerClient::handlePeerCommunication, this, sock, name);
-                peerThread.detach();
+                peers[name] = new ReliableChannel(probeSock, peerAddr, gameId);
             }
         }
 
         std::cout << "Peer connections set up. Ready to play!" << std::endl;
     }
 
+    void sayToPeer(const std::string& name, const std::string& text) {
+        std::lock_guard<std::mutex> lock(peerMtx);
+        auto peer = peers.find(name);
+        if (peer == peers.end()) {
+            std::cout << "Not at a table with " << name << "." << std::endl;
+            return;
+        }
+        if (!peer->second->send(text)) {
+            std::cout << "Could not queue the message for " << name << "." << std::endl;
+            return;
+        }
+        peer->second->poll(clockUs());
+    }
+
 
-    void run() {
-        // Start a thread to handle tracker communication
-        std::thread trackerThread(&PlayerClient::handleTrackerCommunication, this);
-        trackerThread.detach();
+    PlayerClient() {
+        memset(&hostAddr, 0, sizeof(hostAddr));
+        memset(&callTo, 0, sizeof(callTo));
+    }
 
+    // Runs on the main thread until "quit" or the end of input
+    void run() {
         std::string command;
         while (true) {
             std::cout << "> ";
-            std::getline(std::cin, command);
+            if (!std::getline(std::cin, command)) {
+                break;
+            }
+            (void) TRACE_POLL(); // SIGUSR1 asks for the trace; the client keeps running
 
             std::istringstream iss(command);
             std::string cmd;
@@ -269,22 +934,92 @@ public:
                 std::string dealer;
                 int numPlayers, numHoles;
                 if (iss >> dealer >> numPlayers >> numHoles) {
-                    startGame(dealer, numPlayers, numHoles);
+                    std::string options; // "[variant] [hosted]"
+                    std::getline(iss >> std::ws, options);
+                    startGame(dealer, numPlayers, numHoles, options);
                 } else {
-                    std::cout << "Usage: start <dealer> <num_players> <num_holes>" << std::endl;
+                    std::cout << "Usage: start <dealer> <num_players> <num_holes> [variant] [hosted]" << std::endl;
                 }
             } else if (cmd == "end") {
-                int gameId;
+                uint32_t gameId;
                 std::string dealer;
                 if (iss >> gameId >> dealer) {
-                    endGame(gameId, dealer);
+                    std::vector<int> scores;
+                    int score;
+                    while (iss >> score) {
+                        scores.push_back(score);
+                    }
+                    endGame(gameId, dealer, scores);
+                } else {
+                    std::cout << "Usage: end <game_id> <dealer> [scores...]" << std::endl;
+                }
+            } else if (cmd == "match") {
+                int tableSize, numHoles;
+                if (iss >> tableSize >> numHoles) {
+                    enqueueForMatch(tableSize, numHoles);
                 } else {
-                    std::cout << "Usage: end <game_id> <dealer>" << std::endl;
+                    std::cout << "Usage: match <table_size> <num_holes>" << std::endl;
                 }
+            } else if (cmd == "cancel_match") {
+                cancelMatch();
             } else if (cmd == "query_players") {
-                sendMessage(CMD_QUERY_PLAYERS, "");
+                std::string filters;
+                std::getline(iss >> std::ws, filters);
+                sendMessage(CMD_QUERY_PLAYERS, filters);
             } else if (cmd == "query_games") {
                 sendMessage(CMD_QUERY_GAMES, "");
+            } else if (cmd == "lobby") {
+                refreshLobby();
+            } else if (cmd == "say") {
+                std::string name, text;
+                if (iss >> name && std::getline(iss >> std::ws, text) && !text.empty()) {
+                    sayToPeer(name, text);
+                } else {
+                    std::cout << "Usage: say <player> <message>" << std::endl;
+                }
+            } else if (cmd == "probe") {
+                probePeers();
+            } else if (cmd == "leaderboard") {
+                std::string count;
+                iss >> count;
+                sendMessage(CMD_QUERY_LEADERBOARD, "TOP " + count);
+            } else if (cmd == "rank") {
+                std::string name = playerName;
+                iss >> name;
+                sendMessage(CMD_QUERY_LEADERBOARD, "RANK " + playerRef(name));
+            } else if (cmd == "multi") {
+                std::vector<std::string> ops;
+                std::string op;
+                while (std::getline(iss >> std::ws, op, ';')) {
+                    while (!op.empty() && op.back() == ' ') op.pop_back();
+                    if (!op.empty()) ops.push_back(op);
+                }
+                if (!ops.empty()) {
+                    sendBatch(ops);
+                } else {
+                    std::cout << "Usage: multi <COMMAND args> ; <COMMAND args> ..." << std::endl;
+                }
+            } else if (cmd == "watch") {
+                std::string hostIP;
+                int hostPort;
+                uint32_t table;
+                if (iss >> hostIP >> hostPort >> table && table != 0) {
+                    watchTable(hostIP.c_str(), hostPort, table);
+                } else {
+                    std::cout << "Usage: watch <host_ip> <host_port> <table_id>" << std::endl;
+                }
+            } else if (cmd == "unwatch") {
+                unwatchTable();
+            } else if (cmd == "join") {
+                joinTable();
+            } else if (cmd == "move") {
+                std::string source, action;
+                int slot;
+                if (iss >> source >> action >> slot) {
+                    playMove(source, action, slot);
+                } else {
+                    std::cout << "Usage: move <deck|discard> <replace|flip> <slot>" << std::endl;
+                }
             } else if (cmd == "help") {
                 ShowHelp();
             } else {
@@ -294,25 +1029,44 @@ public:
     }
 
     ~PlayerClient() {
-        close(trackerSock);
-        for (int sock : peerSockets) {
-            close(sock);
+        if (probeSock >= 0) {
+            close(probeSock);
+        }
+        for (const auto& peer : peers) {
+            delete peer.second;
         }
     }
 };
 
 int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s <Server IP> <Server Port>\n", argv[0]);
+    if (argc != 3 && !(argc == 4 && strcmp(argv[3], "--local") == 0)) {
+        fprintf(stderr, "Usage: %s <Server IP> <Server Port> [--local]\n", argv[0]);
+        exit(1);
+    }
+
+    TRACE_INIT("PlayerClient", false);
+    ClientRuntime runtime(argv[1], atoi(argv[2]), 1);
+    PlayerClient client;
+    std::string error;
+    if (!runtime.add(&client, 0, error)) {
+        fprintf(stderr, "client: %s\n", error.c_str());
         exit(1);
     }
+    if (argc == 4) {
+        if (runtime.attachLocal(&client, atoi(argv[2]), error)) {
+            std::cout << "Attached to the tracker's local channel." << std::endl;
+        } else {
+            std::cout << "Local channel unavailable (" << error << "), using UDP." << std::endl;
+        }
+    }
+    std::thread loop(&ClientRuntime::run, &runtime);
 
-    PlayerClient client(argv[1], atoi(argv[2]));
-    
     std::cout << "Welcome to the Six Card Golf client!" << std::endl;
     std::cout << "Type 'help' for a list of available commands." << std::endl;
 
     client.run();
+    runtime.stop();
+    loop.join();
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "PlayerSearch.h"
+#include <arpa/inet.h>
+#include <cstdlib>
+#include <sstream>
+
+bool PlayerSearch::address(const std::string& ip, uint32_t& out) {
+    struct in_addr addr;
+    if (inet_pton(AF_INET, ip.c_str(), &addr) != 1) {
+        return false;
+    }
+    out = ntohl(addr.s_addr);
+    return true;
+}
+
+bool PlayerSearch::parse(const std::string& args, Filter& filter, std::string& error) {
+    std::istringstream iss(args);
+    std::string term;
+    while (iss >> term) {
+        size_t eq = term.find('=');
+        std::string key = term.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : term.substr(eq + 1);
+        if (value.empty()) {
+            error = "Filters are state=, prefix= and ip=";
+            return false;
+        }
+        if (key == "state") {
+            filter.state = value;
+        } else if (key == "prefix") {
+            filter.prefix = value;
+        } else if (key == "ip") {
+            size_t slash = value.find('/');
+            int bits = 32;
+            if (slash != std::string::npos) {
+                char* end = nullptr;
+                bits = static_cast<int>(strtol(value.c_str() + slash + 1, &end, 10));
+                if (*end != '\0' || slash + 1 == value.size() || bits < 0 || bits > 32) {
+                    error = "Invalid address block";
+                    return false;
+                }
+            }
+            uint32_t base;
+            if (!address(value.substr(0, slash), base)) {
+                error = "Invalid address block";
+                return false;
+            }
+            uint32_t mask = bits == 0 ? 0 : ~0u << (32 - bits);
+            filter.byAddress = true;
+            filter.low = base & mask;
+            filter.high = filter.low | ~mask;
+        } else {
+            error = "Filters are state=, prefix= and ip=";
+            return false;
+        }
+    }
+    return true;
+}
+
+void PlayerSearch::add(uint32_t handle, const PlayerInfo& player) {
+    names[player.name] = handle;
+    byState[player.state][player.name] = handle;
+    uint32_t ip;
+    if (address(player.ipAddress, ip)) {
+        addresses.insert(std::make_pair(ip, handle));
+    }
+}
+
+void PlayerSearch::remove(uint32_t handle, const PlayerInfo& player) {
+    names.erase(player.name);
+    auto state = byState.find(player.state);
+    if (state != byState.end()) {
+        state->second.erase(player.name);
+    }
+    uint32_t ip;
+    if (address(player.ipAddress, ip)) {
+        auto range = addresses.equal_range(ip);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == handle) {
+                addresses.erase(it);
+                break;
+            }
+        }
+    }
+}
+
+void PlayerSearch::changeState(uint32_t handle, const PlayerInfo& player, const std::string& from) {
+    auto state = byState.find(from);
+    if (state != byState.end()) {
+        state->second.erase(player.name);
+    }
+    byState[player.state][player.name] = handle;
+}
+
+static bool inBlock(const PlayerSearch::Filter& filter, const PlayerInfo& player) {
+    if (!filter.byAddress) {
+        return true;
+    }
+    struct in_addr addr;
+    if (inet_pton(AF_INET, player.ipAddress.c_str(), &addr) != 1) {
+        return false;
+    }
+    uint32_t ip = ntohl(addr.s_addr);
+    return ip >= filter.low && ip <= filter.high;
+}
+
+void PlayerSearch::prefixRange(const NameIndex& index, const Filter& filter, const SlotMap<PlayerInfo>& players,
+                               std::vector<uint32_t>& out) {
+    const std::string& prefix = filter.prefix;
+    for (auto it = index.lower_bound(prefix); it != index.end() && it->first.compare(0, prefix.size(), prefix) == 0;
+         ++it) {
+        if (inBlock(filter, *players.get(it->second))) {
+            out.push_back(it->second);
+        }
+    }
+}
+
+void PlayerSearch::find(const Filter& filter, const SlotMap<PlayerInfo>& players, std::vector<uint32_t>& out) const {
+    const NameIndex* index = &names;
+    if (!filter.state.empty()) {
+        auto state = byState.find(filter.state);
+        if (state == byState.end()) {
+            return;
+        }
+        index = &state->second;
+    }
+
+    // Without a name prefix, an address block is the narrower range
+    if (filter.prefix.empty() && filter.byAddress) {
+        for (auto it = addresses.lower_bound(filter.low); it != addresses.end() && it->first <= filter.high; ++it) {
+            if (filter.state.empty() || players.get(it->second)->state == filter.state) {
+                out.push_back(it->second);
+            }
+        }
+        return;
+    }
+    prefixRange(*index, filter, players, out);
+}
\ No newline at end of file
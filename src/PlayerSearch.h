@@ -0,0 +1,50 @@
+#ifndef PLAYER_SEARCH_H
+#define PLAYER_SEARCH_H
+
+#include "Utils.h"
+#include "SlotMap.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Secondary indexes over the local registry for filtered QUERY_PLAYERS:
+// names in order, names in order per state, and IPv4 addresses in order.
+// A query walks the range of one index and checks the other filters on
+// the players it finds, so a name prefix or address block costs time in
+// proportion to the players inside it, not to the registry.
+class PlayerSearch {
+public:
+    struct Filter {
+        std::string state;    // Empty matches every state
+        std::string prefix;   // Of the name; empty matches every name
+        bool byAddress = false;
+        uint32_t low = 0;     // Address block, host byte order, inclusive
+        uint32_t high = 0;
+    };
+
+    // "[state=<state>] [prefix=<text>] [ip=<a.b.c.d>[/<bits>]]"
+    static bool parse(const std::string& args, Filter& filter, std::string& error);
+
+    void add(uint32_t handle, const PlayerInfo& player);
+    void remove(uint32_t handle, const PlayerInfo& player);
+    void changeState(uint32_t handle, const PlayerInfo& player, const std::string& from);
+
+    // Handles of the matching players, in name order unless the address
+    // block alone narrows the search
+    void find(const Filter& filter, const SlotMap<PlayerInfo>& players, std::vector<uint32_t>& out) const;
+
+private:
+    typedef std::map<std::string, uint32_t> NameIndex;
+
+    NameIndex names;
+    std::unordered_map<std::string, NameIndex> byState;
+    std::multimap<uint32_t, uint32_t> addresses;
+
+    static bool address(const std::string& ip, uint32_t& out);
+    static void prefixRange(const NameIndex& index, const Filter& filter, const SlotMap<PlayerInfo>& players,
+                            std::vector<uint32_t>& out);
+};
+
+#endif // PLAYER_SEARCH_H
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include "ReliableChannel.h"
+#include <algorithm>
+#include <cstring>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+// Sequence numbers wrap, so order is the sign of the difference
+static inline int32_t seqDiff(uint32_t a, uint32_t b) {
+    return static_cast<int32_t>(a - b);
+}
+
+static inline void put32(char* p, uint32_t v) {
+    v = htonl(v);
+    memcpy(p, &v, 4);
+}
+
+static inline uint32_t get32(const char* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return ntohl(v);
+}
+
+static inline void put16(char* p, uint16_t v) {
+    v = htons(v);
+    memcpy(p, &v, 2);
+}
+
+static inline uint16_t get16(const char* p) {
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return ntohs(v);
+}
+
+ReliableChannel::ReliableChannel(int sock, const sockaddr_in& peer, uint32_t gameId)
+    : sock(sock), peerAddr(peer), game(static_cast<uint16_t>(gameId)), sendBase(0), srtt(0), rttvar(0), rto(RELIABLE_RTO_INITIAL_US), measured(false),
+      recvNext(0), ackOwed(false) {
+}
+
+bool ReliableChannel::send(const std::string& message) {
+    if (message.size() > RELIABLE_MAX_MESSAGE || backlog.size() >= RELIABLE_BACKLOG) {
+        return false;
+    }
+    backlog.push_back(message);
+    return true;
+}
+
+void ReliableChannel::onDatagram(const char* data, size_t len, uint64_t nowUs, std::vector<std::string>& delivered) {
+    if (len < RELIABLE_HEADER || static_cast<uint8_t>(data[0]) != RELIABLE_MAGIC || get16(data + 2) != game) {
+        return;
+    }
+    int count = static_cast<uint8_t>(data[1]);
+    uint32_t ack = get32(data + 4);
+    uint64_t sack = (static_cast<uint64_t>(get32(data + 8)) << 32) | get32(data + 12);
+
+    // Round trips are only sampled from messages sent once, as a reply to
+    // a resent message cannot be matched to its copy
+    int32_t advance = seqDiff(ack, sendBase);
+    if (advance > 0 && advance <= static_cast<int32_t>(inFlight.size())) {
+        for (int32_t i = 0; i < advance; ++i) {
+            const Outstanding& front = inFlight.front();
+            if (!front.acked && front.sends == 1) {
+                sample(nowUs - front.sentUs);
+            }
+            inFlight.pop_front();
+        }
+        sendBase = ack;
+    }
+    for (int bit = 0; bit < RELIABLE_SACK_BITS && sack != 0; ++bit) {
+        if (!(sack & (1ull << bit))) {
+            continue;
+        }
+        int32_t index = seqDiff(ack + 1 + bit, sendBase);
+        if (index >= 0 && index < static_cast<int32_t>(inFlight.size()) && !inFlight[index].acked) {
+            Outstanding& entry = inFlight[index];
+            entry.acked = true;
+            if (entry.sends == 1) {
+                sample(nowUs - entry.sentUs);
+            }
+        }
+    }
+
+    // A hole that later messages have overtaken often enough was lost
+    int later = 0;
+    for (size_t i = inFlight.size(); i-- > 0;) {
+        Outstanding& entry = inFlight[i];
+        if (entry.acked) {
+            later++;
+        } else if (later >= RELIABLE_DUP_THRESHOLD && entry.sends == 1 && !entry.due) {
+            entry.due = true;
+            entry.fast = true;
+        }
+    }
+
+    size_t offset = RELIABLE_HEADER;
+    for (int i = 0; i < count && offset + 6 <= len; ++i) {
+        uint32_t seq = get32(data + offset);
+        size_t size = get16(data + offset + 4);
+        offset += 6;
+        if (offset + size > len) {
+            break;
+        }
+        ackOwed = true;
+        int32_t ahead = seqDiff(seq, recvNext);
+        if (ahead < 0 || outOfOrder.count(seq) != 0) {
+            counters.duplicates++;
+        } else if (ahead == 0) {
+            delivered.push_back(std::string(data + offset, size));
+            recvNext++;
+            counters.delivered++;
+            for (auto next = outOfOrder.find(recvNext); next != outOfOrder.end(); next = outOfOrder.find(recvNext)) {
+                delivered.push_back(std::move(next->second));
+                outOfOrder.erase(next);
+                recvNext++;
+                counters.delivered++;
+            }
+        } else if (ahead < 2 * RELIABLE_WINDOW) {
+            outOfOrder.emplace(seq, std::string(data + offset, size));
+        }
+        offset += size;
+    }
+}
+
+void ReliableChannel::poll(uint64_t nowUs) {
+    while (!backlog.empty() && inFlight.size() < RELIABLE_WINDOW) {
+        Outstanding entry = {std::move(backlog.front()), 0, 0, false, true, false};
+        inFlight.push_back(std::move(entry));
+        backlog.pop_front();
+    }
+
+    for (Outstanding& entry : inFlight) {
+        if (!entry.acked && !entry.due && entry.sends > 0 && nowUs - entry.sentUs >= timeoutUs(entry)) {
+            entry.due = true;
+            counters.timeouts++;
+        }
+    }
+
+    uint64_t sack = 0;
+    for (const auto& held : outOfOrder) {
+        int32_t bit = seqDiff(held.first, recvNext) - 1;
+        if (bit >= 0 && bit < RELIABLE_SACK_BITS) {
+            sack |= 1ull << bit;
+        }
+    }
+    char buffer[RELIABLE_MTU];
+    memset(buffer, 0, RELIABLE_HEADER);
+    buffer[0] = static_cast<char>(RELIABLE_MAGIC);
+    put16(buffer + 2, game);
+    put32(buffer + 4, recvNext);
+    put32(buffer + 8, static_cast<uint32_t>(sack >> 32));
+    put32(buffer + 12, static_cast<uint32_t>(sack));
+
+    size_t len = RELIABLE_HEADER;
+    int count = 0;
+    for (size_t i = 0; i < inFlight.size(); ++i) {
+        Outstanding& entry = inFlight[i];
+        if (!entry.due || entry.acked) {
+            continue;
+        }
+        if (len + 6 + entry.text.size() > RELIABLE_MTU || count == 255) {
+            buffer[1] = static_cast<char>(count);
+            transmit(buffer, len);
+            len = RELIABLE_HEADER;
+            count = 0;
+        }
+        put32(buffer + len, sendBase + static_cast<uint32_t>(i));
+        put16(buffer + len + 4, static_cast<uint16_t>(entry.text.size()));
+        memcpy(buffer + len + 6, entry.text.data(), entry.text.size());
+        len += 6 + entry.text.size();
+        count++;
+
+        if (entry.sends > 0) {
+            counters.retransmits++;
+            counters.fastRetransmits += entry.fast ? 1 : 0;
+        }
+        entry.sends++;
+        entry.sentUs = nowUs;
+        entry.due = false;
+        entry.fast = false;
+        counters.transmissions++;
+    }
+    if (count > 0 || ackOwed) {
+        buffer[1] = static_cast<char>(count);
+        transmit(buffer, len);
+    }
+}
+
+uint64_t ReliableChannel::nextTimerUs() const {
+    if (!backlog.empty() && inFlight.size() < RELIABLE_WINDOW) {
+        return 0;
+    }
+    uint64_t next = UINT64_MAX;
+    for (const Outstanding& entry : inFlight) {
+        if (entry.due) {
+            return 0;
+        }
+        if (!entry.acked) {
+            next = std::min<uint64_t>(next, entry.sentUs + timeoutUs(entry));
+        }
+    }
+    return next;
+}
+
+// Each resend of a message doubles its own timer, so a lost resend backs
+// off without holding up the timers of other messages
+uint64_t ReliableChannel::timeoutUs(const Outstanding& entry) const {
+    return std::min<uint64_t>(static_cast<uint64_t>(rto) << std::min<uint32_t>(entry.sends - 1, 8), RELIABLE_RTO_MAX_US);
+}
+
+void ReliableChannel::sample(uint64_t rttUs) {
+    uint32_t r = static_cast<uint32_t>(std::min<uint64_t>(rttUs, RELIABLE_RTO_MAX_US));
+    if (!measured) {
+        srtt = r;
+        rttvar = r / 2;
+        measured = true;
+    } else {
+        uint32_t err = srtt > r ? srtt - r : r - srtt;
+        rttvar = (3 * rttvar + err) / 4;
+        srtt = (7 * srtt + r) / 8;
+    }
+    rto = std::min<uint32_t>(std::max<uint32_t>(srtt + std::max<uint32_t>(4 * rttvar, 1000), RELIABLE_RTO_MIN_US),
+                             RELIABLE_RTO_MAX_US);
+}
+
+// Datagrams the socket refuses are left to the retransmission timer
+void ReliableChannel::transmit(const char* data, size_t len) {
+    sendto(sock, data, len, MSG_DONTWAIT, reinterpret_cast<const struct sockaddr*>(&peerAddr), sizeof(peerAddr));
+    counters.datagrams++;
+    ackOwed = false;
+}
\ No newline at end of file
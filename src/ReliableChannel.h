@@ -0,0 +1,106 @@
+#ifndef RELIABLE_CHANNEL_H
+#define RELIABLE_CHANNEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+
+#define RELIABLE_MAGIC 0xA7              // First byte of every datagram, never printable text
+#define RELIABLE_MTU 1200                // Largest datagram, messages are coalesced up to it
+#define RELIABLE_HEADER 16
+#define RELIABLE_MAX_MESSAGE (RELIABLE_MTU - RELIABLE_HEADER - 6)
+#define RELIABLE_WINDOW 256              // Messages in flight before send() queues
+#define RELIABLE_BACKLOG 4096            // Messages queued behind the window
+#define RELIABLE_SACK_BITS 64
+#define RELIABLE_DUP_THRESHOLD 3         // Later messages acknowledged before a fast retransmit
+#define RELIABLE_RTO_INITIAL_US 200000
+#define RELIABLE_RTO_MIN_US 10000
+#define RELIABLE_RTO_MAX_US 2000000
+
+struct ReliableStats {
+    uint64_t datagrams = 0;       // Sent, including bare acknowledgements
+    uint64_t transmissions = 0;   // Messages sent, first copies and retransmissions
+    uint64_t retransmits = 0;
+    uint64_t fastRetransmits = 0; // Of the retransmits, those sent before the timer fired
+    uint64_t timeouts = 0;        // Messages whose timer ran out
+    uint64_t delivered = 0;
+    uint64_t duplicates = 0;
+};
+
+// Reliable, ordered messages to one peer over a shared UDP socket.
+//
+// Each datagram is "<magic> <count> <game> <ack> <sack>" followed by count
+// records of "<seq> <len> <bytes>". game is the low 16 bits of the game ID
+// the channel was opened for; sequence numbers restart at 0 for every game,
+// so a late datagram from an earlier game with the same peer is dropped
+// rather than taken for this one's. ack is the next sequence number the sender of
+// the datagram expects, and bit i of the 64-bit sack says it also holds
+// ack + 1 + i. Every datagram carries the latest acknowledgement, so acks
+// ride along with data and a lost ack is repaired by the next one. A
+// message that RELIABLE_DUP_THRESHOLD later messages overtook is resent at
+// once; anything else is resent when its retransmission timer, estimated
+// from round trips as in RFC 6298 and doubled on each resend, runs out. Messages waiting to
+// go out are packed into as few datagrams as fit.
+//
+// The owner reads the socket, hands this peer's datagrams to
+// onDatagram(), and calls poll() after each batch and whenever
+// nextTimerUs() passes. Not thread-safe.
+class ReliableChannel {
+public:
+    ReliableChannel(int sock, const sockaddr_in& peer, uint32_t gameId);
+
+    // Queues a message; false when it is too long or the backlog is full
+    bool send(const std::string& message);
+
+    // Appends messages that are now in order to delivered
+    void onDatagram(const char* data, size_t len, uint64_t nowUs, std::vector<std::string>& delivered);
+
+    // Sends queued and due messages, and any owed acknowledgement
+    void poll(uint64_t nowUs);
+
+    // When poll() next has a retransmission to make, or UINT64_MAX
+    uint64_t nextTimerUs() const;
+
+    bool idle() const { return inFlight.empty() && backlog.empty(); }
+    uint32_t rtoUs() const { return rto; }
+    const sockaddr_in& peer() const { return peerAddr; }
+    const ReliableStats& stats() const { return counters; }
+
+private:
+    struct Outstanding {
+        std::string text;
+        uint64_t sentUs;
+        uint32_t sends;
+        bool acked;
+        bool due;
+        bool fast; // Due because later messages overtook it
+    };
+
+    int sock;
+    sockaddr_in peerAddr;
+    uint16_t game;
+
+    // Sending: inFlight[i] holds sequence number sendBase + i
+    std::deque<Outstanding> inFlight;
+    std::deque<std::string> backlog;
+    uint32_t sendBase;
+    uint32_t srtt, rttvar, rto;
+    bool measured;
+
+    // Receiving
+    uint32_t recvNext;
+    std::map<uint32_t, std::string> outOfOrder;
+    bool ackOwed;
+
+    ReliableStats counters;
+
+    uint64_t timeoutUs(const Outstanding& entry) const;
+    void sample(uint64_t rttUs);
+    void transmit(const char* data, size_t len);
+};
+
+#endif // RELIABLE_CHANNEL_H
\ No newline at end of file
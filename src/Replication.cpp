@@ -0,0 +1,322 @@
+#include "Replication.h"
+#include "TrackerServer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+uint64_t monotonicMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Wall-clock microseconds, comparable between processes on one host
+static int64_t wallClockUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static int openReplicationSocket(unsigned short port) {
+    int sock;
+    if ((sock = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0)
+        DieWithError("replication: socket() failed");
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+        DieWithError("replication: bind() failed");
+
+    int flags = fcntl(sock, F_GETFL, 0);
+    if (flags == -1 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1)
+        DieWithError("replication: fcntl() failed");
+    return sock;
+}
+
+ReplicationPrimary::ReplicationPrimary(TrackerServer& server, MutationLog& log, const std::vector<sockaddr_in>& addrs)
+    : server(server), log(log), sock(openReplicationSocket(0)), lastStatsMs(monotonicMs()) {
+    uint64_t now = monotonicMs();
+    for (const auto& addr : addrs) {
+        Backup backup;
+        backup.addr = addr;
+        backup.epoch = 0;
+        backup.acked = 0;
+        backup.sent = 0;
+        backup.lastProgressMs = now;
+        backup.lastAckMs = now;
+        backup.lastSendMs = 0;
+        backup.snapshotSeq = 0;
+        backup.shipped = 0;
+        backups.push_back(backup);
+    }
+}
+
+ReplicationPrimary::~ReplicationPrimary() {
+    close(sock);
+}
+
+// Maps a stream position to a record: the epoch's snapshot comes first,
+// followed by the log from the snapshot's sequence number onwards
+bool ReplicationPrimary::recordAt(const Backup& backup, uint64_t pos, std::string& record, uint64_t& logSeq) const {
+    if (pos <= backup.snapshot.size()) {
+        record = backup.snapshot[pos - 1];
+        logSeq = backup.snapshotSeq;
+        return true;
+    }
+    logSeq = backup.snapshotSeq + (pos - backup.snapshot.size());
+    return log.get(logSeq, record);
+}
+
+void ReplicationPrimary::startEpoch(Backup& backup, uint32_t epoch) {
+    backup.epoch = epoch;
+    backup.acked = 0;
+    backup.sent = 0;
+    backup.snapshot.clear();
+    server.snapshot(backup.snapshot, backup.snapshotSeq);
+    printf("replication: backup %s:%d restarted in epoch %u with a %zu record snapshot at seq %llu\n",
+           inet_ntoa(backup.addr.sin_addr), ntohs(backup.addr.sin_port), epoch,
+           backup.snapshot.size(), (unsigned long long) backup.snapshotSeq);
+}
+
+void ReplicationPrimary::onReadable() {
+    char buffer[256];
+    struct sockaddr_in from;
+    socklen_t fromLen = sizeof(from);
+    ssize_t n;
+    uint64_t now = monotonicMs();
+
+    while ((n = recvfrom(sock, buffer, sizeof(buffer) - 1, 0, (struct sockaddr *) &from, &fromLen)) > 0) {
+        buffer[n] = '\0';
+        unsigned int epoch;
+        unsigned long long pos;
+        if (sscanf(buffer, "ACK %u %llu", &epoch, &pos) != 2) {
+            continue;
+        }
+        for (auto& backup : backups) {
+            if (backup.addr.sin_addr.s_addr != from.sin_addr.s_addr || backup.addr.sin_port != from.sin_port) {
+                continue;
+            }
+            backup.lastAckMs = now;
+
+            // The backup lost our stream (it restarted, or needs trimmed
+            // records). While an epoch is still starting, stale acks from the
+            // previous one are expected and the RTO resends position 1.
+            bool trimmed = pos >= backup.snapshot.size() &&
+                backup.snapshotSeq + (pos - backup.snapshot.size()) + 1 < log.tail();
+            if (epoch != backup.epoch || trimmed) {
+                if (backup.acked > 0 || backup.epoch == 0) {
+                    startEpoch(backup, backup.epoch + 1);
+                }
+                break;
+            }
+            if (pos > backup.acked) {
+                backup.acked = pos;
+                backup.lastProgressMs = now;
+            }
+            if (backup.sent < backup.acked) {
+                backup.sent = backup.acked;
+            }
+            break;
+        }
+    }
+}
+
+void ReplicationPrimary::ship(Backup& backup, uint64_t nowMs) {
+    // Go back to the last acknowledged record when progress stalls
+    if (backup.sent > backup.acked && nowMs - backup.lastProgressMs >= REPL_RTO_MS) {
+        backup.sent = backup.acked;
+        backup.lastProgressMs = nowMs;
+    }
+
+    uint64_t head = log.head();
+    for (;;) {
+        std::string payload;
+        std::string record;
+        uint64_t first = backup.sent + 1;
+        uint64_t pos = first;
+        uint64_t logSeq = 0;
+        uint64_t lastLogSeq = backup.snapshotSeq;
+        while (pos - backup.acked <= REPL_WINDOW && recordAt(backup, pos, record, logSeq)) {
+            if (!payload.empty() && payload.size() + record.size() + 1 > REPL_BATCH_BYTES) {
+                break;
+            }
+            payload += record;
+            payload += '\n';
+            lastLogSeq = logSeq;
+            pos++;
+        }
+
+        uint64_t count = pos - first;
+        if (count == 0 && nowMs - backup.lastSendMs < REPL_HEARTBEAT_MS) {
+            return;
+        }
+
+        char header[128];
+        snprintf(header, sizeof(header), "REPL %u %llu %llu %llu %llu %lld\n", backup.epoch,
+                 (unsigned long long) first, (unsigned long long) count, (unsigned long long) lastLogSeq,
+                 (unsigned long long) head, (long long) wallClockUs());
+        std::string datagram = header + payload;
+        if (sendto(sock, datagram.data(), datagram.size(), 0, (struct sockaddr *) &backup.addr, sizeof(backup.addr)) < 0) {
+            return; // Try again on the next tick
+        }
+        backup.lastSendMs = nowMs;
+        backup.sent += count;
+        backup.shipped += count;
+        if (count == 0) {
+            return;
+        }
+    }
+}
+
+// Trims what every live backup has applied, and refuses writes while a live
+// backup is more than REPL_MAX_LAG records behind so that a takeover loses a
+// bounded amount of history
+void ReplicationPrimary::trimAndThrottle(uint64_t nowMs) {
+    uint64_t head = log.head();
+    uint64_t trimTo = head;
+    uint64_t maxLag = 0;
+    for (const auto& backup : backups) {
+        if (nowMs - backup.lastAckMs >= REPL_DEAD_MS) {
+            continue;
+        }
+        // A backup still loading its snapshot needs the log from snapshotSeq on
+        uint64_t appliedSeq = backup.acked >= backup.snapshot.size()
+            ? backup.snapshotSeq + (backup.acked - backup.snapshot.size()) : backup.snapshotSeq;
+        trimTo = std::min(trimTo, appliedSeq);
+        maxLag = std::max(maxLag, head - appliedSeq);
+    }
+    log.trim(trimTo);
+    server.setWritesThrottled(maxLag > REPL_MAX_LAG);
+}
+
+void ReplicationPrimary::tick(uint64_t nowMs) {
+    for (auto& backup : backups) {
+        ship(backup, nowMs);
+    }
+    trimAndThrottle(nowMs);
+
+    if (nowMs - lastStatsMs >= REPL_STATS_MS) {
+        double seconds = (nowMs - lastStatsMs) / 1000.0;
+        uint64_t head = log.head();
+        for (auto& backup : backups) {
+            uint64_t appliedSeq = backup.acked >= backup.snapshot.size()
+                ? backup.snapshotSeq + (backup.acked - backup.snapshot.size()) : 0;
+            printf("replication: backup %s:%d acked seq %llu of %llu (%llu behind), %.0f records/s%s\n",
+                   inet_ntoa(backup.addr.sin_addr), ntohs(backup.addr.sin_port),
+                   (unsigned long long) appliedSeq, (unsigned long long) head,
+                   (unsigned long long) (head - appliedSeq), backup.shipped / seconds,
+                   nowMs - backup.lastAckMs >= REPL_DEAD_MS ? " [not responding]" : "");
+            backup.shipped = 0;
+        }
+        lastStatsMs = nowMs;
+    }
+}
+
+ReplicationBackup::ReplicationBackup(TrackerServer& server, unsigned short port)
+    : server(server), sock(openReplicationSocket(port)), epoch(0), applied(0), appliedLogSeq(0),
+      primaryHead(0), lastPrimaryMs(monotonicMs()), lastStatsMs(monotonicMs()), appliedSinceStats(0),
+      lastLagUs(0), isPromoted(false), primaryKnown(false) {
+    memset(&primary, 0, sizeof(primary));
+    server.setStandby(true);
+}
+
+ReplicationBackup::~ReplicationBackup() {
+    close(sock);
+}
+
+// The standby follows the primary whose snapshot it received first. Batches
+// from any other address, and malformed or truncated batches, are dropped
+// before they can reset state, apply records or hold off the takeover.
+void ReplicationBackup::onReadable(uint64_t nowMs) {
+    static char buffer[REPL_BATCH_BYTES + 256];
+    struct sockaddr_in from;
+    socklen_t fromLen = sizeof(from);
+    ssize_t n;
+
+    while ((n = recvfrom(sock, buffer, sizeof(buffer) - 1, 0, (struct sockaddr *) &from, &fromLen)) > 0) {
+        buffer[n] = '\0';
+        if (isPromoted) {
+            continue;
+        }
+
+        unsigned int batchEpoch;
+        unsigned long long first, count, lastLogSeq, head;
+        long long sentUs;
+        if (sscanf(buffer, "REPL %u %llu %llu %llu %llu %lld", &batchEpoch, &first, &count,
+                   &lastLogSeq, &head, &sentUs) != 6) {
+            continue;
+        }
+        if (primaryKnown ? from.sin_addr.s_addr != primary.sin_addr.s_addr || from.sin_port != primary.sin_port
+                         : first != 1) {
+            continue;
+        }
+        const char* body = strchr(buffer, '\n');
+        if (body == nullptr) {
+            continue;
+        }
+        std::vector<std::string> records;
+        std::istringstream iss(body + 1);
+        std::string record;
+        while (records.size() < count && std::getline(iss, record)) {
+            records.push_back(record);
+        }
+        if (records.size() < count) {
+            continue;
+        }
+        if (!primaryKnown) {
+            primaryKnown = true;
+            primary = from;
+        }
+        lastPrimaryMs = nowMs;
+        primaryHead = head;
+
+        // A new epoch always starts over from a snapshot at position 1
+        if (batchEpoch != epoch && first == 1) {
+            server.resetState();
+            epoch = batchEpoch;
+            applied = 0;
+            appliedLogSeq = 0;
+        }
+
+        if (batchEpoch == epoch && first == applied + 1 && count > 0) {
+            server.applyReplicated(records);
+            applied += records.size();
+            appliedSinceStats += records.size();
+            appliedLogSeq = lastLogSeq;
+            lastLagUs = wallClockUs() - sentUs;
+        }
+
+        char ack[64];
+        int len = snprintf(ack, sizeof(ack), "ACK %u %llu", epoch, (unsigned long long) applied);
+        sendto(sock, ack, len, 0, (struct sockaddr *) &from, fromLen);
+    }
+}
+
+void ReplicationBackup::tick(uint64_t nowMs) {
+    if (isPromoted) {
+        return;
+    }
+
+    if (nowMs - lastStatsMs >= REPL_STATS_MS) {
+        double seconds = (nowMs - lastStatsMs) / 1000.0;
+        printf("replication: applied seq %llu of %llu (%llu behind, delivery latency %.2f ms), %.0f records/s\n",
+               (unsigned long long) appliedLogSeq, (unsigned long long) primaryHead,
+               (unsigned long long) (primaryHead > appliedLogSeq ? primaryHead - appliedLogSeq : 0),
+               lastLagUs / 1000.0, appliedSinceStats / seconds);
+        appliedSinceStats = 0;
+        lastStatsMs = nowMs;
+    }
+
+    if (nowMs - lastPrimaryMs >= REPL_TAKEOVER_MS) {
+        isPromoted = true;
+        server.setStandby(false);
+        printf("replication: primary silent for %d ms, promoted to primary at seq %llu\n",
+               REPL_TAKEOVER_MS, (unsigned long long) appliedLogSeq);
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+#include "MutationLog.h"
+
+#define REPL_BATCH_BYTES 8192     // Payload budget of one replication datagram
+#define REPL_WINDOW 4096          // Records in flight per backup
+#define REPL_RTO_MS 100           // Resend from the last ack after this long without progress
+#define REPL_HEARTBEAT_MS 100     // Idle heartbeat interval
+#define REPL_DEAD_MS 3000         // Backups silent this long stop holding back the log
+#define REPL_MAX_LAG 8192         // Unacknowledged records before writes are refused
+#define REPL_TAKEOVER_MS 1000     // Primary silence before a backup promotes itself
+#define REPL_STATS_MS 1000
+#define REPL_TICK_MS 10           // Main loop wakeup interval while replicating
+
+class TrackerServer;
+
+// Primary side: ships the log to each backup in batched datagrams
+//   "REPL <epoch> <firstPos> <count> <lastLogSeq> <headSeq> <sentUs>\n<record>\n..."
+// and collects "ACK <epoch> <pos>" watermarks. A backup that asks for records
+// already trimmed from the log is restarted in a new epoch whose stream opens
+// with a snapshot of the tracker state.
+class ReplicationPrimary {
+public:
+    ReplicationPrimary(TrackerServer& server, MutationLog& log, const std::vector<sockaddr_in>& backups);
+    ~ReplicationPrimary();
+
+    int fd() const { return sock; }
+    void onReadable();
+    void tick(uint64_t nowMs);
+
+private:
+    struct Backup {
+        sockaddr_in addr;
+        uint32_t epoch;
+        uint64_t acked;           // Stream position acknowledged
+        uint64_t sent;            // Stream position sent so far
+        uint64_t lastProgressMs;
+        uint64_t lastAckMs;
+        uint64_t lastSendMs;
+        std::vector<std::string> snapshot; // Opens the stream in this epoch
+        uint64_t snapshotSeq;     // Log sequence the snapshot reflects
+        uint64_t shipped;         // Records sent since the last stats line
+    };
+
+    TrackerServer& server;
+    MutationLog& log;
+    std::vector<Backup> backups;
+    int sock;
+    uint64_t lastStatsMs;
+
+    bool recordAt(const Backup& backup, uint64_t pos, std::string& record, uint64_t& logSeq) const;
+    void startEpoch(Backup& backup, uint32_t epoch);
+    void ship(Backup& backup, uint64_t nowMs);
+    void trimAndThrottle(uint64_t nowMs);
+};
+
+// Backup side: applies batches in order, acknowledges its watermark and
+// promotes the server to primary when the primary goes quiet
+class ReplicationBackup {
+public:
+    ReplicationBackup(TrackerServer& server, unsigned short port);
+    ~ReplicationBackup();
+
+    int fd() const { return sock; }
+    void onReadable(uint64_t nowMs);
+    void tick(uint64_t nowMs);
+    bool promoted() const { return isPromoted; }
+
+private:
+    TrackerServer& server;
+    int sock;
+    uint32_t epoch;
+    uint64_t applied;         // Stream position applied
+    uint64_t appliedLogSeq;
+    uint64_t primaryHead;
+    uint64_t lastPrimaryMs;
+    uint64_t lastStatsMs;
+    uint64_t appliedSinceStats;
+    int64_t lastLagUs;
+    bool isPromoted;
+    bool primaryKnown;        // Latched from the first snapshot; other senders are ignored
+    sockaddr_in primary;
+};
+
+uint64_t monotonicMs();
+
+#endif // REPLICATION_H
@@ -0,0 +1,88 @@
+#include "SendQueue.h"
+#include <cerrno>
+#include <cstdio>
+#include <sys/socket.h>
+
+SendQueue::SendQueue(int sock, size_t maxDatagrams, size_t maxBytes)
+    : sock(sock), maxDatagrams(maxDatagrams), maxBytes(maxBytes), queuedBytes(0), sent(0), deferred(0), dropped(0),
+      failed(0), calls(0), peakDepth(0), lastReportMs(0) {}
+
+SendQueue::Result SendQueue::trySend(const void* data, size_t len, const sockaddr_in& to) {
+    calls++;
+    ssize_t n = sendto(sock, data, len, MSG_DONTWAIT, (const struct sockaddr *) &to, sizeof(to));
+    if (n == static_cast<ssize_t>(len)) {
+        sent++;
+        return SENT;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS || errno == ENOMEM || errno == EINTR)) {
+        return RETRY;
+    }
+    failed++;
+    return FAILED;
+}
+
+bool SendQueue::send(const void* data, size_t len, const sockaddr_in& to) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (queue.empty()) {
+        Result result = trySend(data, len, to);
+        if (result != RETRY) {
+            return result == SENT;
+        }
+    }
+
+    if (queue.size() >= maxDatagrams || queuedBytes + len > maxBytes) {
+        dropped++;
+        return false;
+    }
+    queue.push_back(Pending{to, std::string(static_cast<const char*>(data), len)});
+    queuedBytes += len;
+    deferred++;
+    if (queue.size() > peakDepth) {
+        peakDepth = queue.size();
+    }
+    return true;
+}
+
+// Sends queued datagrams in order until the socket pushes back again
+void SendQueue::flush() {
+    std::lock_guard<std::mutex> lock(mtx);
+    while (!queue.empty()) {
+        const Pending& next = queue.front();
+        if (trySend(next.payload.data(), next.payload.size(), next.to) == RETRY) {
+            return;
+        }
+        queuedBytes -= next.payload.size();
+        queue.pop_front();
+    }
+}
+
+uint64_t SendQueue::sendCalls() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return calls;
+}
+
+bool SendQueue::pending() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return !queue.empty();
+}
+
+bool SendQueue::congested() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return queue.size() * 2 > maxDatagrams || queuedBytes * 2 > maxBytes;
+}
+
+// Prints once per second while the socket is pushing back
+void SendQueue::report(uint64_t nowMs, const char* name) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (nowMs - lastReportMs < 1000) {
+        return;
+    }
+    if (deferred + dropped + failed > 0) {
+        printf("%s: %llu sent, %llu deferred, %llu dropped (queue full), %llu failed, peak queue %zu, %zu queued\n",
+               name, (unsigned long long) sent, (unsigned long long) deferred, (unsigned long long) dropped,
+               (unsigned long long) failed, peakDepth, queue.size());
+    }
+    sent = deferred = dropped = failed = 0;
+    peakDepth = queue.size();
+    lastReportMs = nowMs;
+}
\ No newline at end of file
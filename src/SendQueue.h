@@ -0,0 +1,52 @@
+#ifndef SEND_QUEUE_H
+#define SEND_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <netinet/in.h>
+
+#define SEND_QUEUE_MAX_DATAGRAMS 4096
+#define SEND_QUEUE_MAX_BYTES (4 << 20)
+
+// Bounded outbound queue for a UDP socket. Datagrams go straight to the
+// socket when nothing is queued ahead of them. A transient failure such as a
+// full socket buffer queues them instead, and flush() resends them once the
+// socket polls writable. When the queue is full, new datagrams are dropped
+// and counted, never blocking the caller. Datagrams the kernel rejects
+// outright, such as replies too large for UDP, are counted as failed.
+class SendQueue {
+public:
+    explicit SendQueue(int sock, size_t maxDatagrams = SEND_QUEUE_MAX_DATAGRAMS, size_t maxBytes = SEND_QUEUE_MAX_BYTES);
+
+    bool send(const void* data, size_t len, const sockaddr_in& to); // False when the datagram was lost
+    void flush();
+    bool pending() const;
+    bool congested() const; // More than half full; callers should shed load
+    void report(uint64_t nowMs, const char* name);
+    uint64_t sendCalls() const; // sendto() calls made so far
+
+private:
+    struct Pending {
+        sockaddr_in to;
+        std::string payload;
+    };
+
+    int sock;
+    size_t maxDatagrams;
+    size_t maxBytes;
+    std::deque<Pending> queue;
+    size_t queuedBytes;
+    uint64_t sent, deferred, dropped, failed;
+    uint64_t calls;
+    size_t peakDepth;
+    uint64_t lastReportMs;
+    mutable std::mutex mtx;
+
+    enum Result { SENT, RETRY, FAILED };
+    Result trySend(const void* data, size_t len, const sockaddr_in& to);
+};
+
+#endif // SEND_QUEUE_H
\ No newline at end of file
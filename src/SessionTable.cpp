@@ -0,0 +1,83 @@
+#include "SessionTable.h"
+
+SessionTable::SessionTable(size_t initialCapacity) : count(0) {
+    size_t capacity = 16;
+    while (capacity < initialCapacity) {
+        capacity <<= 1;
+    }
+    buckets.assign(capacity, Entry{0, NO_SESSION});
+    mask = capacity - 1;
+}
+
+uint32_t SessionTable::find(const Endpoint& endpoint) const {
+    uint64_t key = makeKey(endpoint);
+    size_t i = bucketFor(key);
+    while (buckets[i].key != 0) {
+        if (buckets[i].key == key) {
+            return buckets[i].token;
+        }
+        i = (i + 1) & mask;
+    }
+    return NO_SESSION;
+}
+
+void SessionTable::insert(const Endpoint& endpoint, uint32_t token) {
+    // Keep the load factor at or below one half
+    if ((count + 1) * 2 > buckets.size()) {
+        grow();
+    }
+
+    uint64_t key = makeKey(endpoint);
+    size_t i = bucketFor(key);
+    while (buckets[i].key != 0 && buckets[i].key != key) {
+        i = (i + 1) & mask;
+    }
+    if (buckets[i].key == 0) {
+        count++;
+    }
+    buckets[i].key = key;
+    buckets[i].token = token;
+}
+
+bool SessionTable::erase(const Endpoint& endpoint) {
+    uint64_t key = makeKey(endpoint);
+    size_t i = bucketFor(key);
+    while (buckets[i].key != key) {
+        if (buckets[i].key == 0) {
+            return false;
+        }
+        i = (i + 1) & mask;
+    }
+
+    // Backward-shift: pull later entries of the cluster into the hole when
+    // the hole lies between their home bucket and their current position
+    size_t hole = i;
+    for (size_t j = (hole + 1) & mask; buckets[j].key != 0; j = (j + 1) & mask) {
+        size_t home = bucketFor(buckets[j].key);
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            buckets[hole] = buckets[j];
+            hole = j;
+        }
+    }
+    buckets[hole].key = 0;
+    buckets[hole].token = NO_SESSION;
+    count--;
+    return true;
+}
+
+void SessionTable::grow() {
+    std::vector<Entry> old;
+    old.swap(buckets);
+    buckets.assign(old.size() * 2, Entry{0, NO_SESSION});
+    mask = buckets.size() - 1;
+    for (const Entry& entry : old) {
+        if (entry.key == 0) {
+            continue;
+        }
+        size_t i = bucketFor(entry.key);
+        while (buckets[i].key != 0) {
+            i = (i + 1) & mask;
+        }
+        buckets[i] = entry;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef SESSION_TABLE_H
+#define SESSION_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Binary (IPv4, port) endpoint of a datagram sender, both in network order
+struct Endpoint {
+    uint32_t addr;
+    uint16_t port;
+};
+
+// Open-addressing hash from sender endpoint to session token. Linear probing
+// with backward-shift deletion keeps probe sequences short without tombstones,
+// and lookups never allocate.
+class SessionTable {
+public:
+    static const uint32_t NO_SESSION = 0;
+
+    explicit SessionTable(size_t initialCapacity = 1024);
+
+    uint32_t find(const Endpoint& endpoint) const;
+    void insert(const Endpoint& endpoint, uint32_t token);
+    bool erase(const Endpoint& endpoint);
+    size_t size() const { return count; }
+
+    template <typename F>
+    void forEach(F visit) const {
+        for (const Entry& entry : buckets) {
+            if (entry.key != 0) {
+                Endpoint endpoint = {static_cast<uint32_t>(entry.key >> 16), static_cast<uint16_t>(entry.key)};
+                visit(endpoint, entry.token);
+            }
+        }
+    }
+
+private:
+    struct Entry {
+        uint64_t key; // 0 marks an empty bucket
+        uint32_t token;
+    };
+
+    std::vector<Entry> buckets;
+    size_t mask;
+    size_t count;
+
+    // The tag bit keeps every real key non-zero, even for 0.0.0.0:0
+    static uint64_t makeKey(const Endpoint& endpoint) {
+        return (1ull << 48) | (static_cast<uint64_t>(endpoint.addr) << 16) | endpoint.port;
+    }
+
+    size_t bucketFor(uint64_t key) const {
+        return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+    }
+
+    void grow();
+};
+
+#endif // SESSION_TABLE_H
\ No newline at end of file
@@ -0,0 +1,165 @@
+#ifndef SLOT_MAP_H
+#define SLOT_MAP_H
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+// Generational slot map: values live in a dense array, handles are 32-bit
+// (slot index in the low bits, generation in the high bits). Erasing bumps
+// the slot's generation so stale handles are rejected, and freed slots are
+// recycled through an intrusive free list, so once capacity is reached
+// insert/erase never allocate.
+template <typename T>
+class SlotMap {
+public:
+    typedef uint32_t Handle;
+
+    static const uint32_t SLOT_BITS = 20;
+    static const uint32_t MAX_SLOTS = 1u << SLOT_BITS;
+    static const uint32_t SLOT_MASK = MAX_SLOTS - 1;
+    static const uint32_t GENERATION_MASK = (1u << (32 - SLOT_BITS)) - 1;
+    static const Handle INVALID = 0; // generations start at 1, so 0 is never issued
+
+    typedef typename std::vector<T>::iterator iterator;
+    typedef typename std::vector<T>::const_iterator const_iterator;
+
+    SlotMap() : freeHead(NO_SLOT) {}
+
+    void reserve(size_t n) {
+        slots.reserve(n);
+        values.reserve(n);
+        denseToSlot.reserve(n);
+    }
+
+    Handle insert(const T& value) {
+        uint32_t slot;
+        if (freeHead != NO_SLOT) {
+            slot = freeHead;
+            freeHead = slots[slot].index;
+        } else {
+            if (slots.size() >= MAX_SLOTS) {
+                return INVALID;
+            }
+            slot = static_cast<uint32_t>(slots.size());
+            slots.push_back(Slot{1, 0});
+        }
+        slots[slot].index = static_cast<uint32_t>(values.size());
+        values.push_back(value);
+        denseToSlot.push_back(slot);
+        return makeHandle(slot, slots[slot].generation);
+    }
+
+    // Places a value under a handle issued by another SlotMap, as when
+    // replaying a replicated log. Fails if the slot is already occupied.
+    bool insertAt(Handle handle, const T& value) {
+        uint32_t slot = handle & SLOT_MASK;
+        uint32_t generation = handle >> SLOT_BITS;
+        if (generation == 0) {
+            return false;
+        }
+        while (slots.size() <= slot) {
+            uint32_t added = static_cast<uint32_t>(slots.size());
+            slots.push_back(Slot{1, freeHead});
+            freeHead = added;
+        }
+        if (!isFree(slot)) {
+            return false;
+        }
+
+        // Unlink the slot from the free list
+        if (freeHead == slot) {
+            freeHead = slots[slot].index;
+        } else {
+            uint32_t prev = freeHead;
+            while (slots[prev].index != slot) {
+                prev = slots[prev].index;
+            }
+            slots[prev].index = slots[slot].index;
+        }
+
+        slots[slot].generation = generation;
+        slots[slot].index = static_cast<uint32_t>(values.size());
+        values.push_back(value);
+        denseToSlot.push_back(slot);
+        return true;
+    }
+
+    T* get(Handle handle) {
+        uint32_t slot = handle & SLOT_MASK;
+        if (slot >= slots.size() || slots[slot].generation != (handle >> SLOT_BITS) || isFree(slot)) {
+            return nullptr;
+        }
+        return &values[slots[slot].index];
+    }
+
+    const T* get(Handle handle) const {
+        return const_cast<SlotMap*>(this)->get(handle);
+    }
+
+    bool erase(Handle handle) {
+        if (get(handle) == nullptr) {
+            return false;
+        }
+        uint32_t slot = handle & SLOT_MASK;
+        uint32_t index = slots[slot].index;
+        uint32_t last = static_cast<uint32_t>(values.size()) - 1;
+
+        // Swap-remove keeps the value array dense
+        if (index != last) {
+            values[index] = std::move(values[last]);
+            denseToSlot[index] = denseToSlot[last];
+            slots[denseToSlot[index]].index = index;
+        }
+        values.pop_back();
+        denseToSlot.pop_back();
+
+        slots[slot].generation = nextGeneration(slots[slot].generation);
+        slots[slot].index = freeHead;
+        freeHead = slot;
+        return true;
+    }
+
+    // Handle of the value stored at a dense position, for use while iterating
+    Handle handleAt(size_t denseIndex) const {
+        uint32_t slot = denseToSlot[denseIndex];
+        return makeHandle(slot, slots[slot].generation);
+    }
+
+    size_t size() const { return values.size(); }
+    bool empty() const { return values.empty(); }
+
+    iterator begin() { return values.begin(); }
+    iterator end() { return values.end(); }
+    const_iterator begin() const { return values.begin(); }
+    const_iterator end() const { return values.end(); }
+
+private:
+    static const uint32_t NO_SLOT = 0xFFFFFFFFu;
+
+    struct Slot {
+        uint32_t generation;
+        uint32_t index; // dense index while occupied, next free slot while free
+    };
+
+    std::vector<Slot> slots;
+    std::vector<T> values;
+    std::vector<uint32_t> denseToSlot;
+    uint32_t freeHead;
+
+    static Handle makeHandle(uint32_t slot, uint32_t generation) {
+        return (generation << SLOT_BITS) | slot;
+    }
+
+    static uint32_t nextGeneration(uint32_t generation) {
+        generation = (generation + 1) & GENERATION_MASK;
+        return generation == 0 ? 1 : generation;
+    }
+
+    bool isFree(uint32_t slot) const {
+        uint32_t index = slots[slot].index;
+        return index >= denseToSlot.size() || denseToSlot[index] != slot;
+    }
+};
+
+#endif // SLOT_MAP_H
@@ -0,0 +1,86 @@
+#include "Strategy.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+StrategyLayout::StrategyLayout(int valueCount, int handSize)
+    : valueCount(valueCount), handSize(handSize), total(0) {
+    memset(binom, 0, sizeof(binom));
+    for (int n = 0; n < STRATEGY_MAX_VALUES + STRATEGY_MAX_HAND; ++n) {
+        binom[n][0] = 1;
+        for (int r = 1; r < STRATEGY_MAX_HAND + 2 && r <= n; ++r) {
+            binom[n][r] = binom[n - 1][r - 1] + (r < n ? binom[n - 1][r] : 0);
+        }
+    }
+    // Multisets of k values out of valueCount: C(valueCount + k - 1, k)
+    for (int k = 0; k <= handSize; ++k) {
+        base[k] = total;
+        total += k == 0 ? 1 : binom[valueCount + k - 1][k];
+    }
+    base[handSize + 1] = total;
+}
+
+StrategyTable::StrategyTable()
+    : map(nullptr), mapSize(0), head(nullptr), takeTable(nullptr), drawnTable(nullptr), expectedTable(nullptr) {
+}
+
+StrategyTable::~StrategyTable() {
+    if (map != nullptr) {
+        munmap(map, mapSize);
+    }
+}
+
+bool StrategyTable::load(const std::string& path, std::string& error) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(StrategyHeader)) {
+        close(fd);
+        error = path + " is not a strategy file";
+        return false;
+    }
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        error = "cannot map " + path;
+        return false;
+    }
+
+    const StrategyHeader* header = static_cast<const StrategyHeader*>(mapped);
+    bool valid = memcmp(header->magic, STRATEGY_MAGIC, sizeof(header->magic)) == 0 && header->valueCount > 0 &&
+                 header->valueCount <= STRATEGY_MAX_VALUES && header->handSize > 0 &&
+                 header->handSize <= STRATEGY_MAX_HAND;
+    StrategyLayout shape;
+    if (valid) {
+        shape = StrategyLayout(header->valueCount, header->handSize);
+        size_t tables = static_cast<size_t>(shape.states()) * header->valueCount;
+        valid = header->states == shape.states() &&
+                static_cast<size_t>(st.st_size) == sizeof(StrategyHeader) + 2 * tables + shape.states() * sizeof(float);
+    }
+    if (!valid) {
+        munmap(mapped, st.st_size);
+        error = path + " is not a strategy file";
+        return false;
+    }
+
+    // The tables are small next to a bot's lifetime; fault them in now
+    madvise(mapped, st.st_size, MADV_WILLNEED);
+    if (map != nullptr) {
+        munmap(map, mapSize);
+    }
+    map = mapped;
+    mapSize = st.st_size;
+    head = header;
+    layout = shape;
+    const uint8_t* bytes = static_cast<const uint8_t*>(mapped) + sizeof(StrategyHeader);
+    size_t tables = static_cast<size_t>(shape.states()) * header->valueCount;
+    expectedTable = reinterpret_cast<const float*>(bytes);
+    takeTable = bytes + shape.states() * sizeof(float);
+    drawnTable = takeTable + tables;
+    return true;
+}
\ No newline at end of file
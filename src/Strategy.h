@@ -0,0 +1,156 @@
+#ifndef STRATEGY_H
+#define STRATEGY_H
+
+#include "GameLogic.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#define STRATEGY_MAGIC "GOLFSTR1"
+#define STRATEGY_MAX_VALUES 16
+#define STRATEGY_MAX_HAND GOLF_MAX_HAND // Largest grid of any variant
+
+#define STRATEGY_CHECK_HAND(name, rows, cols, faceUp, scoring) \
+    static_assert((rows) * (cols) <= STRATEGY_MAX_HAND, "the " #name " hand does not fit a strategy table");
+GOLF_VARIANT_LIST(STRATEGY_CHECK_HAND)
+#undef STRATEGY_CHECK_HAND
+
+// Decision codes. Below the variant's value count, a code means "replace a
+// face-up card of that value index".
+#define STRATEGY_REPLACE_FACE_DOWN 0xFD
+#define STRATEGY_FLIP 0xFE               // Discard the drawn card and turn one over
+#define STRATEGY_DRAW 0xFF               // Leave the discard and draw from the deck
+
+// A strategy file is this header followed by the expected score of every
+// state as a float, then the take and drawn tables, one byte per state and
+// card value each. A state is the multiset of face-up card values
+// in a hand; the number of face-down cards is what remains of the grid.
+// Card positions are not part of the state, which is exact for scoring
+// without column bonuses and an approximation otherwise.
+struct StrategyHeader {
+    char magic[8];
+    char variant[16];
+    int32_t handSize;
+    int32_t valueCount;
+    int32_t values[STRATEGY_MAX_VALUES]; // Ascending
+    int8_t rankToValue[16];              // Card rank -> value index
+    float hazard;                        // Chance per turn that another player ends the hole
+    uint32_t states;
+};
+
+static_assert(sizeof(StrategyHeader) % sizeof(float) == 0, "expected scores must follow the header aligned");
+
+// Numbers the multisets of up to handSize face-up values densely: states
+// with fewer face-up cards come first, and within a count the sorted
+// values rank in the combinatorial number system.
+class StrategyLayout {
+public:
+    StrategyLayout() : valueCount(0), handSize(0), total(0) {}
+    StrategyLayout(int valueCount, int handSize);
+
+    uint32_t states() const { return total; }
+    uint32_t levelStart(int faceUp) const { return base[faceUp]; }
+
+    // counts[i] face-up cards of value index i
+    uint32_t index(const uint8_t* counts) const {
+        uint32_t rank = 0;
+        int position = 0;
+        for (int v = 0; v < valueCount; ++v) {
+            for (int n = counts[v]; n > 0; --n, ++position) {
+                rank += binom[v + position][position + 1];
+            }
+        }
+        return base[position] + rank;
+    }
+
+private:
+    int valueCount;
+    int handSize;
+    uint32_t total;
+    uint32_t base[STRATEGY_MAX_HAND + 2];
+    uint32_t binom[STRATEGY_MAX_VALUES + STRATEGY_MAX_HAND][STRATEGY_MAX_HAND + 2];
+};
+
+// A strategy file mapped read-only. Every decision is one table lookup
+// after counting the hand's face-up values, and makes no allocation.
+class StrategyTable {
+public:
+    StrategyTable();
+    ~StrategyTable();
+
+    bool load(const std::string& path, std::string& error);
+    bool loaded() const { return head != nullptr; }
+    const StrategyHeader& header() const { return *head; }
+
+    // Whether the file was generated for this engine's grid and scoring
+    template <class Engine>
+    bool fits() const {
+        if (head == nullptr || head->handSize != Engine::handSize) {
+            return false;
+        }
+        for (int rank = 2; rank <= 14; ++rank) {
+            int v = head->rankToValue[rank];
+            if (v < 0 || v >= head->valueCount || head->values[v] != Engine::cardValue(rank)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Slot to replace with the discard, or -1 to draw from the deck
+    template <class Engine>
+    int take(const typename Engine::Hand& hand, const Card& discard) const {
+        uint8_t code = takeTable[stateOf<Engine>(hand) * head->valueCount + head->rankToValue[discard.rank]];
+        return code == STRATEGY_DRAW ? -1 : slotFor<Engine>(hand, code);
+    }
+
+    // Slot to replace with a card drawn from the deck, or -1 to discard it
+    // and turn a face-down card over
+    template <class Engine>
+    int keep(const typename Engine::Hand& hand, const Card& drawn) const {
+        uint8_t code = drawnTable[stateOf<Engine>(hand) * head->valueCount + head->rankToValue[drawn.rank]];
+        return code == STRATEGY_FLIP ? -1 : slotFor<Engine>(hand, code);
+    }
+
+    // Expected final score of the hand at the start of its turn
+    template <class Engine>
+    float expected(const typename Engine::Hand& hand) const {
+        return expectedTable[stateOf<Engine>(hand)];
+    }
+
+private:
+    void* map;
+    size_t mapSize;
+    const StrategyHeader* head;
+    const uint8_t* takeTable;
+    const uint8_t* drawnTable;
+    const float* expectedTable;
+    StrategyLayout layout;
+
+    template <class Engine>
+    uint32_t stateOf(const typename Engine::Hand& hand) const {
+        uint8_t counts[STRATEGY_MAX_VALUES] = {0};
+        for (int i = 0; i < Engine::handSize; ++i) {
+            if (hand[i].faceUp) {
+                counts[head->rankToValue[hand[i].rank]]++;
+            }
+        }
+        return layout.index(counts);
+    }
+
+    template <class Engine>
+    int slotFor(const typename Engine::Hand& hand, uint8_t code) const {
+        for (int i = 0; i < Engine::handSize; ++i) {
+            if (code == STRATEGY_REPLACE_FACE_DOWN ? !hand[i].faceUp
+                                                   : hand[i].faceUp && head->rankToValue[hand[i].rank] == code) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    StrategyTable(const StrategyTable&);
+    StrategyTable& operator=(const StrategyTable&);
+};
+
+#endif // STRATEGY_H
\ No newline at end of file
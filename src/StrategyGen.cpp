@@ -0,0 +1,276 @@
+// Solves each golf variant's turn decisions offline and writes a strategy
+// file per variant, <directory>/<variant>.strategy, for bots to map at
+// startup. A bot's own hand is a Markov decision process: each turn it may
+// take the discard into any slot or draw, and a drawn card may replace any
+// slot or be discarded for a face-down card to turn over. The hole ends
+// when the hand is all face up, or before any turn with the given hazard,
+// when another player goes out; the face-up cards then score as in
+// calculateScore(). Discards and draws are modelled as random cards. The
+// expected final score of every state is found by value iteration, from
+// all-face-up hands back to the deal, and the best move is tabulated.
+//
+// Usage: StrategyGen [variant|all] [directory] [hazard]
+
+#include "Strategy.h"
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+#define SOLVE_TOLERANCE 1e-9
+#define SOLVE_MAX_ITERATIONS 100000
+#define TIMED_DECISIONS 4000000
+
+typedef std::chrono::steady_clock Clock;
+typedef std::array<uint8_t, STRATEGY_MAX_VALUES> Counts;
+
+// Visits every multiset of at most handSize values once, in non-decreasing
+// order from value on
+static void enumerate(const StrategyLayout& layout, int valueCount, int handSize, int value, int size, Counts& counts,
+                      std::vector<Counts>& states) {
+    states[layout.index(counts.data())] = counts;
+    if (size == handSize) {
+        return;
+    }
+    for (int v = value; v < valueCount; ++v) {
+        counts[v]++;
+        enumerate(layout, valueCount, handSize, v, size + 1, counts, states);
+        counts[v]--;
+    }
+}
+
+struct Solver {
+    std::string directory;
+    double hazard;
+    const char* variant;
+    bool failed;
+
+    template <class Engine>
+    void run() {
+        // Distinct card values, and the chance that a card has each
+        std::vector<int> values;
+        for (int rank = 2; rank <= 14; ++rank) {
+            if (std::find(values.begin(), values.end(), Engine::cardValue(rank)) == values.end()) {
+                values.push_back(Engine::cardValue(rank));
+            }
+        }
+        std::sort(values.begin(), values.end());
+        const int m = static_cast<int>(values.size());
+        const int handSize = Engine::handSize;
+        double chance[STRATEGY_MAX_VALUES] = {0};
+        int8_t rankToValue[16];
+        memset(rankToValue, -1, sizeof(rankToValue));
+        for (int rank = 2; rank <= 14; ++rank) {
+            int v = static_cast<int>(std::find(values.begin(), values.end(), Engine::cardValue(rank)) - values.begin());
+            rankToValue[rank] = static_cast<int8_t>(v);
+            chance[v] += 1.0 / 13;
+        }
+
+        StrategyLayout layout(m, handSize);
+        const uint32_t n = layout.states();
+        std::vector<Counts> states(n);
+        Counts counts;
+        counts.fill(0);
+        enumerate(layout, m, handSize, 0, 0, counts, states);
+
+        // Where each move leads: a face-up value swapped for another, or a
+        // face-down card replaced by a value
+        const uint32_t none = UINT32_MAX;
+        std::vector<uint32_t> swapTo(static_cast<size_t>(n) * m * m, none);
+        std::vector<uint32_t> addTo(static_cast<size_t>(n) * m, none);
+        std::vector<int> faceUp(n), score(n);
+        for (uint32_t s = 0; s < n; ++s) {
+            Counts c = states[s];
+            for (int v = 0; v < m; ++v) {
+                faceUp[s] += c[v];
+                score[s] += c[v] * values[v];
+            }
+            for (int y = 0; y < m; ++y) {
+                if (faceUp[s] < handSize) {
+                    c[y]++;
+                    addTo[static_cast<size_t>(s) * m + y] = layout.index(c.data());
+                    c[y]--;
+                }
+                for (int x = 0; x < m; ++x) {
+                    if (c[x] > 0) {
+                        c[x]--;
+                        c[y]++;
+                        swapTo[(static_cast<size_t>(s) * m + x) * m + y] = layout.index(c.data());
+                        c[y]--;
+                        c[x]++;
+                    }
+                }
+            }
+        }
+
+        // after[s]: expected final score once a move has left the hand in s
+        std::vector<double> after(n), turn(n), flip(n), draw(n);
+        const double inf = std::numeric_limits<double>::infinity();
+        auto bestSwap = [&](uint32_t s, int card) {
+            double best = inf;
+            for (int x = 0; x < m; ++x) {
+                uint32_t to = swapTo[(static_cast<size_t>(s) * m + x) * m + card];
+                if (to != none) {
+                    best = std::min(best, after[to]);
+                }
+            }
+            return best;
+        };
+        int iterations = 0;
+        for (uint32_t s = layout.levelStart(handSize); s < n; ++s) {
+            after[s] = turn[s] = score[s];
+        }
+        for (int k = handSize - 1; k >= 0; --k) {
+            uint32_t first = layout.levelStart(k), last = layout.levelStart(k + 1);
+            for (uint32_t s = first; s < last; ++s) {
+                flip[s] = 0;
+                for (int r = 0; r < m; ++r) {
+                    flip[s] += chance[r] * after[addTo[static_cast<size_t>(s) * m + r]];
+                }
+                after[s] = score[s];
+            }
+            double delta = inf;
+            for (int i = 0; i < SOLVE_MAX_ITERATIONS && delta > SOLVE_TOLERANCE; ++i, ++iterations) {
+                delta = 0;
+                for (uint32_t s = first; s < last; ++s) {
+                    double drawn = 0;
+                    for (int c = 0; c < m; ++c) {
+                        double faceDown = after[addTo[static_cast<size_t>(s) * m + c]];
+                        drawn += chance[c] * std::min(std::min(bestSwap(s, c), faceDown), flip[s]);
+                    }
+                    double start = 0;
+                    for (int t = 0; t < m; ++t) {
+                        double faceDown = after[addTo[static_cast<size_t>(s) * m + t]];
+                        start += chance[t] * std::min(std::min(bestSwap(s, t), faceDown), drawn);
+                    }
+                    double next = hazard * score[s] + (1 - hazard) * start;
+                    delta = std::max(delta, std::fabs(next - after[s]));
+                    after[s] = next;
+                    turn[s] = start;
+                    draw[s] = drawn;
+                }
+            }
+        }
+
+        // Ties go to the first option: higher face-up values, then a
+        // face-down card, then drawing or turning a card over
+        std::vector<uint8_t> takeTable(static_cast<size_t>(n) * m), drawnTable(static_cast<size_t>(n) * m);
+        std::vector<float> expected(n);
+        for (uint32_t s = 0; s < n; ++s) {
+            expected[s] = static_cast<float>(turn[s]);
+            for (int card = 0; card < m; ++card) {
+                uint8_t& take = takeTable[static_cast<size_t>(s) * m + card];
+                uint8_t& keep = drawnTable[static_cast<size_t>(s) * m + card];
+                take = STRATEGY_DRAW;
+                keep = STRATEGY_FLIP;
+                if (faceUp[s] == handSize) {
+                    continue; // The hole is over
+                }
+                double best = inf;
+                uint8_t code = STRATEGY_DRAW;
+                for (int x = m - 1; x >= 0; --x) {
+                    uint32_t to = swapTo[(static_cast<size_t>(s) * m + x) * m + card];
+                    if (to != none && after[to] < best) {
+                        best = after[to];
+                        code = static_cast<uint8_t>(x);
+                    }
+                }
+                if (after[addTo[static_cast<size_t>(s) * m + card]] < best) {
+                    best = after[addTo[static_cast<size_t>(s) * m + card]];
+                    code = STRATEGY_REPLACE_FACE_DOWN;
+                }
+                take = draw[s] < best ? STRATEGY_DRAW : code;
+                keep = flip[s] < best ? STRATEGY_FLIP : code;
+            }
+        }
+
+        StrategyHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, STRATEGY_MAGIC, sizeof(header.magic));
+        strncpy(header.variant, variant, sizeof(header.variant) - 1);
+        header.handSize = handSize;
+        header.valueCount = m;
+        for (int v = 0; v < m; ++v) {
+            header.values[v] = values[v];
+        }
+        memcpy(header.rankToValue, rankToValue, sizeof(rankToValue));
+        header.hazard = static_cast<float>(hazard);
+        header.states = n;
+
+        std::string path = directory + "/" + variant + ".strategy";
+        FILE* out = fopen(path.c_str(), "wb");
+        if (out == nullptr || fwrite(&header, sizeof(header), 1, out) != 1 ||
+            fwrite(expected.data(), sizeof(float), n, out) != n ||
+            fwrite(takeTable.data(), 1, takeTable.size(), out) != takeTable.size() ||
+            fwrite(drawnTable.data(), 1, drawnTable.size(), out) != drawnTable.size() || fclose(out) != 0) {
+            fprintf(stderr, "%s: cannot write %s\n", variant, path.c_str());
+            failed = true;
+            return;
+        }
+        report<Engine>(path, iterations);
+    }
+
+    // Maps the written file back and times decisions on random dealt hands
+    template <class Engine>
+    void report(const std::string& path, int iterations) {
+        StrategyTable table;
+        std::string error;
+        if (!table.load(path, error) || !table.fits<Engine>()) {
+            fprintf(stderr, "%s: %s\n", variant, error.empty() ? "written table does not fit the engine" : error.c_str());
+            failed = true;
+            return;
+        }
+        Engine game(1, 1, 7);
+        typename Engine::Hand hand = game.getHand(0);
+        std::mt19937 rng(11);
+        std::vector<typename Engine::Hand> hands(1024, hand);
+        std::vector<Card> cards(1024);
+        double dealt = 0;
+        for (size_t i = 0; i < hands.size(); ++i) {
+            for (Card& card : hands[i]) {
+                card.rank = 2 + rng() % 13;
+                card.faceUp = rng() % 2;
+            }
+            cards[i].rank = 2 + rng() % 13;
+            Engine deal(1, 1, static_cast<uint32_t>(i));
+            dealt += table.expected<Engine>(deal.getHand(0));
+        }
+
+        int sink = 0;
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < TIMED_DECISIONS; ++i) {
+            sink += table.take<Engine>(hands[i & 1023], cards[(i >> 10) & 1023]);
+        }
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / TIMED_DECISIONS;
+        printf("%-12s %7u states %9zu bytes %7d sweeps  expected hole score %6.2f  %5.1f ns/decision%s\n", variant,
+               table.header().states, static_cast<size_t>(sizeof(StrategyHeader) + table.header().states *
+               (sizeof(float) + 2 * table.header().valueCount)), iterations, dealt / hands.size(), ns,
+               sink == 42 ? " " : "");
+    }
+};
+
+int main(int argc, char* argv[]) {
+    std::string variant = argc > 1 ? argv[1] : "all";
+    Solver solver;
+    solver.directory = argc > 2 ? argv[2] : ".";
+    solver.hazard = argc > 3 ? atof(argv[3]) : 0.1;
+    solver.failed = false;
+    int only = variant == "all" ? -1 : findGolfVariant(variant);
+    if ((variant != "all" && only < 0) || solver.hazard <= 0 || solver.hazard >= 1) {
+        fprintf(stderr, "Usage: %s [variant|all] [directory] [hazard 0-1]\n", argv[0]);
+        return 1;
+    }
+
+    for (int i = 0; i < golfVariantCount(); ++i) {
+        if (only < 0 || only == i) {
+            solver.variant = golfVariant(i).name;
+            visitGolfVariant(i, solver);
+        }
+    }
+    return solver.failed ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include "Trace.h"
+
+#ifdef GOLF_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+struct TraceBuffer {
+    long tid;
+    std::atomic<uint64_t> written; // Events ever recorded; the ring holds the last TRACE_BUFFER_EVENTS
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+};
+
+thread_local bool traceSampled = false;
+
+static thread_local TraceBuffer* localBuffer = nullptr;
+static thread_local uint64_t sampleState = 0;
+
+static std::mutex traceMutex; // Guards the buffer list and exports
+static std::vector<TraceBuffer*> traceBuffers;
+static std::string traceProcess;
+static std::string tracePath;
+static double sampleRate = TRACE_DEFAULT_SAMPLE;
+static double ticksPerUs = 1000;   // TSC ticks per microsecond, calibrated in traceInit()
+static uint64_t baseTicks = 0;     // A TSC reading ...
+static double baseMonotonicUs = 0; // ... and CLOCK_MONOTONIC at the same moment
+static volatile sig_atomic_t exportRequested = 0;
+static volatile sig_atomic_t stopRequested = 0;
+
+static double monotonicUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+uint64_t traceNow() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(monotonicUs() * 1000);
+#endif
+}
+
+static void onExportSignal(int) {
+    exportRequested = 1;
+}
+
+static void onStopSignal(int) {
+    stopRequested = 1;
+}
+
+static void exportAtExit() {
+    traceExport(tracePath.c_str());
+}
+
+// Reads GOLF_TRACE_SAMPLE (a fraction of requests, 0-1) and GOLF_TRACE_FILE
+// (default <process>-<pid>.trace.json), and calibrates the TSC against
+// CLOCK_MONOTONIC over 20 ms. SIGINT and SIGTERM are only caught when the
+// caller's loop polls for them.
+void traceInit(const char* process, bool stopOnPoll) {
+    traceProcess = process;
+    const char* rate = getenv("GOLF_TRACE_SAMPLE");
+    if (rate != nullptr) {
+        sampleRate = atof(rate);
+    }
+    const char* path = getenv("GOLF_TRACE_FILE");
+    tracePath = path != nullptr ? path : traceProcess + "-" + std::to_string(getpid()) + ".trace.json";
+
+    uint64_t ticks0 = traceNow();
+    double us0 = monotonicUs();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    baseTicks = traceNow();
+    baseMonotonicUs = monotonicUs();
+    ticksPerUs = (baseTicks - ticks0) / (baseMonotonicUs - us0);
+
+    struct sigaction sa;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sa.sa_handler = onExportSignal;
+    sigaction(SIGUSR1, &sa, nullptr);
+    if (stopOnPoll) {
+        sa.sa_handler = onStopSignal;
+        sigaction(SIGINT, &sa, nullptr);
+        sigaction(SIGTERM, &sa, nullptr);
+    }
+    atexit(exportAtExit);
+    printf("trace: sampling %.4g of requests into %s (SIGUSR1 writes it now)\n", sampleRate, tracePath.c_str());
+}
+
+// xorshift64*, seeded per thread, so sampling takes no lock
+bool traceSample() {
+    if (sampleState == 0) {
+        sampleState = (static_cast<uint64_t>(syscall(SYS_gettid)) << 32) ^ traceNow() ^ 0x9E3779B97F4A7C15ull;
+    }
+    sampleState ^= sampleState >> 12;
+    sampleState ^= sampleState << 25;
+    sampleState ^= sampleState >> 27;
+    double draw = ((sampleState * 2685821657736338717ull) >> 11) * (1.0 / 9007199254740992.0);
+    traceSampled = draw < sampleRate;
+    return traceSampled;
+}
+
+void traceRecord(const char* name, const char* detail, uint64_t start, uint64_t end) {
+    if (localBuffer == nullptr) {
+        localBuffer = new TraceBuffer();
+        localBuffer->tid = syscall(SYS_gettid);
+        localBuffer->written = 0;
+        std::lock_guard<std::mutex> lock(traceMutex);
+        traceBuffers.push_back(localBuffer);
+    }
+    uint64_t index = localBuffer->written.load(std::memory_order_relaxed);
+    TraceEvent& event = localBuffer->events[index % TRACE_BUFFER_EVENTS];
+    event.name = name;
+    event.detail = detail;
+    event.start = start;
+    event.end = end;
+    localBuffer->written.store(index + 1, std::memory_order_release);
+}
+
+// Called from the owner's event loop: signals only set flags. Returns true
+// once a stop was requested; the loop ends rather than exiting here, while
+// other threads may still be running.
+bool tracePoll() {
+    if (exportRequested) {
+        exportRequested = 0;
+        traceExport(tracePath.c_str());
+    }
+    return stopRequested != 0;
+}
+
+static double toMonotonicUs(uint64_t ticks) {
+    return baseMonotonicUs + (static_cast<int64_t>(ticks - baseTicks)) / ticksPerUs;
+}
+
+// Writes every buffered span as a Chrome "complete" event. Spans a thread
+// records while the export runs may be missing or, once its ring wraps,
+// replaced by newer ones.
+bool traceExport(const char* path) {
+    std::lock_guard<std::mutex> lock(traceMutex);
+    FILE* out = fopen(path, "w");
+    if (out == nullptr) {
+        perror("trace: fopen() failed");
+        return false;
+    }
+    int pid = getpid();
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"%s\"}}", pid,
+            traceProcess.c_str());
+    size_t count = 0;
+    for (TraceBuffer* buffer : traceBuffers) {
+        uint64_t written = buffer->written.load(std::memory_order_acquire);
+        uint64_t first = written > TRACE_BUFFER_EVENTS ? written - TRACE_BUFFER_EVENTS : 0;
+        for (uint64_t i = first; i < written; ++i) {
+            const TraceEvent& event = buffer->events[i % TRACE_BUFFER_EVENTS];
+            double start = toMonotonicUs(event.start);
+            fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"golf\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%ld",
+                    event.name, start, toMonotonicUs(event.end) - start, pid, buffer->tid);
+            if (event.detail != nullptr) {
+                fprintf(out, ",\"args\":{\"detail\":\"%s\"}", event.detail);
+            }
+            fprintf(out, "}");
+            count++;
+        }
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+    printf("trace: wrote %zu spans to %s\n", count, path);
+    return true;
+}
+
+#endif // GOLF_TRACE
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+
+#define TRACE_BUFFER_EVENTS 65536   // Per thread; once full, the oldest events are overwritten
+#define TRACE_DEFAULT_SAMPLE 0.01   // Fraction of requests traced unless GOLF_TRACE_SAMPLE says otherwise
+
+// Span tracing, compiled in with `make TRACE=1` and absent otherwise.
+// Spans are stamped with the TSC and kept in per-thread ring buffers, so a
+// span costs two rdtsc reads and a store into memory only its own thread
+// writes. traceSample() decides once per request whether the spans that
+// follow on that thread are recorded. Timestamps are converted to
+// CLOCK_MONOTONIC, so traces of processes on one host line up. The trace
+// is written as Chrome trace JSON, which Perfetto also reads, on SIGUSR1
+// and at exit. A server whose event loop calls TRACE_POLL() passes
+// stopOnPoll, and SIGINT and SIGTERM then make TRACE_POLL() return true so
+// the loop can end and main() return, writing the trace. Other programs
+// keep the default action for those signals.
+#ifdef GOLF_TRACE
+
+struct TraceEvent {
+    const char* name;
+    const char* detail; // Optional, shown as the span's argument
+    uint64_t start;
+    uint64_t end;
+};
+
+extern thread_local bool traceSampled;
+
+void traceInit(const char* process, bool stopOnPoll);
+bool traceSample();
+uint64_t traceNow();
+void traceRecord(const char* name, const char* detail, uint64_t start, uint64_t end);
+bool tracePoll();
+bool traceExport(const char* path);
+
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, const char* detail = nullptr)
+        : name(name), detail(detail), start(traceSampled ? traceNow() : 0) {}
+    ~TraceSpan() {
+        if (start != 0) {
+            traceRecord(name, detail, start, traceNow());
+        }
+    }
+
+private:
+    const char* name;
+    const char* detail;
+    uint64_t start;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_INIT(process, stopOnPoll) traceInit(process, stopOnPoll)
+#define TRACE_SAMPLE() traceSample()
+#define TRACE_SCOPE(name) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(name)
+#define TRACE_SCOPE_DETAIL(name, detail) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(name, detail)
+#define TRACE_POLL() tracePoll()
+
+#else
+
+#define TRACE_INIT(process, stopOnPoll) do {} while (0)
+#define TRACE_SAMPLE() ((void) 0)
+#define TRACE_SCOPE(name) do {} while (0)
+#define TRACE_SCOPE_DETAIL(name, detail) do {} while (0)
+#define TRACE_POLL() false
+
+#endif // GOLF_TRACE
+
+#endif // TRACE_H
\ No newline at end of file
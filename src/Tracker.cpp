@@ -1,147 +1,893 @@
 #include "Tracker.h"
+#include "GameLogic.h"
+#include "Trace.h"
 #include <cstdio>
 #include <cstdlib>
 #include <sstream>
 #include <algorithm>
 #include <chrono>
+#include <cmath>
 
-Tracker::Tracker() : nextGameId(1) {
+Tracker::Tracker() : remotePlayers(0), mutationLog(nullptr), changeJournal(nullptr) {
     unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
     rng.seed(seed);
 }
 
+PlayerInfo* Tracker::findPlayer(const std::string& name) {
+    auto it = playerIndex.find(name);
+    if (it == playerIndex.end()) {
+        return nullptr;
+    }
+    return players.get(it->second);
+}
+
+void Tracker::logPlayer(char kind, uint32_t handle, const PlayerInfo& player) {
+    if (mutationLog != nullptr) {
+        std::stringstream ss;
+        ss << kind << " " << handle << " " << player.name << " " << player.ipAddress << " " << player.tPort << " " << player.pPort;
+        mutationLog->append(ss.str());
+    }
+}
+
+void Tracker::logGame(const GameInfo& game) {
+    if (mutationLog != nullptr) {
+        std::stringstream ss;
+        ss << "S " << game.gameId << " " << game.holes << " " << game.dealer << " " << game.numPlayers;
+        for (int i = 0; i < game.numPlayers; ++i) {
+            ss << " " << game.players[i];
+        }
+        ss << " " << golfVariant(game.variant).name;
+        mutationLog->append(ss.str());
+    }
+}
+
+void Tracker::logState(const PlayerInfo& player) {
+    if (mutationLog != nullptr) {
+        mutationLog->append("T " + std::to_string(playerHandle(player.name)) + " " + player.state);
+    }
+    journalPlayer(player);
+}
+
+// The change journal holds listing rows keyed by name or game ID, unlike
+// the mutation log's registry handles: "P + <name> <ip> <t_port> <p_port>
+// <state>", "P - <name>", "G + <id> <dealer> <holes> <count> <name>...",
+// "G - <id>". Other nodes' players are not listed, so not journalled.
+void Tracker::journal(const std::string& change) {
+    if (changeJournal != nullptr) {
+        uint64_t head = changeJournal->append(change);
+        if (head - changeJournal->tail() >= CHANGE_JOURNAL_MAX) {
+            changeJournal->trim(head - CHANGE_JOURNAL_MAX);
+        }
+    }
+}
+
+void Tracker::journalPlayer(const PlayerInfo& player) {
+    if (changeJournal != nullptr && !player.remote) {
+        journal("P + " + player.name + " " + player.ipAddress + " " + std::to_string(player.tPort) + " " +
+                std::to_string(player.pPort) + " " + player.state);
+    }
+}
+
+void Tracker::journalPlayerGone(const PlayerInfo& player) {
+    if (changeJournal != nullptr && !player.remote) {
+        journal("P - " + player.name);
+    }
+}
+
+void Tracker::journalGame(const GameInfo& game) {
+    if (changeJournal != nullptr) {
+        std::string change = "G + " + std::to_string(game.gameId) + " " + players.get(game.dealer)->name + " " +
+                             std::to_string(game.holes) + " " + std::to_string(game.numPlayers);
+        for (int i = 0; i < game.numPlayers; ++i) {
+            change += " " + players.get(game.players[i])->name;
+        }
+        journal(change);
+    }
+}
+
+// Every state change goes through here to keep the search index current
+void Tracker::setState(uint32_t handle, PlayerInfo& player, const std::string& state) {
+    if (player.state == state) {
+        return;
+    }
+    std::string from = player.state;
+    player.state = state;
+    if (state != "free") {
+        player.matchTicket = 0; // Only free players wait in the matchmaking queue
+    }
+    if (!player.remote) {
+        search.changeState(handle, player, from);
+    }
+}
+
+void Tracker::setGamePlayersState(const GameInfo& game, const std::string& state) {
+    for (int i = 0; i < game.numPlayers; ++i) {
+        setState(game.players[i], *players.get(game.players[i]), state);
+        journalPlayer(*players.get(game.players[i]));
+    }
+    setState(game.dealer, *players.get(game.dealer), state);
+    journalPlayer(*players.get(game.dealer));
+}
+
 std::string Tracker::registerPlayer(const std::string& name, const std::string& ipAddress, int tPort, int pPort) {
-    if (players.find(name) != players.end()) {
+    TRACE_SCOPE("Tracker::registerPlayer");
+    if (playerIndex.find(name) != playerIndex.end()) {
         return "FAILURE Player already registered";
     }
-    PlayerInfo newPlayer = {name, ipAddress, "free", tPort, pPort, std::vector<Card>()};
-    players[name] = newPlayer;
+    PlayerInfo player(name, ipAddress, "free", tPort, pPort);
+    uint32_t handle = players.insert(player);
+    if (handle == SlotMap<PlayerInfo>::INVALID) {
+        return "FAILURE Player registry is full";
+    }
+    playerIndex[name] = handle;
+    search.add(handle, player);
+    logPlayer('R', handle, player);
+    journalPlayer(player);
     return "SUCCESS";
 }
 
 std::string Tracker::deregisterPlayer(const std::string& name) {
-    if (players.find(name) == players.end()) {
+    TRACE_SCOPE("Tracker::deregisterPlayer");
+    auto it = playerIndex.find(name);
+    if (it == playerIndex.end()) {
         return "FAILURE Player not registered";
     }
-    if (players[name].state == "in-play") {
+    if (players.get(it->second)->state == "in-play") {
         return "FAILURE Player is currently in a game";
     }
-    players.erase(name);
+    if (mutationLog != nullptr) {
+        mutationLog->append("D " + std::to_string(it->second));
+    }
+    journalPlayerGone(*players.get(it->second));
+    setRating(it->second, *players.get(it->second), 0, 0);
+    search.remove(it->second, *players.get(it->second));
+    players.erase(it->second);
+    playerIndex.erase(it);
     return "SUCCESS";
 }
 
 std::string Tracker::queryPlayers() {
+    TRACE_SCOPE("Tracker::queryPlayers");
     std::stringstream ss;
-    ss << "SUCCESS " << players.size() << " ";
-    for (const auto& pair : players) {
-        const PlayerInfo& player = pair.second;
+    ss << "SUCCESS " << (players.size() - remotePlayers) << " ";
+    for (const PlayerInfo& player : players) {
+        if (player.remote) {
+            continue;
+        }
+        ss << player.name << " " << player.ipAddress << " " << player.tPort << " " << player.pPort << " " << player.state << " ";
+    }
+    return ss.str();
+}
+
+// Local players matching every given filter, listed like queryPlayers()
+std::string Tracker::queryPlayers(const PlayerSearch::Filter& filter) {
+    TRACE_SCOPE("Tracker::queryPlayers filtered");
+    std::vector<uint32_t> matches;
+    search.find(filter, players, matches);
+    std::stringstream ss;
+    ss << "SUCCESS " << matches.size() << " ";
+    for (uint32_t handle : matches) {
+        const PlayerInfo& player = *players.get(handle);
         ss << player.name << " " << player.ipAddress << " " << player.tPort << " " << player.pPort << " " << player.state << " ";
     }
     return ss.str();
 }
 
 std::string Tracker::queryGames() {
+    TRACE_SCOPE("Tracker::queryGames");
     std::stringstream ss;
     ss << "SUCCESS " << games.size() << " ";
-    for (const auto& pair : games) {
-        const GameInfo& game = pair.second;
-        ss << game.gameId << " " << game.dealer << " " << game.holes << " ";
-        for (const auto& player : game.players) {
-            ss << player << " ";
+    for (const GameInfo& game : games) {
+        ss << game.gameId << " " << players.get(game.dealer)->name << " " << game.holes << " ";
+        for (int i = 0; i < game.numPlayers; ++i) {
+            ss << players.get(game.players[i])->name << " ";
         }
     }
     return ss.str();
 }
 
-std::string Tracker::startGame(const std::string& dealer, int n, int holes) {
-    if (players.find(dealer) == players.end() || players[dealer].state != "free") {
+// Listing changes after version, last change per player or game only, as
+// "SUCCESS <version> <count> <change>..." where a change is a journal row
+// without its kind. "SUCCESS <version> RESYNC" means the journal no longer
+// reaches back that far, or the state was reset; version 0 fetches the
+// whole listing as additions.
+static std::string changesSince(MutationLog* journal, char kind, uint64_t version) {
+    std::vector<std::string> records;
+    uint64_t head = 0;
+    if (!journal->since(version, records, head)) {
+        return "SUCCESS " + std::to_string(head) + " RESYNC";
+    }
+    std::unordered_map<std::string, size_t> latest;
+    std::vector<const std::string*> changes;
+    for (const std::string& record : records) {
+        if (record[0] == '!') {
+            return "SUCCESS " + std::to_string(head) + " RESYNC";
+        }
+        if (record[0] != kind) {
+            continue;
+        }
+        std::string key = record.substr(4, record.find(' ', 4) - 4);
+        auto it = latest.find(key);
+        if (it != latest.end()) {
+            changes[it->second] = nullptr;
+            it->second = changes.size();
+        } else {
+            latest[key] = changes.size();
+        }
+        changes.push_back(&record);
+    }
+    std::string out = "SUCCESS " + std::to_string(head) + " " + std::to_string(latest.size()) + " ";
+    for (const std::string* change : changes) {
+        if (change != nullptr) {
+            out.append(*change, 2, std::string::npos);
+            out += ' ';
+        }
+    }
+    return out;
+}
+
+std::string Tracker::queryPlayersSince(uint64_t version) {
+    TRACE_SCOPE("Tracker::queryPlayersSince");
+    if (changeJournal == nullptr) {
+        return "FAILURE Change journal disabled";
+    }
+    if (version > 0) {
+        return changesSince(changeJournal, 'P', version);
+    }
+    std::string out = "SUCCESS " + std::to_string(changeJournal->head()) + " " +
+                      std::to_string(players.size() - remotePlayers) + " ";
+    for (const PlayerInfo& player : players) {
+        if (!player.remote) {
+            out += "+ " + player.name + " " + player.ipAddress + " " + std::to_string(player.tPort) + " " +
+                   std::to_string(player.pPort) + " " + player.state + " ";
+        }
+    }
+    return out;
+}
+
+std::string Tracker::queryGamesSince(uint64_t version) {
+    TRACE_SCOPE("Tracker::queryGamesSince");
+    if (changeJournal == nullptr) {
+        return "FAILURE Change journal disabled";
+    }
+    if (version > 0) {
+        return changesSince(changeJournal, 'G', version);
+    }
+    std::string out = "SUCCESS " + std::to_string(changeJournal->head()) + " " + std::to_string(games.size()) + " ";
+    for (const GameInfo& game : games) {
+        out += "+ " + std::to_string(game.gameId) + " " + players.get(game.dealer)->name + " " +
+               std::to_string(game.holes) + " " + std::to_string(game.numPlayers) + " ";
+        for (int i = 0; i < game.numPlayers; ++i) {
+            out += players.get(game.players[i])->name + " ";
+        }
+    }
+    return out;
+}
+
+std::string Tracker::startGame(const std::string& dealer, int n, int holes, int variant) {
+    TRACE_SCOPE("Tracker::startGame");
+    auto dealerIt = playerIndex.find(dealer);
+    if (dealerIt == playerIndex.end() || players.get(dealerIt->second)->state != "free") {
         return "FAILURE Invalid dealer or dealer not available";
     }
-    if (n < 1 || n > 3) {
+    if (n < 1 || n > MAX_PLAYERS - 1) {
         return "FAILURE Invalid number of additional players";
     }
-    if (holes < 1 || holes > 9) {
+    if (holes < 1 || holes > GOLF_MAX_HOLES) {
         return "FAILURE Invalid number of holes";
     }
-    if (players.size() < n + 1) {
+    if (variant < 0 || variant >= golfVariantCount()) {
+        return "FAILURE Unknown game variant";
+    }
+    if (players.size() < static_cast<size_t>(n + 1)) {
         return "FAILURE Not enough registered players";
     }
-    
-    std::vector<std::string> selectedPlayers;
-    for (const auto& pair : players) {
-        if (pair.first != dealer && pair.second.state == "free") {
-            selectedPlayers.push_back(pair.first);
-            if (selectedPlayers.size() == n) {
-                break;
-            }
+
+    GameInfo newGame;
+    newGame.gameId = 0;
+    newGame.dealer = dealerIt->second;
+    newGame.numPlayers = 0;
+    newGame.holes = holes;
+    newGame.variant = variant;
+
+    // Candidates are the dealer's nearest measured free peers, then free
+    // players in registry order
+    std::vector<std::pair<uint32_t, uint32_t>> nearest;
+    purgeRtts(*players.get(newGame.dealer));
+    for (const auto& peer : players.get(newGame.dealer)->peerRtts) {
+        const PlayerInfo* info = players.get(peer.first);
+        if (info != nullptr && info->state == "free") {
+            nearest.push_back(std::make_pair(peer.second, peer.first));
+        }
+    }
+    std::sort(nearest.begin(), nearest.end());
+    std::vector<uint32_t> candidates;
+    size_t wanted = std::max(RTT_CANDIDATES, n);
+    for (size_t i = 0; i < nearest.size() && candidates.size() < wanted; ++i) {
+        candidates.push_back(nearest[i].second);
+    }
+    for (size_t i = 0; i < players.size() && candidates.size() < wanted; ++i) {
+        uint32_t handle = players.handleAt(i);
+        if (handle != newGame.dealer && players.get(handle)->state == "free" &&
+            std::find(candidates.begin(), candidates.end(), handle) == candidates.end()) {
+            candidates.push_back(handle);
         }
     }
 
-    if (selectedPlayers.size() < n) {
+    if (candidates.size() < static_cast<size_t>(n)) {
         return "FAILURE Not enough free players";
     }
-    
-    GameInfo newGame = {nextGameId, dealer, selectedPlayers, holes};
-    games[nextGameId] = newGame;
-    
-    // Update player states
-    for (const auto& player : newGame.players) {
-        updatePlayerState(player, "in-play");
+    // With no round trips known the search would keep registry order anyway
+    bool measured = !nearest.empty();
+    for (size_t i = 0; i < candidates.size() && !measured; ++i) {
+        measured = !players.get(candidates[i])->peerRtts.empty();
     }
-    updatePlayerState(dealer, "in-play");
-    
-    std::stringstream ss;
-    ss << "SUCCESS " << nextGameId << " " << holes << " " << (newGame.players.size() + 1) << " ";
-    
+    if (measured) {
+        seatRing(newGame.dealer, candidates.data(), static_cast<int>(candidates.size()), n, newGame.players);
+    } else {
+        std::copy(candidates.begin(), candidates.begin() + n, newGame.players);
+    }
+    newGame.numPlayers = n;
+
+    return createGame(newGame);
+}
+
+// Records a game whose seats are already chosen and announces it as
+// "SUCCESS <gameId> <holes> <count> <name ip pPort>... <variant>" with the
+// dealer first
+static void appendSeat(std::string& out, const PlayerInfo& info) {
+    out += info.name;
+    out += ' ';
+    out += info.ipAddress;
+    out += ' ';
+    out += std::to_string(info.pPort);
+    out += ' ';
+}
+
+std::string Tracker::createGame(GameInfo& newGame) {
+    TRACE_SCOPE("Tracker::createGame");
+    // Matchmade tables arrive with their players chosen, but not ordered
+    bool measured = !players.get(newGame.dealer)->peerRtts.empty();
+    for (int i = 0; i < newGame.numPlayers && !measured; ++i) {
+        measured = !players.get(newGame.players[i])->peerRtts.empty();
+    }
+    if (measured && newGame.numPlayers > 1) {
+        uint32_t seated[MAX_PLAYERS - 1];
+        std::copy(newGame.players, newGame.players + newGame.numPlayers, seated);
+        seatRing(newGame.dealer, seated, newGame.numPlayers, newGame.numPlayers, newGame.players);
+    }
+    uint32_t gameId = games.insert(newGame);
+    if (gameId == SlotMap<GameInfo>::INVALID) {
+        return "FAILURE Too many games in progress";
+    }
+    newGame.gameId = gameId;
+    games.get(gameId)->gameId = gameId;
+    logGame(newGame);
+    journalGame(newGame);
+
+    // Update player states
+    setGamePlayersState(newGame, "in-play");
+    const PlayerInfo& dealerInfo = *players.get(newGame.dealer);
+
+    // Built with appends rather than a stringstream: the matcher announces
+    // tens of thousands of tables per tick
+    std::string announce = "SUCCESS " + std::to_string(gameId) + " " + std::to_string(newGame.holes) + " " +
+                           std::to_string(newGame.numPlayers + 1) + " ";
+    announce.reserve(announce.size() + (newGame.numPlayers + 1) * 32);
+
     // Add dealer information first
-    const PlayerInfo& dealerInfo = players[dealer];
-    ss << dealerInfo.name << " " << dealerInfo.ipAddress << " " << dealerInfo.pPort << " ";
+    appendSeat(announce, dealerInfo);
 
     // Add information for other players
-    for (const auto& player : newGame.players) {
-        const PlayerInfo& info = players[player];
-        ss << info.name << " " << info.ipAddress << " " << info.pPort << " ";
+    for (int i = 0; i < newGame.numPlayers; ++i) {
+        appendSeat(announce, *players.get(newGame.players[i]));
     }
-    
-    nextGameId++;
-    return ss.str();
+    announce += golfVariant(newGame.variant).name;
+
+    return announce;
 }
 
-std::string Tracker::endGame(int gameId, const std::string& dealer) {
-    auto it = games.find(gameId);
-    if (it == games.end()) {
+// Pairwise Elo: every seat plays one virtual match against every other seat,
+// lower golf score winning, and the summed deltas are averaged over the
+// opponents so table size does not change how far one game moves a rating.
+// Placeholders for other cluster nodes' players count as opponents but are
+// rated by their home node.
+void Tracker::rateGame(const GameInfo& game, const std::vector<int>& scores) {
+    uint32_t seats[MAX_PLAYERS];
+    int n = 0;
+    seats[n++] = game.dealer;
+    for (int i = 0; i < game.numPlayers; ++i) {
+        seats[n++] = game.players[i];
+    }
+    if (n < 2) {
+        return;
+    }
+
+    double delta[MAX_PLAYERS] = {0};
+    for (int i = 0; i < n; ++i) {
+        for (int j = i + 1; j < n; ++j) {
+            int ratingI = players.get(seats[i])->rating;
+            int ratingJ = players.get(seats[j])->rating;
+            double expected = 1.0 / (1.0 + std::pow(10.0, (ratingJ - ratingI) / 400.0));
+            double actual = scores[i] < scores[j] ? 1.0 : (scores[i] == scores[j] ? 0.5 : 0.0);
+            delta[i] += actual - expected;
+            delta[j] -= actual - expected;
+        }
+    }
+
+    for (int i = 0; i < n; ++i) {
+        PlayerInfo& player = *players.get(seats[i]);
+        if (player.remote) {
+            continue;
+        }
+        int k = player.ratedGames < RATING_PROVISIONAL_GAMES ? RATING_K_PROVISIONAL : RATING_K;
+        int rating = player.rating + static_cast<int>(std::lround(k * delta[i] / (n - 1)));
+        setRating(seats[i], player, rating, player.ratedGames + 1);
+        if (mutationLog != nullptr) {
+            mutationLog->append("G " + std::to_string(seats[i]) + " " + std::to_string(rating) + " " +
+                                std::to_string(player.ratedGames));
+        }
+    }
+}
+
+// A player's list holds only the round trips they measured themselves, and
+// repeated reports are averaged. Entries for de-registered peers are
+// dropped first, and a full list keeps the nearest peers.
+void Tracker::recordRtt(PlayerInfo& player, uint32_t peer, uint32_t us) {
+    purgeRtts(player);
+    for (auto& entry : player.peerRtts) {
+        if (entry.first == peer) {
+            entry.second = (entry.second + us) / 2;
+            return;
+        }
+    }
+    if (player.peerRtts.size() < RTT_MAX_PEERS) {
+        player.peerRtts.push_back(std::make_pair(peer, us));
+        return;
+    }
+    auto farthest = std::max_element(player.peerRtts.begin(), player.peerRtts.end(),
+        [](const std::pair<uint32_t, uint32_t>& a, const std::pair<uint32_t, uint32_t>& b) { return a.second < b.second; });
+    if (us < farthest->second) {
+        *farthest = std::make_pair(peer, us);
+    }
+}
+
+// Handles are generational, so a de-registered peer's handle no longer resolves
+void Tracker::purgeRtts(PlayerInfo& player) {
+    player.peerRtts.erase(std::remove_if(player.peerRtts.begin(), player.peerRtts.end(),
+        [this](const std::pair<uint32_t, uint32_t>& entry) { return players.get(entry.first) == nullptr; }),
+        player.peerRtts.end());
+}
+
+// Either side may have measured the pair; when both have, the larger value
+// is used, so one player cannot pull another closer by under-reporting
+uint32_t Tracker::rttBetween(uint32_t a, uint32_t b) {
+    uint32_t measured = 0;
+    for (const auto& entry : players.get(a)->peerRtts) {
+        if (entry.first == b) {
+            measured = entry.second;
+            break;
+        }
+    }
+    for (const auto& entry : players.get(b)->peerRtts) {
+        if (entry.first == a) {
+            measured = std::max(measured, entry.second);
+            break;
+        }
+    }
+    return measured != 0 ? measured : RTT_UNKNOWN_US;
+}
+
+namespace {
+// Exhaustive search over seatings with branch and bound. Index 0 is the
+// dealer, 1..count the candidates.
+struct RingSearch {
+    int count;
+    int n;
+    uint64_t cost[RTT_CANDIDATES + 1][RTT_CANDIDATES + 1];
+    bool used[RTT_CANDIDATES + 1];
+    int path[MAX_PLAYERS - 1];
+    int best[MAX_PLAYERS - 1];
+    uint64_t bestCost;
+
+    void search(int depth, uint64_t sofar) {
+        if (sofar >= bestCost) {
+            return;
+        }
+        // n is 1..MAX_PLAYERS - 1; the extra bounds tell -O2 the path stays
+        // inside its array
+        if (depth > 0 && (depth == n || depth == MAX_PLAYERS - 1)) {
+            sofar += cost[path[depth - 1]][0];
+            if (sofar < bestCost) {
+                bestCost = sofar;
+                std::copy(path, path + depth, best);
+            }
+            return;
+        }
+        int last = depth == 0 ? 0 : path[depth - 1];
+        for (int c = 1; c <= count; ++c) {
+            if (!used[c]) {
+                used[c] = true;
+                path[depth] = c;
+                search(depth + 1, sofar + cost[last][c]);
+                used[c] = false;
+            }
+        }
+    }
+};
+}
+
+// Picks n of the candidates and their order after the dealer so that the
+// round trips between players whose turns follow each other, wrapping back
+// to the dealer, sum to the least. Solved exactly; ties keep the
+// candidates' order, so with nothing measured the first n are seated.
+void Tracker::seatRing(uint32_t dealer, const uint32_t* candidates, int count, int n, uint32_t* seats) {
+    RingSearch ring;
+    ring.count = std::min(count, RTT_CANDIDATES);
+    ring.n = n;
+    ring.bestCost = UINT64_MAX;
+    for (int i = 0; i <= ring.count; ++i) {
+        ring.used[i] = false;
+        for (int j = i + 1; j <= ring.count; ++j) {
+            uint32_t a = i == 0 ? dealer : candidates[i - 1];
+            uint32_t b = candidates[j - 1];
+            ring.cost[i][j] = ring.cost[j][i] = rttBetween(a, b);
+        }
+    }
+    ring.search(0, 0);
+    for (int i = 0; i < n; ++i) {
+        seats[i] = candidates[ring.best[i] - 1];
+    }
+}
+
+// "<peer> <us>" pairs measured by the named player; unknown peers are skipped.
+// Replies "SUCCESS <accepted>".
+std::string Tracker::reportRtts(const std::string& name, const std::vector<std::pair<std::string, uint32_t>>& samples) {
+    auto self = playerIndex.find(name);
+    if (self == playerIndex.end()) {
+        return "FAILURE Player not registered";
+    }
+    int accepted = 0;
+    for (const auto& sample : samples) {
+        auto peer = playerIndex.find(sample.first);
+        if (peer == playerIndex.end() || peer->second == self->second || sample.second == 0) {
+            continue;
+        }
+        uint32_t us = std::min<uint32_t>(sample.second, 10 * RTT_UNKNOWN_US);
+        recordRtt(*players.get(self->second), peer->second, us);
+        accepted++;
+    }
+    return "SUCCESS " + std::to_string(accepted);
+}
+
+// Moves a player to their new leaderboard position
+void Tracker::setRating(uint32_t handle, PlayerInfo& player, int rating, int ratedGames) {
+    if (player.ratedGames > 0) {
+        leaderboard.erase(Leaderboard::Entry{player.rating, handle});
+    }
+    player.rating = rating;
+    player.ratedGames = ratedGames;
+    if (ratedGames > 0) {
+        leaderboard.insert(Leaderboard::Entry{rating, handle});
+    }
+}
+
+std::string Tracker::endGame(uint32_t gameId, const std::string& dealer, const std::vector<int>& scores) {
+    TRACE_SCOPE("Tracker::endGame");
+    GameInfo* game = games.get(gameId);
+    if (game == nullptr) {
         return "FAILURE Game not found";
     }
-    
-    if (it->second.dealer != dealer) {
+
+    auto dealerIt = playerIndex.find(dealer);
+    if (dealerIt == playerIndex.end() || dealerIt->second != game->dealer) {
         return "FAILURE Only the dealer can end the game";
     }
-    
+    if (!scores.empty() && scores.size() != static_cast<size_t>(game->numPlayers + 1)) {
+        return "FAILURE Expected one score per seat";
+    }
+    const GolfVariant& variant = golfVariant(game->variant);
+    for (int score : scores) {
+        if (score < variant.minHoleScore * game->holes || score > variant.maxHoleScore * game->holes) {
+            return std::string("FAILURE Score out of range for ") + variant.name;
+        }
+    }
+
+    if (!scores.empty()) {
+        rateGame(*game, scores);
+    }
+    if (mutationLog != nullptr) {
+        mutationLog->append("E " + std::to_string(gameId));
+    }
+    journal("G - " + std::to_string(gameId));
+
     // Update player states
-    for (const auto& player : it->second.players) {
-        updatePlayerState(player, "free");
+    setGamePlayersState(*game, "free");
+    games.erase(gameId);
+    return "SUCCESS";
+}
+
+// "SUCCESS <rated players> <count> <name rating>..." for the best k, best first
+std::string Tracker::queryLeaderboard(size_t k) {
+    TRACE_SCOPE("Tracker::queryLeaderboard");
+    std::vector<Leaderboard::Entry> entries;
+    leaderboard.top(std::min<size_t>(k, LEADERBOARD_MAX_TOP), entries);
+    std::string out = "SUCCESS " + std::to_string(leaderboard.size()) + " " + std::to_string(entries.size()) + " ";
+    for (const auto& entry : entries) {
+        out += players.get(entry.player)->name;
+        out += ' ';
+        out += std::to_string(entry.rating);
+        out += ' ';
     }
-    updatePlayerState(dealer, "free");
-    games.erase(it);
+    return out;
+}
+
+// "SUCCESS <rank> <rated players> <name> <rating> <rated games>"
+std::string Tracker::playerRank(const std::string& name) {
+    TRACE_SCOPE("Tracker::playerRank");
+    auto it = playerIndex.find(name);
+    if (it == playerIndex.end()) {
+        return "FAILURE Player not registered";
+    }
+    const PlayerInfo& player = *players.get(it->second);
+    if (player.ratedGames == 0) {
+        return "FAILURE Player has no rated games";
+    }
+    size_t rank = leaderboard.rankOf(Leaderboard::Entry{player.rating, it->second});
+    return "SUCCESS " + std::to_string(rank) + " " + std::to_string(leaderboard.size()) + " " + player.name + " " +
+           std::to_string(player.rating) + " " + std::to_string(player.ratedGames);
+}
+
+int Tracker::freePlayerCount(const std::string& except) {
+    int count = 0;
+    for (const PlayerInfo& player : players) {
+        if (player.state == "free" && player.name != except) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// Marks up to count local free players as in-play on behalf of a game hosted
+// by another node and lists them as "SUCCESS <k> name ip tPort pPort ..."
+std::string Tracker::reservePlayers(const std::string& reservationId, int count) {
+    TRACE_SCOPE("Tracker::reservePlayers");
+    if (reservations.find(reservationId) != reservations.end()) {
+        return "FAILURE Duplicate reservation";
+    }
+
+    std::vector<uint32_t>& held = reservations[reservationId];
+    std::stringstream listing;
+    for (size_t i = 0; i < players.size() && static_cast<int>(held.size()) < count; ++i) {
+        uint32_t handle = players.handleAt(i);
+        PlayerInfo& player = *players.get(handle);
+        if (player.state == "free" && !player.remote) {
+            setState(handle, player, "in-play");
+            logState(player);
+            held.push_back(handle);
+            listing << player.name << " " << player.ipAddress << " " << player.tPort << " " << player.pPort << " ";
+        }
+    }
+
+    std::stringstream ss;
+    ss << "SUCCESS " << held.size() << " " << listing.str();
+    return ss.str();
+}
+
+std::string Tracker::releasePlayers(const std::string& reservationId) {
+    TRACE_SCOPE("Tracker::releasePlayers");
+    auto it = reservations.find(reservationId);
+    if (it == reservations.end()) {
+        return "FAILURE Reservation not found";
+    }
+    for (uint32_t handle : it->second) {
+        PlayerInfo* player = players.get(handle);
+        if (player != nullptr) {
+            setState(handle, *player, "free");
+            logState(*player);
+        }
+    }
+    reservations.erase(it);
     return "SUCCESS";
 }
 
+uint32_t Tracker::addRemotePlayer(const std::string& name, const std::string& ipAddress, int tPort, int pPort) {
+    if (playerIndex.find(name) != playerIndex.end()) {
+        return SlotMap<PlayerInfo>::INVALID;
+    }
+    PlayerInfo player(name, ipAddress, "free", tPort, pPort);
+    player.remote = true;
+    uint32_t handle = players.insert(player);
+    if (handle != SlotMap<PlayerInfo>::INVALID) {
+        playerIndex[name] = handle;
+        remotePlayers++;
+        logPlayer('X', handle, player);
+    }
+    return handle;
+}
+
+void Tracker::removeRemotePlayer(const std::string& name) {
+    auto it = playerIndex.find(name);
+    if (it == playerIndex.end() || !players.get(it->second)->remote) {
+        return;
+    }
+    if (mutationLog != nullptr) {
+        mutationLog->append("D " + std::to_string(it->second));
+    }
+    players.erase(it->second);
+    playerIndex.erase(it);
+    remotePlayers--;
+}
+
+uint32_t Tracker::playerHandle(const std::string& name) const {
+    auto it = playerIndex.find(name);
+    return it == playerIndex.end() ? SlotMap<PlayerInfo>::INVALID : it->second;
+}
+
+PlayerInfo* Tracker::player(uint32_t handle) {
+    return players.get(handle);
+}
+
+const GameInfo* Tracker::game(uint32_t gameId) const {
+    return games.get(gameId);
+}
+
+const std::string* Tracker::playerName(uint32_t handle) const {
+    const PlayerInfo* player = players.get(handle);
+    return player == nullptr ? nullptr : &player->name;
+}
+
 bool Tracker::isPlayerRegistered(const std::string& name) {
-    return players.find(name) != players.end();
+    return playerIndex.find(name) != playerIndex.end();
 }
 
 bool Tracker::isPlayerInGame(const std::string& name) {
-    auto it = players.find(name);
-    if (it == players.end()) {
+    PlayerInfo* player = findPlayer(name);
+    if (player == nullptr) {
         return false;
     }
-    return it->second.state == "in-play";
+    return player->state == "in-play";
 }
 
 void Tracker::updatePlayerState(const std::string& name, const std::string& state) {
-    auto it = players.find(name);
-    if (it != players.end()) {
-        it->second.state = state;
+    auto it = playerIndex.find(name);
+    if (it != playerIndex.end()) {
+        PlayerInfo* player = players.get(it->second);
+        setState(it->second, *player, state);
+        logState(*player);
+    }
+}
+
+// Lists records that rebuild the current registry and game table
+void Tracker::snapshot(std::vector<std::string>& records) const {
+    for (size_t i = 0; i < players.size(); ++i) {
+        uint32_t handle = players.handleAt(i);
+        const PlayerInfo& player = *players.get(handle);
+        std::stringstream ss;
+        ss << (player.remote ? 'X' : 'R') << " " << handle << " " << player.name << " " << player.ipAddress
+           << " " << player.tPort << " " << player.pPort;
+        records.push_back(ss.str());
+        if (player.state != "free") {
+            records.push_back("T " + std::to_string(handle) + " " + player.state);
+        }
+        if (player.ratedGames > 0) {
+            records.push_back("G " + std::to_string(handle) + " " + std::to_string(player.rating) + " " +
+                              std::to_string(player.ratedGames));
+        }
+    }
+    for (const GameInfo& game : games) {
+        std::stringstream ss;
+        ss << "S " << game.gameId << " " << game.holes << " " << game.dealer << " " << game.numPlayers;
+        for (int i = 0; i < game.numPlayers; ++i) {
+            ss << " " << game.players[i];
+        }
+        ss << " " << golfVariant(game.variant).name;
+        records.push_back(ss.str());
     }
 }
 
+bool Tracker::applyMutation(const std::string& record) {
+    std::istringstream iss(record);
+    char kind;
+    uint32_t handle;
+    if (!(iss >> kind >> handle)) {
+        return false;
+    }
+
+    switch (kind) {
+        case 'R':
+        case 'X': {
+            PlayerInfo player;
+            iss >> player.name >> player.ipAddress >> player.tPort >> player.pPort;
+            player.remote = (kind == 'X');
+            if (playerIndex.count(player.name) || !players.insertAt(handle, player)) {
+                return false;
+            }
+            playerIndex[player.name] = handle;
+            remotePlayers += player.remote ? 1 : 0;
+            if (!player.remote) {
+                search.add(handle, player);
+            }
+            journalPlayer(player);
+            break;
+        }
+        case 'D': {
+            PlayerInfo* player = players.get(handle);
+            if (player == nullptr) {
+                return false;
+            }
+            remotePlayers -= player->remote ? 1 : 0;
+            journalPlayerGone(*player);
+            setRating(handle, *player, 0, 0);
+            if (!player->remote) {
+                search.remove(handle, *player);
+            }
+            playerIndex.erase(player->name);
+            players.erase(handle);
+            break;
+        }
+        case 'T': {
+            PlayerInfo* player = players.get(handle);
+            if (player == nullptr) {
+                return false;
+            }
+            std::string state;
+            iss >> state;
+            setState(handle, *player, state);
+            journalPlayer(*player);
+            break;
+        }
+        case 'G': {
+            PlayerInfo* player = players.get(handle);
+            int rating = 0, ratedGames = 0;
+            if (player == nullptr || !(iss >> rating >> ratedGames)) {
+                return false;
+            }
+            setRating(handle, *player, rating, ratedGames);
+            break;
+        }
+        case 'S': {
+            GameInfo game;
+            game.gameId = handle;
+            iss >> game.holes >> game.dealer >> game.numPlayers;
+            if (game.numPlayers < 0 || game.numPlayers > MAX_PLAYERS - 1 || players.get(game.dealer) == nullptr) {
+                return false;
+            }
+            for (int i = 0; i < game.numPlayers; ++i) {
+                iss >> game.players[i];
+                if (players.get(game.players[i]) == nullptr) {
+                    return false;
+                }
+            }
+            // Records from before variants existed carry none
+            std::string variant;
+            game.variant = (iss >> variant) ? findGolfVariant(variant) : 0;
+            if (game.variant < 0) {
+                return false;
+            }
+            if (!games.insertAt(game.gameId, game)) {
+                return false;
+            }
+            journalGame(game);
+            setGamePlayersState(game, "in-play");
+            break;
+        }
+        case 'E': {
+            GameInfo* game = games.get(handle);
+            if (game == nullptr) {
+                return false;
+            }
+            setGamePlayersState(*game, "free");
+            games.erase(handle);
+            journal("G - " + std::to_string(handle));
+            break;
+        }
+        default:
+            return false;
+    }
+
+    if (mutationLog != nullptr) {
+        mutationLog->append(record);
+    }
+    return true;
+}
@@ -2,25 +2,87 @@
 #define TRACKER_H
 
 #include "Utils.h"
+#include "SlotMap.h"
+#include "MutationLog.h"
+#include "Leaderboard.h"
+#include "PlayerSearch.h"
 #include <unordered_map>
 #include <random>
 
+#define RATING_K 20                 // Elo K-factor
+#define RATING_K_PROVISIONAL 40     // K-factor for a player's first few rated games
+#define RATING_PROVISIONAL_GAMES 10
+#define LEADERBOARD_MAX_TOP 25      // Largest top-K that fits one reply datagram
+#define CHANGE_JOURNAL_MAX 16384    // Listing changes kept for QUERY_*_SINCE
+#define RTT_MAX_PEERS 32            // Round trips kept per player
+#define RTT_UNKNOWN_US 200000       // Assumed round trip between players with no report
+#define RTT_CANDIDATES 12           // Free players considered for a dealer's table
+
 class Tracker {
 private:
-    std::unordered_map<std::string, PlayerInfo> players;
-    std::unordered_map<int, GameInfo> games;
-    int nextGameId;
+    SlotMap<PlayerInfo> players;
+    std::unordered_map<std::string, uint32_t> playerIndex; // Name -> registry handle
+    SlotMap<GameInfo> games;
+    std::unordered_map<std::string, std::vector<uint32_t>> reservations; // Held for other cluster nodes
+    size_t remotePlayers;
+    MutationLog* mutationLog; // Receives one record per state change when set
+    MutationLog* changeJournal; // Listing changes by name, for delta queries, when set
+    Leaderboard leaderboard;  // Players with at least one rated game
+    PlayerSearch search;      // Local players by name, state and address
     std::mt19937 rng;
 
+    PlayerInfo* findPlayer(const std::string& name);
+    void logPlayer(char kind, uint32_t handle, const PlayerInfo& player);
+    void logGame(const GameInfo& game);
+    void logState(const PlayerInfo& player);
+    void journal(const std::string& change);
+    void journalPlayer(const PlayerInfo& player);
+    void journalPlayerGone(const PlayerInfo& player);
+    void journalGame(const GameInfo& game);
+    void setState(uint32_t handle, PlayerInfo& player, const std::string& state);
+    void setGamePlayersState(const GameInfo& game, const std::string& state);
+    void rateGame(const GameInfo& game, const std::vector<int>& scores);
+    void recordRtt(PlayerInfo& player, uint32_t peer, uint32_t us);
+    void purgeRtts(PlayerInfo& player);
+    uint32_t rttBetween(uint32_t a, uint32_t b);
+    void seatRing(uint32_t dealer, const uint32_t* candidates, int count, int n, uint32_t* seats);
+    void setRating(uint32_t handle, PlayerInfo& player, int rating, int ratedGames);
+
 public:
     Tracker();
 
     std::string registerPlayer(const std::string& name, const std::string& ipAddress, int tPort, int pPort);
     std::string queryPlayers();
+    std::string queryPlayers(const PlayerSearch::Filter& filter);
     std::string queryGames();
+    std::string queryPlayersSince(uint64_t version);
+    std::string queryGamesSince(uint64_t version);
     std::string deregisterPlayer(const std::string& name);
-    std::string startGame(const std::string& dealer, int n, int holes);
-    std::string endGame(int gameId, const std::string& dealer);
+    std::string startGame(const std::string& dealer, int n, int holes, int variant = 0);
+    std::string endGame(uint32_t gameId, const std::string& dealer, const std::vector<int>& scores = std::vector<int>());
+    std::string createGame(GameInfo& game);
+    std::string queryLeaderboard(size_t k);
+    std::string playerRank(const std::string& name);
+    std::string reportRtts(const std::string& name, const std::vector<std::pair<std::string, uint32_t>>& samples);
+
+    // Cross-node reservation protocol used in cluster mode
+    int freePlayerCount(const std::string& except);
+    std::string reservePlayers(const std::string& reservationId, int count);
+    std::string releasePlayers(const std::string& reservationId);
+    uint32_t addRemotePlayer(const std::string& name, const std::string& ipAddress, int tPort, int pPort);
+    void removeRemotePlayer(const std::string& name);
+
+    // Replication: every mutation is described by a text record that
+    // applyMutation replays, preserving registry handles and game IDs
+    void setMutationLog(MutationLog* log) { mutationLog = log; }
+    void setChangeJournal(MutationLog* journal) { changeJournal = journal; }
+    void snapshot(std::vector<std::string>& records) const;
+    bool applyMutation(const std::string& record);
+
+    uint32_t playerHandle(const std::string& name) const;
+    const std::string* playerName(uint32_t handle) const;
+    PlayerInfo* player(uint32_t handle);
+    const GameInfo* game(uint32_t gameId) const;
 
     bool isPlayerRegistered(const std::string& name);
     bool isPlayerInGame(const std::string& name);
@@ -0,0 +1,313 @@
+#include "TrackerServer.h"
+#include "Admission.h"
+#include "Transport.h"
+#include "LocalChannelServer.h"
+#include "Trace.h"
+#include <stdio.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <vector>
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s <UDP SERVER PORT> [--cluster <NODE INDEX> <IP:PORT,IP:PORT,...>]\n"
+                    "       [--replicate-to <IP:PORT,IP:PORT,...>] [--standby <REPLICATION PORT>]\n"
+                    "       [--host <GAME HOST IP:PORT>] [--transport sockets|io_uring] [--local] [--quiet]\n", program);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        usage(argv[0]);
+    }
+
+    int sock;                               // Socket
+    struct sockaddr_in trackerServAddr;     // Local address of server
+    struct sockaddr_in trackerClntAddr;     // Client address
+    unsigned short trackerServPort;         // Server port
+    char clientIP[INET_ADDRSTRLEN];         // Printable client address, for logging
+    char playerName[ECHOMAX];               // Player bound to the client's session
+
+    trackerServPort = atoi(argv[1]);        // First arg: local port
+
+    TrackerServer trackerServer;
+    ReplicationPrimary* primary = nullptr;
+    ReplicationBackup* backup = nullptr;
+    std::string transportKind = "sockets";
+    bool quiet = false;                     // Skip per-request logging
+    bool localChannels = false;             // Also serve co-located clients over shared memory
+    std::vector<ClusterNode> gameHosts;     // Where hosted games are opened
+
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    TRACE_INIT("TrackerServer", true);
+
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "--cluster") == 0 && i + 2 < argc) {
+            std::vector<ClusterNode> nodes;
+            int self = atoi(argv[i + 1]);
+            if (!parseClusterNodes(argv[i + 2], nodes) || self < 0 || self >= static_cast<int>(nodes.size())) {
+                fprintf(stderr, "server: invalid cluster configuration\n");
+                exit(1);
+            }
+            trackerServer.enableCluster(self, nodes);
+            printf("Cluster node %d of %zu\n", self, nodes.size());
+            i += 2;
+        } else if (strcmp(argv[i], "--replicate-to") == 0 && i + 1 < argc && primary == nullptr) {
+            std::vector<ClusterNode> nodes;
+            if (!parseClusterNodes(argv[i + 1], nodes)) {
+                fprintf(stderr, "server: invalid backup list\n");
+                exit(1);
+            }
+            std::vector<sockaddr_in> addrs;
+            for (const auto& node : nodes) {
+                struct sockaddr_in addr;
+                memset(&addr, 0, sizeof(addr));
+                addr.sin_family = AF_INET;
+                addr.sin_addr.s_addr = inet_addr(node.ip.c_str());
+                addr.sin_port = htons(node.port);
+                addrs.push_back(addr);
+            }
+            primary = new ReplicationPrimary(trackerServer, trackerServer.enableMutationLog(), addrs);
+            printf("Replicating to %zu backup(s)\n", addrs.size());
+            i += 1;
+        } else if (strcmp(argv[i], "--standby") == 0 && i + 1 < argc && backup == nullptr) {
+            backup = new ReplicationBackup(trackerServer, atoi(argv[i + 1]));
+            printf("Standing by for replication on port %s\n", argv[i + 1]);
+            i += 1;
+        } else if (strcmp(argv[i], "--host") == 0 && i + 1 < argc) {
+            if (!parseClusterNodes(argv[i + 1], gameHosts) || gameHosts.size() != 1) {
+                fprintf(stderr, "server: invalid game host\n");
+                exit(1);
+            }
+            i += 1;
+        } else if (strcmp(argv[i], "--transport") == 0 && i + 1 < argc) {
+            transportKind = argv[i + 1];
+            i += 1;
+        } else if (strcmp(argv[i], "--local") == 0) {
+            localChannels = true;
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            quiet = true;
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    if (!gameHosts.empty()) {
+        trackerServer.enableGameHost(gameHosts[0], trackerServPort);
+        printf("Hosted games open on %s:%d\n", gameHosts[0].ip.c_str(), gameHosts[0].port);
+    }
+
+    // Create socket for sending/receiving datagrams
+    if ((sock = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0)
+        DieWithError("server: socket() failed");
+
+    // Construct local address structure
+    memset(&trackerServAddr, 0, sizeof(trackerServAddr));
+    trackerServAddr.sin_family = AF_INET;
+    trackerServAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    trackerServAddr.sin_port = htons(trackerServPort);
+
+    // Bind to the local address
+    if (bind(sock, (struct sockaddr *) &trackerServAddr, sizeof(trackerServAddr)) < 0)
+        DieWithError("server: bind() failed");
+
+    Transport* transport = createTransport(transportKind, sock);
+    printf("Tracker server is running on port %d (%s transport)\n", trackerServPort, transport->name());
+
+    LocalChannelServer* local = nullptr;
+    if (localChannels) {
+        std::string error;
+        local = new LocalChannelServer(trackerServer, trackerServPort);
+        if (local->start(error)) {
+            printf("Local channels at %s\n", localRegionName(trackerServPort).c_str());
+        } else {
+            fprintf(stderr, "server: local channels unavailable: %s\n", error.c_str());
+            delete local;
+            local = nullptr;
+        }
+    }
+
+    std::vector<MatchNotification> notifications;
+    std::vector<Invitation> invites;
+    std::vector<DeferredReply> deferred;
+    uint64_t lastMatchTick = monotonicMs();
+
+    // Requests drained in one wakeup, screened by per-source admission control
+    std::vector<InboundDatagram> batch(TRANSPORT_MAX_BATCH);
+    AdmissionControl admission;
+
+    for (;;) {
+        // Wait for a client request, replication traffic, another cluster
+        // node's reply or the next tick
+        // revents stay zero when poll() is interrupted, so the handlers
+        // below find nothing ready and only the timers run
+        struct pollfd fds[3];
+        memset(fds, 0, sizeof(fds));
+        int nfds = 0;
+        fds[nfds].fd = transport->fd();
+        fds[nfds++].events = transport->pollEvents();
+        if (primary != nullptr) {
+            fds[nfds].fd = primary->fd();
+            fds[nfds++].events = POLLIN;
+        } else if (backup != nullptr) {
+            fds[nfds].fd = backup->fd();
+            fds[nfds++].events = POLLIN;
+        }
+        if (trackerServer.clusterFd() >= 0) {
+            fds[nfds].fd = trackerServer.clusterFd();
+            fds[nfds++].events = POLLIN;
+        }
+        bool ticking = primary != nullptr || backup != nullptr || trackerServer.clusterFd() >= 0;
+        if (poll(fds, nfds, ticking ? REPL_TICK_MS : MATCH_TICK_MS) < 0 && errno != EINTR)
+            DieWithError("server: poll() failed");
+        transport->stats().syscalls++;
+        if (TRACE_POLL())
+            break;
+
+        uint64_t now = monotonicMs();
+        transport->ready(fds[0].revents);
+        if ((primary != nullptr || backup != nullptr) && (fds[1].revents & POLLIN)) {
+            if (primary != nullptr)
+                primary->onReadable();
+            else
+                backup->onReadable(now);
+        }
+        if (primary != nullptr)
+            primary->tick(now);
+        if (backup != nullptr)
+            backup->tick(now);
+
+        // Announce the tables the matcher seated to each of their players
+        if (now - lastMatchTick >= MATCH_TICK_MS) {
+            lastMatchTick = now;
+            notifications.clear();
+            trackerServer.matchTick(notifications);
+            for (const auto& note : notifications) {
+                for (int s = 0; s < note.numSeats; ++s) {
+                    if (local != nullptr && LocalChannelServer::isLocal(note.seats[s])) {
+                        local->push(note.seats[s], note.message);
+                        continue;
+                    }
+                    struct sockaddr_in to;
+                    memset(&to, 0, sizeof(to));
+                    to.sin_family = AF_INET;
+                    to.sin_addr.s_addr = note.seats[s].addr;
+                    to.sin_port = note.seats[s].port;
+                    transport->send(note.message.c_str(), note.message.length(), to);
+                }
+            }
+        }
+
+        admission.report(now);
+        transport->report(now);
+
+        // Drain pending requests in one go so admission control can see how
+        // deep the queue is, and so refused datagrams cost no syscall of their own
+        int depth = 0;
+        if (fds[0].revents & POLLIN) {
+            TRACE_SAMPLE();
+            TRACE_SCOPE("receive");
+            depth = transport->receive(batch.data(), TRANSPORT_MAX_BATCH);
+        }
+
+        // A backed-up send queue sheds load too, so replies are not produced
+        // faster than the socket drains them
+        bool overloaded = depth > ADMISSION_SHED_DEPTH || transport->congested();
+
+        for (int i = 0; i < depth; ++i) {
+            const Message& msg = *batch[i].msg;
+            TRACE_SAMPLE();
+            TRACE_SCOPE_DETAIL("request", cmdToString(msg.cmd));
+            trackerClntAddr = batch[i].addr;
+            Endpoint from = {trackerClntAddr.sin_addr.s_addr, trackerClntAddr.sin_port};
+
+            AdmissionControl::Verdict verdict = admission.admit(from.addr, msg.cmd, now, overloaded);
+            if (verdict == AdmissionControl::DROP)
+                continue;
+            if (verdict == AdmissionControl::RETRY_LATER) {
+                std::string response = trackerServer.formatResponse(cmdToString(msg.cmd), "Rate limited, retry later");
+                transport->send(response.c_str(), response.length(), trackerClntAddr);
+                continue;
+            }
+
+            if (!quiet) {
+                TRACE_SCOPE("session lookup");
+                inet_ntop(AF_INET, &trackerClntAddr.sin_addr, clientIP, sizeof(clientIP));
+                if (!trackerServer.sessionPlayer(from, playerName, sizeof(playerName))) {
+                    printf("Received from client %s: Command %d, Data: %s\n", clientIP, msg.cmd, msg.data);
+                } else {
+                    printf("Received from client %s (%s): Command %d, Data: %s\n", clientIP, playerName, msg.cmd, msg.data);
+                }
+            }
+
+            // Handle the command using the new TrackerServer implementation
+            std::string response = trackerServer.handleCommand(msg, from);
+            if (response.empty()) {
+                continue; // Acknowledgements have no reply
+            }
+
+            // Send the response back to the client
+            {
+                TRACE_SCOPE("send");
+                transport->send(response.c_str(), response.length(), trackerClntAddr);
+            }
+
+            if (!quiet)
+                printf("Sent response to client %s: %s\n", clientIP, response.c_str());
+        }
+
+        // START_GAMEs that waited on other cluster nodes or the game host
+        deferred.clear();
+        trackerServer.clusterPoll(monotonicMs(), deferred);
+        for (const auto& reply : deferred) {
+            if (local != nullptr && LocalChannelServer::isLocal(reply.to)) {
+                local->push(reply.to, reply.message);
+                continue;
+            }
+            struct sockaddr_in to;
+            memset(&to, 0, sizeof(to));
+            to.sin_family = AF_INET;
+            to.sin_addr.s_addr = reply.to.addr;
+            to.sin_port = reply.to.port;
+            transport->send(reply.message.c_str(), reply.message.length(), to);
+        }
+
+        // Invitations to games started this iteration, and resends of
+        // those not yet acknowledged
+        invites.clear();
+        trackerServer.dueInvitations(monotonicMs(), invites);
+        for (const auto& invite : invites) {
+            if (local != nullptr && LocalChannelServer::isLocal(invite.to)) {
+                local->push(invite.to, *invite.message);
+                continue;
+            }
+            struct sockaddr_in to;
+            memset(&to, 0, sizeof(to));
+            to.sin_family = AF_INET;
+            to.sin_addr.s_addr = invite.to.addr;
+            to.sin_port = invite.to.port;
+            transport->send(invite.message->c_str(), invite.message->length(), to);
+        }
+
+        // The listings changed by this iteration's writes are rendered once
+        trackerServer.publishQueries();
+
+        // Replies queued this iteration leave together
+        {
+            TRACE_SCOPE("flush");
+            transport->flush();
+        }
+    }
+
+    // Reached when a traced server is stopped
+    delete local;
+    delete transport;
+    delete primary;
+    delete backup;
+    close(sock);
+    return 0;
+}
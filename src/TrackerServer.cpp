@@ -1,4 +1,6 @@
 #include "TrackerServer.h"
+#include "GameLogic.h"
+#include "Trace.h"
 #include <stdio.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
@@ -6,15 +8,79 @@
 #include <string.h>
 #include <unistd.h>
 #include <sstream>
-#include <map>
 #include <vector>
 #include <algorithm>
 
 #define ECHOMAX 1024    // Longest string to echo
 
-TrackerServer::TrackerServer() : tracker() {}
+TrackerServer::TrackerServer()
+    : tracker(), matchmaker(tracker), clusterLink(nullptr), selfNode(-1), nextReservation(1), gameHost(), logMutations(false),
+      standby(false), writesThrottled(false), queryView(nullptr), viewVersion(~0ull), viewStale(true), snapshotReads(true) {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    tracker.setChangeJournal(&changeJournal);
+    publishQueryView();
+}
+
+TrackerServer::~TrackerServer() {
+    delete clusterLink;
+    delete queryView.load();
+}
+
+// Renders both query replies once per batch of listing changes rather than
+// once per query. Every change to the listings is journalled, so the view
+// is current while the journal head has not moved. The caller must hold
+// trackerMutex.
+void TrackerServer::publishQueryView() {
+    uint64_t version = changeJournal.head();
+    if (version != viewVersion) {
+        QueryView* view = new QueryView;
+        view->players = formatResponse("QUERY_PLAYERS", tracker.queryPlayers());
+        view->games = formatResponse("QUERY_GAMES", tracker.queryGames());
+        const QueryView* old = queryView.exchange(view);
+        if (old != nullptr) {
+            readEpochs.retire(old);
+        }
+        viewVersion = version;
+    }
+    viewStale = false;
+}
+
+// Marks the view stale if the listings changed; the caller must hold
+// trackerMutex. Writers leave the rebuild to publishQueries().
+void TrackerServer::noteListingChanges() {
+    if (changeJournal.head() != viewVersion) {
+        viewStale = true;
+    }
+}
+
+// Called once per server loop iteration, so a burst of writes is rendered
+// once. Readers never call this: they must not wait on trackerMutex.
+void TrackerServer::publishQueries() {
+    if (viewStale) {
+        std::lock_guard<std::mutex> lock(trackerMutex);
+        publishQueryView();
+    }
+}
+
+void TrackerServer::enableCluster(int self, const std::vector<ClusterNode>& nodes) {
+    for (const auto& node : nodes) {
+        ring.addNode(node);
+    }
+    selfNode = self;
+    clusterLink = new ClusterLink(nodes[self]);
+}
+
+// Call after enableCluster, whose link it then shares
+void TrackerServer::enableGameHost(const ClusterNode& host, int port) {
+    gameHost = host;
+    if (clusterLink == nullptr) {
+        ClusterNode self = {"", port};
+        clusterLink = new ClusterLink(self);
+    }
+}
 
 std::string TrackerServer::formatResponse(const std::string& command, const std::string& trackerResponse) {
+    TRACE_SCOPE("formatResponse");
     if (trackerResponse.empty()) {
         return "FAILURE " + command + " Empty response from tracker";
     }
@@ -26,138 +92,783 @@ std::string TrackerServer::formatResponse(const std::string& command, const std:
     }
 }
 
-std::string TrackerServer::handleCommand(const Message& msg) {
-    std::istringstream iss(msg.data);
+MutationLog& TrackerServer::enableMutationLog() {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    logMutations = true;
+    tracker.setMutationLog(&mutationLog);
+    return mutationLog;
+}
+
+// Records rebuilding the tracker and its sessions, and the log sequence
+// number they reflect
+void TrackerServer::snapshot(std::vector<std::string>& records, uint64_t& seq) {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    tracker.snapshot(records);
+    sessions.forEach([&records](const Endpoint& endpoint, uint32_t token) {
+        records.push_back("B " + std::to_string(token) + " " + std::to_string(endpoint.addr) + " " + std::to_string(endpoint.port));
+    });
+    seq = mutationLog.head();
+}
+
+void TrackerServer::applyReplicated(const std::vector<std::string>& records) {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    for (const auto& record : records) {
+        // Session bindings are the server's own records; the rest are the tracker's
+        unsigned long token, addr, port;
+        if (sscanf(record.c_str(), "B %lu %lu %lu", &token, &addr, &port) == 3) {
+            Endpoint endpoint = {static_cast<uint32_t>(addr), static_cast<uint16_t>(port)};
+            addSession(endpoint, token);
+        } else if (sscanf(record.c_str(), "U %lu %lu", &addr, &port) == 2) {
+            Endpoint endpoint = {static_cast<uint32_t>(addr), static_cast<uint16_t>(port)};
+            removeSession(endpoint);
+        } else if (!tracker.applyMutation(record)) {
+            fprintf(stderr, "replication: could not apply \"%s\"\n", record.c_str());
+        }
+    }
+    noteListingChanges();
+}
+
+void TrackerServer::resetState() {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    tracker = Tracker();
+    tracker.setChangeJournal(&changeJournal);
+    // Every client's version predates the reset and must refetch
+    changeJournal.trim(changeJournal.head());
+    changeJournal.append("!");
+    sessions = SessionTable();
+    sessionOwners.clear();
+    gameReservations.clear();
+    invitations.clear();
+    noteListingChanges();
+}
+
+// Keeps sessionOwners in step with sessions. An endpoint that registers
+// again moves to the new token, leaving the old one unbound.
+void TrackerServer::addSession(const Endpoint& endpoint, uint32_t token) {
+    removeSession(endpoint);
+    sessions.insert(endpoint, token);
+    sessionOwners[token] = endpoint;
+}
+
+bool TrackerServer::removeSession(const Endpoint& endpoint) {
+    uint32_t token = sessions.find(endpoint);
+    if (!sessions.erase(endpoint)) {
+        return false;
+    }
+    auto owner = sessionOwners.find(token);
+    if (owner != sessionOwners.end() && owner->second.addr == endpoint.addr && owner->second.port == endpoint.port) {
+        sessionOwners.erase(owner);
+    }
+    return true;
+}
+
+void TrackerServer::bindSession(const Endpoint& from, uint32_t token) {
+    addSession(from, token);
+    if (logMutations) {
+        mutationLog.append("B " + std::to_string(token) + " " + std::to_string(from.addr) + " " + std::to_string(from.port));
+    }
+}
+
+void TrackerServer::unbindSession(const Endpoint& from) {
+    if (removeSession(from) && logMutations) {
+        mutationLog.append("U " + std::to_string(from.addr) + " " + std::to_string(from.port));
+    }
+}
+
+static bool isWriteCommand(CommandType cmd) {
+    return cmd != CMD_QUERY_PLAYERS && cmd != CMD_QUERY_GAMES && cmd != CMD_QUERY_LEADERBOARD &&
+           cmd != CMD_QUERY_PLAYERS_SINCE && cmd != CMD_QUERY_GAMES_SINCE && cmd != CMD_START_ACK;
+}
+
+// A MULTI writes when any of its sub-commands does; unknown ones fail
+// without touching state
+static bool isWriteMessage(const Message& msg) {
+    if (msg.cmd != CMD_MULTI) {
+        return isWriteCommand(msg.cmd);
+    }
+    std::istringstream batch(msg.data);
+    std::string line;
+    for (int ops = 0; ops < MAX_MULTI_OPS && std::getline(batch, line); ++ops) {
+        std::istringstream iss(line);
+        std::string name;
+        CommandType cmd;
+        if (iss >> name && stringToCmd(name, cmd) && isWriteCommand(cmd)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string TrackerServer::handleCommand(const Message& msg, const Endpoint& from) {
+    TRACE_SCOPE("handleCommand");
+    // Filtered player queries use the tracker's indexes, under the lock
+    if (snapshotReads && ((msg.cmd == CMD_QUERY_PLAYERS && msg.data[0] == '\0') || msg.cmd == CMD_QUERY_GAMES)) {
+        EpochDomain::Guard guard(readEpochs);
+        const QueryView* view = queryView.load();
+        return msg.cmd == CMD_QUERY_PLAYERS ? view->players : view->games;
+    }
+
+    bool write = isWriteMessage(msg);
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    std::string response = execute(msg, from, write);
+    if (write) {
+        noteListingChanges();
+    }
+    return response;
+}
+
+std::string TrackerServer::execute(const Message& msg, const Endpoint& from, bool write) {
+    if (write && standby) {
+        return formatResponse(cmdToString(msg.cmd), "Standby tracker is read-only");
+    }
+    if (write && writesThrottled) {
+        return formatResponse(cmdToString(msg.cmd), "Replication backlog full, retry later");
+    }
+
+    if (msg.cmd != CMD_MULTI) {
+        return dispatch(msg.cmd, msg.data, from);
+    }
+
+    // Pack the per-operation results one per line after the operation count
+    std::vector<std::string> results = handleMulti(msg.data, from);
+    if (results.empty()) {
+        return "FAILURE MULTI No operations";
+    }
+    std::string response = "SUCCESS MULTI " + std::to_string(results.size());
+    for (const auto& result : results) {
+        response += "\n";
+        response += result;
+    }
+    return response;
+}
+
+std::vector<std::string> TrackerServer::handleMulti(const std::string& data, const Endpoint& from) {
+    std::vector<std::string> results;
+    std::istringstream batch(data);
+    std::string line;
+
+    // Each line holds one sub-command: "<COMMAND> <args...>"
+    while (std::getline(batch, line) && results.size() < MAX_MULTI_OPS) {
+        std::istringstream iss(line);
+        std::string name;
+        if (!(iss >> name)) {
+            continue;
+        }
+
+        CommandType cmd;
+        if (!stringToCmd(name, cmd)) {
+            results.push_back("FAILURE " + name + " Unknown command");
+            continue;
+        }
+        if (cmd == CMD_MULTI) {
+            results.push_back("FAILURE MULTI Nested MULTI not allowed");
+            continue;
+        }
+
+        std::string args;
+        std::getline(iss >> std::ws, args);
+        results.push_back(dispatch(cmd, args, from, true));
+    }
+    return results;
+}
+
+// Copies the player name bound to the sender's session into name, for logging
+bool TrackerServer::sessionPlayer(const Endpoint& from, char* name, size_t len) {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    const std::string* player = tracker.playerName(sessions.find(from));
+    if (player == nullptr) {
+        return false;
+    }
+    snprintf(name, len, "%s", player->c_str());
+    return true;
+}
+
+// Runs one matcher pass; the formed tables are returned for the caller to announce
+void TrackerServer::matchTick(std::vector<MatchNotification>& notifications) {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    if (!standby) {
+        matchmaker.tick(notifications);
+    }
+    if (!notifications.empty()) {
+        noteListingChanges();
+    }
+}
+
+// Queues "START <game_id> <holes> <count> <name ip p_port>... <variant>" for
+// every seated player but the dealer, who has the same details in its reply.
+// Hosted games add "HOST <ip> <port> <secret>" with the player's own seat secret.
+// Each goes to the endpoint the player's session was bound from, never to
+// the address the client claimed at REGISTER, so a forged registration
+// cannot aim invitations at a third party. Players without a session here,
+// such as placeholders for other nodes' players, are left to their own
+// node's clients.
+void TrackerServer::invitePlayers(uint32_t gameId, const std::string& announce, const std::vector<std::string>* secrets) {
+    const GameInfo* game = tracker.game(gameId);
+    if (game == nullptr) {
+        return;
+    }
+    std::string start = "START " + announce.substr(8);
+    std::shared_ptr<const std::string> message = std::make_shared<const std::string>(start);
+    uint64_t now = monotonicMs();
+    for (int i = 0; i < game->numPlayers; ++i) {
+        auto owner = sessionOwners.find(game->players[i]);
+        if (owner != sessionOwners.end()) {
+            if (secrets != nullptr) {
+                message = std::make_shared<const std::string>(start + " HOST " + gameHost.ip + " " +
+                                                              std::to_string(gameHost.port) + " " + (*secrets)[i + 1]);
+            }
+            invitations.add(gameId, game->players[i], owner->second, message, now);
+        }
+    }
+}
+
+void TrackerServer::dueInvitations(uint64_t nowMs, std::vector<Invitation>& out) {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    invitations.due(nowMs, out);
+}
+
+// A player argument is either a plain name or "@<token>", the session token
+// handed out by REGISTER. Tokens are only honoured from the endpoint that
+// registered, and an omitted name falls back to the sender's session.
+bool TrackerServer::resolvePlayer(const std::string& arg, const Endpoint& from, std::string& name) {
+    if (!arg.empty() && arg[0] != '@') {
+        name = arg;
+        return true;
+    }
+
+    uint32_t token = sessions.find(from);
+    if (arg.size() > 1 && strtoul(arg.c_str() + 1, nullptr, 10) != token) {
+        return false;
+    }
+    const std::string* player = tracker.playerName(token);
+    if (player == nullptr) {
+        return false;
+    }
+    name = *player;
+    return true;
+}
+
+// Players are served by the node that holds them; a name unknown here that
+// hashes to another node is redirected there
+bool TrackerServer::redirectIfRemote(const std::string& name, const char* command, std::string& response) {
+    if (selfNode < 0 || tracker.isPlayerRegistered(name)) {
+        return false;
+    }
+    int owner = ring.ownerOf(name);
+    if (owner == selfNode) {
+        return false;
+    }
+    const ClusterNode& node = ring.node(owner);
+    response = std::string("REDIRECT ") + command + " " + node.ip + " " + std::to_string(node.port);
+    return true;
+}
+
+// Cluster traffic comes from another node's link port, never from a client
+bool TrackerServer::fromClusterNode(const Endpoint& from) const {
+    for (int node = 0; node < ring.size(); ++node) {
+        const ClusterNode& peer = ring.node(node);
+        if (node != selfNode && inet_addr(peer.ip.c_str()) == from.addr &&
+            htons(static_cast<uint16_t>(peer.port + CLUSTER_LINK_PORT_OFFSET)) == from.port) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int TrackerServer::clusterFd() const {
+    return clusterLink != nullptr ? clusterLink->fd() : -1;
+}
+
+// Asks the next node for the players the table is still short of. Returns
+// true once there is nobody left to ask, when the game can be seated.
+bool TrackerServer::advanceStart(PendingStart& start, uint64_t nowMs) {
+    while (start.needed > 0 && ++start.node < ring.size()) {
+        if (start.node == selfNode) {
+            continue;
+        }
+        start.callId = std::to_string(selfNode) + "-" + std::to_string(nextReservation++);
+        if (clusterLink->send(ring.node(start.node), CMD_RESERVE, start.callId + " " + std::to_string(start.needed))) {
+            start.deadlineMs = nowMs + CLUSTER_RPC_TIMEOUT_MS;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Seats the table with the borrowed players added as remote placeholders,
+// which the regular startGame path can seat. They are added only now so
+// that no other game can take them in the meantime.
+std::string TrackerServer::seatGame(const std::string& dealer, int n, int holes, int variant,
+                                    std::vector<RemoteReservation>& held) {
+    for (auto& reservation : held) {
+        std::istringstream iss(reservation.listing);
+        std::string name, ip;
+        int tPort, pPort;
+        while (iss >> name >> ip >> tPort >> pPort) {
+            if (tracker.addRemotePlayer(name, ip, tPort, pPort) != SlotMap<PlayerInfo>::INVALID) {
+                reservation.names.push_back(name);
+            }
+        }
+    }
+
+    std::string response = tracker.startGame(dealer, n, holes, variant);
+    if (response.compare(0, 7, "SUCCESS") == 0) {
+        uint32_t gameId = strtoul(response.c_str() + 8, nullptr, 10);
+        invitePlayers(gameId, response);
+        if (!held.empty()) {
+            gameReservations[gameId] = held;
+        }
+    } else if (!held.empty()) {
+        releaseRemotePlayers(held);
+    }
+    return formatResponse("START_GAME", response);
+}
+
+void TrackerServer::releaseRemotePlayers(const std::vector<RemoteReservation>& held) {
+    for (const auto& reservation : held) {
+        for (const auto& name : reservation.names) {
+            tracker.removeRemotePlayer(name);
+        }
+        clusterLink->send(ring.node(reservation.node), CMD_RELEASE, reservation.id);
+    }
+}
+
+// Seats a hosted game from this node's players and asks the game host to
+// open its table, with a fresh secret for every seat. The dealer is
+// answered from clusterPoll, so the reply here is empty.
+std::string TrackerServer::startHosted(const std::string& dealer, int n, int holes, int variant, const Endpoint& from) {
+    if (gameHost.port == 0) {
+        return formatResponse("START_GAME", "FAILURE No game host configured");
+    }
+    for (const auto& pending : pendingTables) {
+        if (pending.dealer == dealer) {
+            return ""; // A resend while the host is still being asked
+        }
+    }
+    std::string response = tracker.startGame(dealer, n, holes, variant);
+    if (response.compare(0, 7, "SUCCESS") != 0) {
+        return formatResponse("START_GAME", response);
+    }
+
+    PendingTable table;
+    table.from = from;
+    table.gameId = strtoul(response.c_str() + 8, nullptr, 10);
+    table.dealer = dealer;
+    table.announce = response;
+    table.open = std::to_string(table.gameId) + " " + golfVariant(variant).name + " " + std::to_string(holes);
+    const GameInfo* game = tracker.game(table.gameId);
+    for (int seat = 0; seat <= game->numPlayers; ++seat) {
+        uint32_t handle = seat == 0 ? game->dealer : game->players[seat - 1];
+        char secret[17];
+        snprintf(secret, sizeof(secret), "%08x%08x", secretSource(), secretSource());
+        table.secrets.push_back(secret);
+        table.open += " " + *tracker.playerName(handle) + " " + secret;
+    }
+    uint64_t now = monotonicMs();
+    clusterLink->send(gameHost, CMD_TABLE_OPEN, table.open);
+    table.tries = 1;
+    table.deadlineMs = now + CLUSTER_RPC_TIMEOUT_MS;
+    pendingTables.push_back(table);
+    return "";
+}
+
+// Answers a hosted START_GAME: the dealer's reply and the invitations carry
+// the host and each player's seat secret. A table the host never opened
+// ends its game, which frees the players again.
+void TrackerServer::finishHosted(PendingTable& table, bool opened, std::vector<DeferredReply>& replies) {
+    if (opened) {
+        replies.push_back({table.from, formatResponse("START_GAME", table.announce + " HOST " + gameHost.ip + " " +
+                                                                        std::to_string(gameHost.port) + " " +
+                                                                        table.secrets[0])});
+        invitePlayers(table.gameId, table.announce, &table.secrets);
+    } else {
+        tracker.endGame(table.gameId, table.dealer);
+        replies.push_back({table.from, formatResponse("START_GAME", "FAILURE Game host did not open the table")});
+    }
+}
+
+// Takes the other nodes' answers to reservation calls and the game host's
+// answers to TABLE_OPEN, and expires the calls not answered in time.
+// Finished START_GAMEs are returned with the dealer to send them to.
+void TrackerServer::clusterPoll(uint64_t nowMs, std::vector<DeferredReply>& replies) {
+    if (clusterLink == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(trackerMutex);
+
+    // "SUCCESS RESERVE <id> <count> <name ip t_port p_port>...",
+    // "FAILURE RESERVE <id> <reason>", "SUCCESS TABLE_OPEN <id>" or
+    // "FAILURE TABLE_OPEN <id> <reason>"; anything else needs no handling
+    std::string reply;
+    sockaddr_in fromAddr;
+    bool seated = false;
+    while (clusterLink->receive(reply, fromAddr)) {
+        std::istringstream iss(reply);
+        std::string status, command, id;
+        iss >> status >> command >> id;
+        if (command == "TABLE_OPEN" && gameHost.port != 0 && inet_addr(gameHost.ip.c_str()) == fromAddr.sin_addr.s_addr &&
+            htons(gameHost.port) == fromAddr.sin_port) {
+            for (size_t i = 0; i < pendingTables.size(); ++i) {
+                if (std::to_string(pendingTables[i].gameId) == id) {
+                    // The host answers a resent open with SUCCESS too
+                    finishHosted(pendingTables[i], status == "SUCCESS", replies);
+                    pendingTables.erase(pendingTables.begin() + i);
+                    seated = true;
+                    break;
+                }
+            }
+            continue;
+        }
+        if (command != "RESERVE") {
+            continue;
+        }
+        for (auto& start : pendingStarts) {
+            if (start.callId != id || start.deadlineMs == 0) {
+                continue;
+            }
+            const ClusterNode& node = ring.node(start.node);
+            if (inet_addr(node.ip.c_str()) != fromAddr.sin_addr.s_addr || htons(node.port) != fromAddr.sin_port) {
+                break;
+            }
+            if (status == "SUCCESS") {
+                RemoteReservation reservation;
+                reservation.node = start.node;
+                reservation.id = id;
+                int count = 0;
+                iss >> count;
+                std::getline(iss >> std::ws, reservation.listing);
+                start.needed -= count;
+                start.held.push_back(reservation);
+            }
+            start.deadlineMs = 0; // Answered; advanced below
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < pendingTables.size();) {
+        PendingTable& table = pendingTables[i];
+        if (nowMs < table.deadlineMs) {
+            ++i;
+            continue;
+        }
+        if (table.tries < HOST_OPEN_TRIES) {
+            clusterLink->send(gameHost, CMD_TABLE_OPEN, table.open);
+            table.tries++;
+            table.deadlineMs = nowMs + CLUSTER_RPC_TIMEOUT_MS;
+            ++i;
+            continue;
+        }
+        finishHosted(table, false, replies);
+        pendingTables.erase(pendingTables.begin() + i);
+        seated = true;
+    }
+
+    for (size_t i = 0; i < pendingStarts.size();) {
+        PendingStart& start = pendingStarts[i];
+        if (start.deadlineMs != 0 && nowMs < start.deadlineMs) {
+            ++i;
+            continue;
+        }
+        if (start.deadlineMs != 0) {
+            // The reservation may still land after the timeout, so cancel it
+            clusterLink->send(ring.node(start.node), CMD_RELEASE, start.callId);
+        }
+        if (!advanceStart(start, nowMs)) {
+            ++i;
+            continue;
+        }
+        replies.push_back({start.from, seatGame(start.dealer, start.n, start.holes, start.variant, start.held)});
+        seated = true;
+        pendingStarts.erase(pendingStarts.begin() + i);
+    }
+    if (seated) {
+        noteListingChanges();
+    }
+}
+
+std::string TrackerServer::dispatch(CommandType cmd, const std::string& data, const Endpoint& from, bool batched) {
+    std::istringstream iss(data);
     std::string response;
 
-    switch (msg.cmd)
+    switch (cmd)
     {
         case CMD_REGISTER:
         {
             std::string name, ipAddress;
             int tPort, pPort;
             iss >> name >> ipAddress >> tPort >> pPort;
+            if (redirectIfRemote(name, "REGISTER", response)) {
+                break;
+            }
             response = tracker.registerPlayer(name, ipAddress, tPort, pPort);
+            if (response == "SUCCESS") {
+                // The registry handle doubles as the session token
+                uint32_t token = tracker.playerHandle(name);
+                bindSession(from, token);
+                response += " " + std::to_string(token);
+            }
             response = formatResponse("REGISTER", response);
             break;
         }
-        case CMD_QUERY_PLAYERS:
-            response = tracker.queryPlayers();
+        case CMD_QUERY_PLAYERS: {
+            // Optional filters: "[state=<state>] [prefix=<text>] [ip=<a.b.c.d>[/<bits>]]"
+            PlayerSearch::Filter filter;
+            std::string error;
+            if (data.find_first_not_of(" \n") == std::string::npos) {
+                response = tracker.queryPlayers();
+            } else if (PlayerSearch::parse(data, filter, error)) {
+                response = tracker.queryPlayers(filter);
+            } else {
+                response = "FAILURE " + error;
+            }
             response = formatResponse("QUERY_PLAYERS", response);
             break;
+        }
         case CMD_QUERY_GAMES:
             response = tracker.queryGames();
             response = formatResponse("QUERY_GAMES", response);
             break;
+        case CMD_QUERY_PLAYERS_SINCE:
+            response = tracker.queryPlayersSince(strtoull(data.c_str(), nullptr, 10));
+            response = formatResponse("QUERY_PLAYERS_SINCE", response);
+            break;
+        case CMD_QUERY_GAMES_SINCE:
+            response = tracker.queryGamesSince(strtoull(data.c_str(), nullptr, 10));
+            response = formatResponse("QUERY_GAMES_SINCE", response);
+            break;
         case CMD_START_GAME: {
-            std::string dealer;
+            // "<dealer> <n> <holes> [variant] [hosted]"
+            std::string dealerArg, dealer;
+            std::string variantName, word;
             int n, holes;
-            iss >> dealer >> n >> holes;
-            response = tracker.startGame(dealer, n, holes);
-            response = formatResponse("START_GAME", response);
+            bool hosted = false;
+            iss >> dealerArg >> n >> holes;
+            while (iss >> word) {
+                if (word == "hosted") {
+                    hosted = true;
+                } else {
+                    variantName = word;
+                }
+            }
+            if (!resolvePlayer(dealerArg, from, dealer)) {
+                response = formatResponse("START_GAME", "FAILURE Invalid session token");
+                break;
+            }
+            if (redirectIfRemote(dealer, "START_GAME", response)) {
+                break;
+            }
+            int variant = variantName.empty() ? 0 : findGolfVariant(variantName);
+            if (variant < 0) {
+                response = formatResponse("START_GAME", "FAILURE Unknown game variant");
+                break;
+            }
+
+            // A hosted start is answered once the game host has opened the
+            // table, which a MULTI reply cannot wait for. It seats this
+            // node's players only.
+            if (hosted) {
+                response = batched ? formatResponse("START_GAME", "FAILURE Hosted games cannot start in a MULTI")
+                                   : startHosted(dealer, n, holes, variant, from);
+                break;
+            }
+
+            // Short of free players in cluster mode, the others are asked
+            // for the rest and the dealer is answered once they have replied.
+            // Batched starts make do with this node's players.
+            if (selfNode >= 0 && !batched && n >= 1 && n < MAX_PLAYERS && tracker.isPlayerRegistered(dealer)) {
+                bool waiting = false;
+                for (const auto& start : pendingStarts) {
+                    waiting = waiting || start.dealer == dealer;
+                }
+                if (waiting) {
+                    break; // A resend while the first request is still being served
+                }
+                PendingStart start;
+                start.from = from;
+                start.dealer = dealer;
+                start.n = n;
+                start.holes = holes;
+                start.variant = variant;
+                start.needed = n - tracker.freePlayerCount(dealer);
+                start.node = -1;
+                start.deadlineMs = 0;
+                if (start.needed > 0 && !advanceStart(start, monotonicMs())) {
+                    pendingStarts.push_back(start);
+                    break;
+                }
+            }
+            std::vector<RemoteReservation> none;
+            response = seatGame(dealer, n, holes, variant, none);
             break;
         }
         case CMD_END_GAME: {
-            int gameId;
-            std::string dealer;
-            iss >> gameId >> dealer;
-            response = tracker.endGame(gameId, dealer);
+            // Optional trailing scores, one per seat with the dealer first, rate the game
+            uint32_t gameId = 0;
+            std::string dealerArg, dealer;
+            std::vector<int> scores;
+            int score;
+            iss >> gameId >> dealerArg;
+            while (iss >> score) {
+                scores.push_back(score);
+            }
+            if (!resolvePlayer(dealerArg, from, dealer)) {
+                response = formatResponse("END_GAME", "FAILURE Invalid session token");
+                break;
+            }
+            if (redirectIfRemote(dealer, "END_GAME", response)) {
+                break;
+            }
+            response = tracker.endGame(gameId, dealer, scores);
+            if (response == "SUCCESS") {
+                invitations.cancelGame(gameId);
+            }
+            auto held = gameReservations.find(gameId);
+            if (response == "SUCCESS" && held != gameReservations.end()) {
+                releaseRemotePlayers(held->second);
+                gameReservations.erase(held);
+            }
             response = formatResponse("END_GAME", response);
             break;
         }
         case CMD_DEREGISTER: {
-            std::string name;
-            iss >> name;
+            std::string nameArg, name;
+            iss >> nameArg;
+            if (!resolvePlayer(nameArg, from, name)) {
+                response = formatResponse("DEREGISTER", "FAILURE Invalid session token");
+                break;
+            }
+            if (redirectIfRemote(name, "DEREGISTER", response)) {
+                break;
+            }
+            uint32_t handle = tracker.playerHandle(name);
             response = tracker.deregisterPlayer(name);
+            // The player may be deregistered by name from another endpoint
+            auto owner = sessionOwners.find(handle);
+            if (response == "SUCCESS" && owner != sessionOwners.end()) {
+                unbindSession(owner->second);
+            }
             response = formatResponse("DEREGISTER", response);
             break;
         }
-        default:
-            response = "FAILURE Unknown command";
+        case CMD_QUERY_LEADERBOARD: {
+            // "TOP [k]" lists the best rated players, "RANK <player>" looks one up
+            std::string mode, arg;
+            iss >> mode >> arg;
+            if (mode == "RANK") {
+                std::string name;
+                if (!resolvePlayer(arg, from, name)) {
+                    response = formatResponse("QUERY_LEADERBOARD", "FAILURE Invalid session token");
+                    break;
+                }
+                if (redirectIfRemote(name, "QUERY_LEADERBOARD", response)) {
+                    break;
+                }
+                response = tracker.playerRank(name);
+            } else if (mode.empty() || mode == "TOP") {
+                response = tracker.queryLeaderboard(arg.empty() ? 10 : strtoul(arg.c_str(), nullptr, 10));
+            } else {
+                response = "FAILURE Expected TOP or RANK";
+            }
+            response = formatResponse("QUERY_LEADERBOARD", response);
+            break;
         }
-
-    return response;
-}
-
-
-int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <UDP SERVER PORT>\n", argv[0]);
-        exit(1);
-    }
-
-    int sock;                               // Socket
-    struct sockaddr_in trackerServAddr;     // Local address of server
-    struct sockaddr_in trackerClntAddr;     // Client address
-    unsigned int cliAddrLen;                // Length of incoming message
-    Message msg;                            // Buffer for incoming message
-    unsigned short trackerServPort;         // Server port
-    int recvMsgSize;                        // Size of received message
-    std::map<std::string, std::string> ipToPlayerName; // Map of IP addresses to player names
-
-    trackerServPort = atoi(argv[1]);        // First arg: local port
-
-    // Create socket for sending/receiving datagrams
-    if ((sock = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0)
-        DieWithError("server: socket() failed");
-
-    // Construct local address structure
-    memset(&trackerServAddr, 0, sizeof(trackerServAddr));
-    trackerServAddr.sin_family = AF_INET;
-    trackerServAddr.sin_addr.s_addr = htonl(INADDR_ANY);
-    trackerServAddr.sin_port = htons(trackerServPort);
-
-    // Bind to the local address
-    if (bind(sock, (struct sockaddr *) &trackerServAddr, sizeof(trackerServAddr)) < 0)
-        DieWithError("server: bind() failed");
-
-    TrackerServer trackerServer;
-
-    printf("Tracker server is running on port %d\n", trackerServPort);
-
-    for (;;) {
-        cliAddrLen = sizeof(trackerClntAddr);
-
-        // Block until you receive a message from a client
-        if ((recvMsgSize = recvfrom(sock, &msg, sizeof(Message), 0,
-            (struct sockaddr *) &trackerClntAddr, &cliAddrLen)) < 0)
-            DieWithError("server: recvfrom() failed");
-        
-        std::string clientIP = inet_ntoa(trackerClntAddr.sin_addr);
-        std::string playerName = ipToPlayerName[clientIP];
-        
-        if (playerName.empty()) {
-            printf("Received from client %s: Command %d, Data: %s\n", clientIP.c_str(), msg.cmd, msg.data);
-        } else {
-            printf("Received from client %s (%s): Command %d, Data: %s\n", clientIP.c_str(), playerName.c_str(), msg.cmd, msg.data);
+        case CMD_START_ACK: {
+            // "<game_id> <player>": the player got the START notification.
+            // Acknowledgements are not answered, and only count from the
+            // endpoint the invitation went to.
+            uint32_t gameId = 0;
+            std::string nameArg, name;
+            iss >> gameId >> nameArg;
+            if (!resolvePlayer(nameArg, from, name)) {
+                break;
+            }
+            uint32_t handle = tracker.playerHandle(name);
+            auto owner = sessionOwners.find(handle);
+            if (owner != sessionOwners.end() && owner->second.addr == from.addr && owner->second.port == from.port) {
+                invitations.ack(gameId, handle);
+            }
+            break;
         }
-        
-        // Handle the command using the new TrackerServer implementation
-        std::string response = trackerServer.handleCommand(msg);
-
-        // If this was a successful registration, update the ipToPlayerName map
-        if (msg.cmd == CMD_REGISTER && response.substr(0, 7) == "SUCCESS") {
-            std::istringstream iss(msg.data);
-            std::string command, name, ip;
-            int tPort, pPort;
-            iss >> command >> name >> ip >> tPort >> pPort;
-            ipToPlayerName[clientIP] = name;
+        case CMD_REPORT_RTT: {
+            // "<player> <peer> <us> <peer> <us> ..."
+            std::string nameArg, name, peer;
+            unsigned long us;
+            std::vector<std::pair<std::string, uint32_t>> samples;
+            iss >> nameArg;
+            while (iss >> peer >> us) {
+                samples.push_back(std::make_pair(peer, static_cast<uint32_t>(us)));
+            }
+            if (!resolvePlayer(nameArg, from, name)) {
+                response = formatResponse("REPORT_RTT", "FAILURE Invalid session token");
+                break;
+            }
+            if (redirectIfRemote(name, "REPORT_RTT", response)) {
+                break;
+            }
+            response = formatResponse("REPORT_RTT", tracker.reportRtts(name, samples));
+            break;
         }
-
-        // If this was a successful de-registration, remove from the ipToPlayerName map
-        if (msg.cmd == CMD_DEREGISTER && response.substr(0, 7) == "SUCCESS") {
-            ipToPlayerName.erase(clientIP);
+        case CMD_MATCH_ENQUEUE: {
+            std::string nameArg, name;
+            int tableSize = 0, holes = 0;
+            iss >> nameArg >> tableSize >> holes;
+            if (!resolvePlayer(nameArg, from, name)) {
+                response = formatResponse("MATCH_ENQUEUE", "FAILURE Invalid session token");
+                break;
+            }
+            if (redirectIfRemote(name, "MATCH_ENQUEUE", response)) {
+                break;
+            }
+            response = matchmaker.enqueue(tracker.playerHandle(name), tableSize, holes, from);
+            response = formatResponse("MATCH_ENQUEUE", response);
+            break;
+        }
+        case CMD_MATCH_CANCEL: {
+            std::string nameArg, name;
+            iss >> nameArg;
+            if (!resolvePlayer(nameArg, from, name)) {
+                response = formatResponse("MATCH_CANCEL", "FAILURE Invalid session token");
+                break;
+            }
+            if (redirectIfRemote(name, "MATCH_CANCEL", response)) {
+                break;
+            }
+            response = matchmaker.cancel(tracker.playerHandle(name));
+            response = formatResponse("MATCH_CANCEL", response);
+            break;
+        }
+        case CMD_RESERVE: {
+            // Replies echo the reservation ID so the caller can match them
+            std::string id;
+            int count = 0;
+            iss >> id >> count;
+            if (!fromClusterNode(from)) {
+                response = formatResponse("RESERVE", "FAILURE Cluster nodes only");
+                break;
+            }
+            if (id.empty() || count < 1 || count > MAX_PLAYERS - 1) {
+                response = "FAILURE RESERVE " + id + " Invalid reservation";
+                break;
+            }
+            response = tracker.reservePlayers(id, count);
+            response = response.compare(0, 7, "SUCCESS") == 0 ? formatResponse("RESERVE", "SUCCESS " + id + " " + response.substr(8))
+                                                               : "FAILURE RESERVE " + id + " " + response.substr(8);
+            break;
+        }
+        case CMD_RELEASE: {
+            std::string id;
+            iss >> id;
+            if (!fromClusterNode(from)) {
+                response = formatResponse("RELEASE", "FAILURE Cluster nodes only");
+                break;
+            }
+            response = tracker.releasePlayers(id);
+            response = formatResponse("RELEASE", response);
+            break;
+        }
+        default:
+            response = "FAILURE Unknown command";
         }
 
-        // Send the response back to the client
-        if (sendto(sock, response.c_str(), response.length(), 0,
-             (struct sockaddr *) &trackerClntAddr, sizeof(trackerClntAddr)) != response.length())
-            DieWithError("server: sendto() sent a different number of bytes than expected");
-        
-        printf("Sent response to client %s: %s\n", clientIP.c_str(), response.c_str());
-    }
-
-    // Close the socket (this part will never be reached in this implementation)
-    close(sock);
-    return 0;
+    return response;
 }
\ No newline at end of file
@@ -2,17 +2,153 @@
 #define TRACKER_SERVER_H
 
 #include "Tracker.h"
+#include "SessionTable.h"
+#include "Cluster.h"
+#include "Replication.h"
+#include "Matchmaker.h"
+#include "EpochDomain.h"
+#include "Invitations.h"
 #include "Utils.h"
 #include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <random>
+
+#define MAX_MULTI_OPS 64
+#define HOST_OPEN_TRIES 3 // TABLE_OPEN sends before a hosted start gives up, CLUSTER_RPC_TIMEOUT_MS apart
+
+// A reply produced outside the request that asked for it
+struct DeferredReply {
+    Endpoint to;
+    std::string message;
+};
 
 class TrackerServer {
 private:
+    // Players a game borrowed from another node, released on END_GAME
+    struct RemoteReservation {
+        int node;
+        std::string id;
+        std::string listing; // "<name ip t_port p_port>..." as the node replied
+        std::vector<std::string> names;
+    };
+
+    // A START_GAME waiting on other nodes for the players it is short of.
+    // Nodes are asked one at a time; the table is seated once the players
+    // are found or every node has answered or timed out.
+    struct PendingStart {
+        Endpoint from;
+        std::string dealer;
+        int n, holes, variant;
+        int needed;
+        int node;            // Node being asked, or -1 before the first call
+        std::string callId;  // Reservation ID of that call
+        uint64_t deadlineMs;
+        std::vector<RemoteReservation> held;
+    };
+
+    // A hosted START_GAME whose game is seated, waiting for the game host to
+    // open its table. The dealer is answered and the players invited once
+    // it has; if it does not, the game is ended again.
+    struct PendingTable {
+        Endpoint from;
+        uint32_t gameId;
+        std::string dealer;
+        std::string announce;             // The tracker's reply, before formatResponse
+        std::string open;                 // TABLE_OPEN arguments, resent until answered
+        std::vector<std::string> secrets; // One per seat, dealer first
+        int tries;
+        uint64_t deadlineMs;
+    };
+
     Tracker tracker;
+    SessionTable sessions;
+    std::unordered_map<uint32_t, Endpoint> sessionOwners; // Session token -> the endpoint bound to it
+    Matchmaker matchmaker;
+    std::mutex trackerMutex;
+
+    // Cluster mode; selfNode is -1 when running standalone
+    ClusterRing ring;
+    ClusterLink* clusterLink;
+    int selfNode;
+    unsigned long nextReservation;
+    std::unordered_map<uint32_t, std::vector<RemoteReservation>> gameReservations;
+    std::vector<PendingStart> pendingStarts;
+
+    // Game host for hosted games, reached over the cluster link; port 0 without one
+    ClusterNode gameHost;
+    std::vector<PendingTable> pendingTables;
+    std::random_device secretSource;
+    std::string startHosted(const std::string& dealer, int n, int holes, int variant, const Endpoint& from);
+    void finishHosted(PendingTable& table, bool opened, std::vector<DeferredReply>& replies);
+
+    // START notifications to the seated players of new games, until acknowledged
+    InvitationQueue invitations;
+    void invitePlayers(uint32_t gameId, const std::string& announce, const std::vector<std::string>* secrets = nullptr);
+
+    // Replication: the primary logs every mutation, a standby refuses writes
+    MutationLog mutationLog;
+    bool logMutations;
+    std::atomic<bool> standby;
+    std::atomic<bool> writesThrottled;
+
+    // Listing changes by version for QUERY_PLAYERS_SINCE and QUERY_GAMES_SINCE
+    MutationLog changeJournal;
+
+    // QUERY_PLAYERS and QUERY_GAMES are answered without trackerMutex from an
+    // immutable view that is republished after the listings change; replaced
+    // views are reclaimed once no reader can still hold them
+    struct QueryView {
+        std::string players;
+        std::string games;
+    };
+    std::atomic<const QueryView*> queryView;
+    EpochDomain readEpochs;
+    uint64_t viewVersion;          // Change journal head the view reflects
+    std::atomic<bool> viewStale;
+    bool snapshotReads;
+    void publishQueryView();
+    void noteListingChanges();
+
+    // Runs one command against the tracker; the caller must hold trackerMutex
+    std::string dispatch(CommandType cmd, const std::string& data, const Endpoint& from, bool batched = false);
+    std::string execute(const Message& msg, const Endpoint& from, bool write);
+    std::vector<std::string> handleMulti(const std::string& data, const Endpoint& from);
+    bool resolvePlayer(const std::string& arg, const Endpoint& from, std::string& name);
+    void addSession(const Endpoint& endpoint, uint32_t token);
+    bool removeSession(const Endpoint& endpoint);
+    void bindSession(const Endpoint& from, uint32_t token);
+    void unbindSession(const Endpoint& from);
+    bool redirectIfRemote(const std::string& name, const char* command, std::string& response);
+    bool fromClusterNode(const Endpoint& from) const;
+    bool advanceStart(PendingStart& start, uint64_t nowMs);
+    std::string seatGame(const std::string& dealer, int n, int holes, int variant, std::vector<RemoteReservation>& held);
+    void releaseRemotePlayers(const std::vector<RemoteReservation>& held);
 
 public:
     TrackerServer();
+    ~TrackerServer();
+    void enableCluster(int self, const std::vector<ClusterNode>& nodes);
+    // Hosted games open their tables on this game host, from the link
+    // socket on port plus CLUSTER_LINK_PORT_OFFSET
+    void enableGameHost(const ClusterNode& host, int port);
+    int clusterFd() const; // Readable when other nodes or the game host replied; -1 without either
+    void clusterPoll(uint64_t nowMs, std::vector<DeferredReply>& replies);
+
+    MutationLog& enableMutationLog();
+    void snapshot(std::vector<std::string>& records, uint64_t& seq);
+    void applyReplicated(const std::vector<std::string>& records);
+    void resetState();
+    void setStandby(bool value) { standby = value; }
+    void setWritesThrottled(bool value) { writesThrottled = value; }
+    void setSnapshotReads(bool enabled) { snapshotReads = enabled; } // Off serves queries under the lock
+    void publishQueries();
     std::string formatResponse(const std::string& command, const std::string& trackerResponse);
-    std::string handleCommand(const Message& msg);
+    std::string handleCommand(const Message& msg, const Endpoint& from);
+    bool sessionPlayer(const Endpoint& from, char* name, size_t len);
+    void matchTick(std::vector<MatchNotification>& notifications);
+    void dueInvitations(uint64_t nowMs, std::vector<Invitation>& out);
 };
 
 #endif // TRACKER_SERVER_H
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "Transport.h"
+#include "IoUringTransport.h"
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <poll.h>
+
+void terminateMessage(Message* msg, size_t len) {
+    if (len >= sizeof(Message)) {
+        msg->data[sizeof(msg->data) - 1] = '\0';
+    } else if (len >= offsetof(Message, data)) {
+        reinterpret_cast<char*>(msg)[len] = '\0';
+    } else {
+        msg->data[0] = '\0';
+    }
+}
+
+// Prints once per second while requests are flowing
+void Transport::report(uint64_t nowMs) {
+    if (nowMs - lastReportMs < 1000) {
+        return;
+    }
+    uint64_t requests = counters.received - lastReport.received;
+    if (requests > 0) {
+        uint64_t syscalls = counters.syscalls - lastReport.syscalls;
+        printf("transport %s: %llu requests, %llu replies, %llu dropped, %llu syscalls (%.2f per request)\n", name(),
+               (unsigned long long) requests, (unsigned long long) (counters.sent - lastReport.sent),
+               (unsigned long long) (counters.dropped - lastReport.dropped), (unsigned long long) syscalls,
+               static_cast<double>(syscalls) / requests);
+    }
+    lastReport = counters;
+    lastReportMs = nowMs;
+}
+
+SocketTransport::SocketTransport(int sock)
+    : sock(sock), outbound(sock), buffers(TRANSPORT_MAX_BATCH), addrs(TRANSPORT_MAX_BATCH),
+      headers(TRANSPORT_MAX_BATCH), iovs(TRANSPORT_MAX_BATCH), sendCallsSeen(0) {
+    for (int i = 0; i < TRANSPORT_MAX_BATCH; ++i) {
+        iovs[i].iov_base = &buffers[i];
+        iovs[i].iov_len = sizeof(Message);
+        memset(&headers[i], 0, sizeof(headers[i]));
+        headers[i].msg_hdr.msg_name = &addrs[i];
+        headers[i].msg_hdr.msg_iov = &iovs[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+short SocketTransport::pollEvents() const {
+    return POLLIN | (outbound.pending() ? POLLOUT : 0);
+}
+
+void SocketTransport::ready(short revents) {
+    if (revents & POLLOUT) {
+        outbound.flush();
+    }
+    counters.syscalls += outbound.sendCalls() - sendCallsSeen;
+    sendCallsSeen = outbound.sendCalls();
+}
+
+// One recvmmsg() drains up to max queued datagrams
+int SocketTransport::receive(InboundDatagram* batch, int max) {
+    if (max > TRANSPORT_MAX_BATCH) {
+        max = TRANSPORT_MAX_BATCH;
+    }
+    for (int i = 0; i < max; ++i) {
+        headers[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+    }
+    counters.syscalls++;
+    int n = recvmmsg(sock, headers.data(), max, MSG_DONTWAIT, nullptr);
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return 0;
+        DieWithError("server: recvmmsg() failed");
+    }
+    for (int i = 0; i < n; ++i) {
+        terminateMessage(&buffers[i], headers[i].msg_len);
+        batch[i].msg = &buffers[i];
+        batch[i].len = headers[i].msg_len;
+        batch[i].addr = addrs[i];
+    }
+    counters.received += n;
+    return n;
+}
+
+bool SocketTransport::send(const void* data, size_t len, const sockaddr_in& to) {
+    bool queued = outbound.send(data, len, to);
+    counters.syscalls += outbound.sendCalls() - sendCallsSeen;
+    sendCallsSeen = outbound.sendCalls();
+    if (queued) {
+        counters.sent++;
+    } else {
+        counters.dropped++;
+    }
+    return queued;
+}
+
+Transport* createTransport(const std::string& kind, int sock) {
+    if (kind == "io_uring") {
+        std::string error;
+        IoUringTransport* uring = IoUringTransport::create(sock, error);
+        if (uring != nullptr) {
+            return uring;
+        }
+        fprintf(stderr, "server: io_uring unavailable (%s), using sockets\n", error.c_str());
+    } else if (kind != "sockets") {
+        fprintf(stderr, "server: unknown transport \"%s\", using sockets\n", kind.c_str());
+    }
+    return new SocketTransport(sock);
+}
\ No newline at end of file
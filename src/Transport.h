@@ -0,0 +1,89 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include "Utils.h"
+#include "SendQueue.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define TRANSPORT_MAX_BATCH 256 // Datagrams handed out per receive()
+
+// A received request. msg points into transport-owned memory that stays
+// valid until the next receive() call.
+struct InboundDatagram {
+    Message* msg;
+    size_t len;
+    sockaddr_in addr;
+};
+
+struct TransportStats {
+    uint64_t syscalls;  // Including the caller's poll(), which it adds itself
+    uint64_t received;
+    uint64_t sent;
+    uint64_t dropped;   // Replies lost to a full send queue or a send error
+};
+
+// Moves datagrams between the tracker's UDP socket and the request loop.
+// Each loop iteration polls fd() for pollEvents(), passes the readiness to
+// ready(), drains requests with receive() when readable, queues replies
+// with send(), and ends with flush().
+class Transport {
+public:
+    virtual ~Transport() {}
+
+    virtual const char* name() const = 0;
+    virtual int fd() const = 0;
+    virtual short pollEvents() const = 0;
+    virtual void ready(short revents) = 0;
+    virtual int receive(InboundDatagram* batch, int max) = 0;
+    virtual bool send(const void* data, size_t len, const sockaddr_in& to) = 0;
+    virtual void flush() = 0;
+    virtual bool congested() const = 0;
+
+    TransportStats& stats() { return counters; }
+    void report(uint64_t nowMs);
+
+protected:
+    TransportStats counters = TransportStats();
+
+private:
+    TransportStats lastReport = TransportStats();
+    uint64_t lastReportMs = 0;
+};
+
+// recvmmsg() batches in, sendto() through a SendQueue out
+class SocketTransport : public Transport {
+public:
+    explicit SocketTransport(int sock);
+
+    const char* name() const { return "sockets"; }
+    int fd() const { return sock; }
+    short pollEvents() const;
+    void ready(short revents);
+    int receive(InboundDatagram* batch, int max);
+    bool send(const void* data, size_t len, const sockaddr_in& to);
+    void flush() {}
+    bool congested() const { return outbound.congested(); }
+
+private:
+    int sock;
+    SendQueue outbound;
+    std::vector<Message> buffers;
+    std::vector<sockaddr_in> addrs;
+    std::vector<struct mmsghdr> headers;
+    std::vector<struct iovec> iovs;
+    uint64_t sendCallsSeen;
+};
+
+// Builds the named transport ("sockets" or "io_uring") over a bound UDP
+// socket, falling back to sockets when io_uring is unavailable
+Transport* createTransport(const std::string& kind, int sock);
+
+// Makes a received request safe to parse as a C string
+void terminateMessage(Message* msg, size_t len);
+
+#endif // TRANSPORT_H
\ No newline at end of file
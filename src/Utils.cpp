@@ -108,11 +108,61 @@ const char *cmdToString(CommandType cmd)
         return "QUERY_GAMES";
     case CMD_END_GAME:
         return "END_GAME";
+    case CMD_MULTI:
+        return "MULTI";
+    case CMD_RESERVE:
+        return "RESERVE";
+    case CMD_RELEASE:
+        return "RELEASE";
+    case CMD_MATCH_ENQUEUE:
+        return "MATCH_ENQUEUE";
+    case CMD_MATCH_CANCEL:
+        return "MATCH_CANCEL";
+    case CMD_QUERY_LEADERBOARD:
+        return "QUERY_LEADERBOARD";
+    case CMD_TABLE_OPEN:
+        return "TABLE_OPEN";
+    case CMD_TABLE_JOIN:
+        return "TABLE_JOIN";
+    case CMD_TABLE_MOVE:
+        return "TABLE_MOVE";
+    case CMD_TABLE_WATCH:
+        return "TABLE_WATCH";
+    case CMD_TABLE_UNWATCH:
+        return "TABLE_UNWATCH";
+    case CMD_QUERY_PLAYERS_SINCE:
+        return "QUERY_PLAYERS_SINCE";
+    case CMD_QUERY_GAMES_SINCE:
+        return "QUERY_GAMES_SINCE";
+    case CMD_REPORT_RTT:
+        return "REPORT_RTT";
+    case CMD_START_ACK:
+        return "START_ACK";
     default:
         return "UNKNOWN";
     }
 }
 
+// Inverse of cmdToString for the tracker's commands, used to parse the
+// sub-commands of a MULTI batch. The game host's TABLE_* commands are not
+// the tracker's, so they are not recognized.
+bool stringToCmd(const std::string &name, CommandType &cmd)
+{
+    for (int c = CMD_REGISTER; c <= CMD_START_ACK; ++c)
+    {
+        if (c >= CMD_TABLE_OPEN && c <= CMD_TABLE_UNWATCH)
+        {
+            continue;
+        }
+        if (name == cmdToString(static_cast<CommandType>(c)))
+        {
+            cmd = static_cast<CommandType>(c);
+            return true;
+        }
+    }
+    return false;
+}
+
 void DieWithError(const char *errorMessage)
 {
     perror(errorMessage);
@@ -124,9 +174,22 @@ void ShowHelp()
     std::cout << "Available commands:" << std::endl;
     std::cout << "  register <name> <ip> <tracker_port> <peer_port> - Register player" << std::endl;
     std::cout << "  deregister - De-register player" << std::endl;
-    std::cout << "  start <dealer> <num_players> <num_holes> - Start a new game" << std::endl;
-    std::cout << "  query_players - Query registered players" << std::endl;
+    std::cout << "  start <dealer> <num_players> <num_holes> [variant] [hosted] - Start a new game (six, four, eight, nine, or *_house), optionally played on the game host" << std::endl;
+    std::cout << "  end <game_id> <dealer> [scores...] - End a game, optionally rating it (scores in seat order, dealer first)" << std::endl;
+    std::cout << "  query_players [state=<state>] [prefix=<text>] [ip=<a.b.c.d>[/<bits>]] - Query registered players, optionally filtered" << std::endl;
     std::cout << "  query_games - Query ongoing games" << std::endl;
+    std::cout << "  lobby - Show registered players, fetching only the changes since the last call" << std::endl;
+    std::cout << "  leaderboard [count] - Show the highest rated players" << std::endl;
+    std::cout << "  rank [name] - Show a player's rating and leaderboard rank" << std::endl;
+    std::cout << "  say <player> <message> - Send a message to a player at your table, resent until it arrives" << std::endl;
+    std::cout << "  probe - Measure round trips to other players and report them for seating" << std::endl;
+    std::cout << "  match <table_size> <num_holes> - Queue for matchmaking" << std::endl;
+    std::cout << "  cancel_match - Leave the matchmaking queue" << std::endl;
+    std::cout << "  multi <COMMAND args> ; <COMMAND args> ... - Run several commands in one request" << std::endl;
+    std::cout << "  join - Take your seat at the hosted game you were last dealt into" << std::endl;
+    std::cout << "  move <deck|discard> <replace|flip> <slot> - Play your turn at the hosted game" << std::endl;
+    std::cout << "  watch <host_ip> <host_port> <table_id> - Spectate a table on a game host" << std::endl;
+    std::cout << "  unwatch - Stop spectating" << std::endl;
     std::cout << "  help - Show this help message" << std::endl;
     std::cout << "  quit - Exit the program" << std::endl;
 }
\ No newline at end of file
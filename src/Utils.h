@@ -1,6 +1,7 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -16,7 +17,22 @@ enum CommandType
     CMD_START_GAME,
     CMD_QUERY_GAMES,
     CMD_END_GAME,
-    CMD_DEREGISTER
+    CMD_DEREGISTER,
+    CMD_MULTI,
+    CMD_RESERVE,
+    CMD_RELEASE,
+    CMD_MATCH_ENQUEUE,
+    CMD_MATCH_CANCEL,
+    CMD_QUERY_LEADERBOARD,
+    CMD_TABLE_OPEN,   // Game host commands
+    CMD_TABLE_JOIN,
+    CMD_TABLE_MOVE,
+    CMD_TABLE_WATCH,
+    CMD_TABLE_UNWATCH,
+    CMD_QUERY_PLAYERS_SINCE,
+    CMD_QUERY_GAMES_SINCE,
+    CMD_REPORT_RTT,
+    CMD_START_ACK
 };
 
 struct Message
@@ -31,6 +47,7 @@ struct Card
     char suit; // 'H', 'D', 'S', 'C'
     bool faceUp;
 
+    Card() : rank(0), suit('?'), faceUp(false) {}
     Card(int r, char s) : rank(r), suit(s), faceUp(false) {}
 
     std::string toString() const;
@@ -55,23 +72,31 @@ struct PlayerInfo
     std::string state; // "free" or "in-play"
     int tPort;
     int pPort;
+    bool remote; // Placeholder for a player reserved from another cluster node
+    int rating;
+    int ratedGames; // Games that counted towards rating; rated players are on the leaderboard
+    uint32_t matchTicket; // Current matchmaking queue ticket, 0 when not queued
+    std::vector<std::pair<uint32_t, uint32_t>> peerRtts; // (peer handle, round trip in us), as this player measured it
     std::vector<Card> hand;
 
-    PlayerInfo() : name(""), ipAddress(""), state("free"), tPort(0), pPort(0) {}
+    PlayerInfo() : name(""), ipAddress(""), state("free"), tPort(0), pPort(0), remote(false), rating(1500), ratedGames(0), matchTicket(0) {}
 
     PlayerInfo(const std::string &n, const std::string &ip, const std::string &s, int t, int p, const std::vector<Card>& h = std::vector<Card>())
-        : name(n), ipAddress(ip), state(s), tPort(t), pPort(p), hand(h) {}
+        : name(n), ipAddress(ip), state(s), tPort(t), pPort(p), remote(false), rating(1500), ratedGames(0), matchTicket(0), hand(h) {}
 };
 
 struct GameInfo
 {
-    int gameId;
-    std::string dealer;
-    std::vector<std::string> players;
+    uint32_t gameId;
+    uint32_t dealer;                   // Registry handle of the dealer
+    uint32_t players[MAX_PLAYERS - 1]; // Registry handles of the other players
+    int numPlayers;                    // Entries used in players
     int holes;
+    int variant;                       // Index into the golf variant registry
 };
 
 const char* cmdToString(CommandType cmd);
+bool stringToCmd(const std::string& name, CommandType& cmd);
 
 std::string displayHand(const std::vector<Card> &hand, int cardsPerRow = 6);
 void updateHand(std::vector<Card> &hand, size_t index, Card newCard);